@@ -0,0 +1,98 @@
+#pragma once
+
+#include <QByteArray>
+#include <QDir>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+class QTextStream;
+
+/**
+ * @brief Headless conversion of many Markdown files, behind `scriber --export`
+ *
+ * Inputs are files or folders (searched recursively for the same extensions
+ * the sidebar shows). Each file is converted independently on the global
+ * thread pool: a worker maps its input, parses it once with cmark and
+ * hands the tree to HtmlExporter or PdfExporter, so no state is shared between
+ * threads and throughput scales with the cores. HTML export needs only a
+ * QCoreApplication and therefore no platform plugin; PDF export lays out
+ * text and creates a QGuiApplication, using the offscreen platform unless
+ * another one was requested.
+ *
+ * With a manifest (`--incremental`, implied by `--watch`) the output folder
+ * remembers each input's size, modification time and content hash and the
+ * time its output was written. Inputs whose size and time are unchanged are
+ * skipped after a stat; touched files whose content hash still matches are
+ * skipped after a read. Outputs of inputs that disappeared are removed.
+ * Watch mode keeps re-running that pass whenever the inputs change,
+ * coalescing bursts of writes into one run.
+ */
+class BatchExporter
+{
+public:
+    enum class Format {
+        Html,
+        Pdf
+    };
+
+    /// One input file and the outcome of converting it; also a manifest record
+    struct Job {
+        QString input;
+        QString output;
+        qint64 bytes = 0;
+        qint64 modified = 0;       ///< Input modification time, ms since the epoch
+        qint64 outputModified = 0; ///< Output modification time after the export
+        QByteArray hash;           ///< SHA-1 of the input's bytes
+        qint64 nsecs = 0;
+        bool ok = false;
+        bool skipped = false;      ///< Output was already up to date
+        QString errorString;
+    };
+
+    BatchExporter(Format format, const QString &outputDirectory);
+
+    /// True if the command line asks for a batch export instead of the editor
+    static bool isExportCommand(int argc, char *argv[]);
+
+    /// Runs `scriber --export` with its own application object and returns the exit code
+    static int run(int &argc, char *argv[]);
+
+    /// Queues a file, or every Markdown file below a folder; false if @p path does not exist
+    bool addInput(const QString &path);
+
+    /// Reads the manifest in the output folder, if any, and keeps it up to date from now on
+    void loadManifest();
+
+    /// Converts the queued files on up to @p threads threads, writing a timing summary to @p out
+    bool exportAll(int threads, QTextStream &out, QTextStream &err);
+
+    /// Re-exports changed inputs until the process is stopped; returns the event loop's exit code
+    int watch(int threads, QTextStream &out, QTextStream &err);
+
+    /// Converts one file unless @p previous shows it is up to date; safe to call from any thread
+    static void exportFile(Job &job, Format format, const Job *previous = nullptr);
+
+    QList<Job> jobs() const { return m_jobs; }
+
+private:
+    bool collect(const QString &path);
+    void addJob(const QString &input, const QString &relativeFolder);
+    void rescan();
+    int removeStaleOutputs();
+    bool saveManifest(QString *errorString) const;
+    QString manifestPath() const;
+    QString formatName() const;
+
+    Format m_format;
+    QDir m_outputDirectory;
+    QStringList m_inputs;
+    QStringList m_directories; // Every folder searched, for the watcher
+    QList<Job> m_jobs;
+    QSet<QString> m_queuedInputs;
+    QHash<QString, qsizetype> m_outputJobs; // Job writing each output; -1 for names given up to avoid a clash
+    bool m_incremental = false;
+    QHash<QString, Job> m_manifest; // By input path
+};
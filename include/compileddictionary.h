@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <QStringView>
+
+/**
+ * @brief Read-only, memory-mapped word list compiled from a Hunspell dictionary
+ *
+ * The .aff/.dic pair is expanded into its inflected word forms once and stored
+ * as a minimised DAWG (directed acyclic word graph) under the user cache
+ * directory. Opening the cache only maps the file, so pages are shared between
+ * processes and lookups never allocate. Words that are not in the compiled set
+ * (compounds, multi-level affixes, ...) must still be confirmed by Hunspell.
+ */
+class CompiledDictionary
+{
+public:
+    CompiledDictionary() = default;
+    ~CompiledDictionary() = default;
+
+    CompiledDictionary(const CompiledDictionary&) = delete;
+    CompiledDictionary& operator=(const CompiledDictionary&) = delete;
+
+    /// Maps @p cachePath if it exists and was compiled from the current @p affPath / @p dicPath
+    bool open(const QString &cachePath, const QString &affPath, const QString &dicPath);
+
+    /// True if a compiled dictionary is mapped
+    bool isOpen() const { return m_edges != nullptr; }
+
+    /// True if @p word (or its lower/title-cased variant) is a known correct word form
+    bool contains(QStringView word) const;
+
+    /// Number of word forms stored in the compiled dictionary
+    quint32 wordCount() const { return m_wordCount; }
+
+    /// Expands @p affPath / @p dicPath and writes the compiled DAWG to @p cachePath
+    static bool compile(const QString &affPath, const QString &dicPath, const QString &cachePath);
+
+    /// Runs compile() on the global thread pool unless a build for @p cachePath is already running
+    static void compileInBackground(const QString &affPath, const QString &dicPath, const QString &cachePath);
+
+    /// Location of the cache file for @p language in the user cache directory
+    static QString cachePathForLanguage(const QString &language);
+
+private:
+    struct Edge {
+        quint32 target;   ///< Offset of the first edge of the child node, 0 for none
+        quint16 label;    ///< UTF-16 code unit
+        quint16 flags;    ///< EdgeFinal | EdgeLast
+    };
+
+    static const quint16 EdgeFinal = 0x1;
+    static const quint16 EdgeLast = 0x2;
+
+    bool containsExact(const char16_t *word, qsizetype length) const;
+
+    QFile m_file;
+    const Edge *m_edges = nullptr;
+    quint32 m_edgeCount = 0;
+    quint32 m_root = 0;
+    quint32 m_wordCount = 0;
+};
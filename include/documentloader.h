@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
+#include <QPointer>
+
+class EditorWidget;
+
+/**
+ * @brief Streams a file into an EditorWidget across event-loop turns
+ *
+ * The file is memory-mapped and decoded by TextCodec in line-aligned chunks that
+ * are appended to the editor a few milliseconds at a time, so the first
+ * screen appears after the first chunk and the window stays responsive for
+ * very large files. Once the text is in, the remaining turns render its
+ * blocks, those on screen first. Pipes and other files without a size are
+ * read whole up front. The loader deletes itself when it finishes or is
+ * cancelled.
+ */
+class DocumentLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    DocumentLoader(const QString &fileName, EditorWidget *editor);
+
+    /// Opens and maps the file and schedules the first chunk; false with @p errorString on failure
+    bool start(QString *errorString);
+
+    /// Stops after the current chunk and emits canceled()
+    void cancel();
+
+    QString fileName() const { return file.fileName(); }
+    qint64 totalBytes() const { return size; }
+
+signals:
+    /// Emitted after each event-loop turn that appended text
+    void progress(qint64 bytesLoaded, qint64 totalBytes);
+
+    /// Emitted once the whole file is in the editor
+    void finished();
+
+    /// Emitted if cancel() stopped the load; the editor holds a partial document
+    void canceled();
+
+private slots:
+    void loadNextChunk();
+
+private:
+    QFile file;
+    QPointer<EditorWidget> editor;
+    const char *data = nullptr; ///< Mapping, released when the file is destroyed
+    QByteArray fallbackBuffer; ///< Used when the file cannot be mapped (pipes, some filesystems)
+    qint64 size = 0;
+    qint64 offset = 0;
+    bool cancelRequested = false;
+    bool invalidUtf8Reported = false;
+};
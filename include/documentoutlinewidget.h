@@ -1,19 +1,34 @@
 #pragma once
 
-#include <QTreeWidget>
-#include <QTimer>
+#include <QHash>
+#include <QString>
+#include <QWidget>
 
-class EditorWidget;
 class OutlineDelegate;
-class ThemeManager;
+class OutlineIndex;
+class OutlineModel;
+class QLineEdit;
+class QModelIndex;
+class QSortFilterProxyModel;
+class QStackedWidget;
+class QTreeView;
 
 /**
  * @brief Document outline widget showing heading structure
  *
- * Displays a tree view of document headings (H1-H6) parsed from Markdown
- * using cmark. Allows navigation by clicking on headings.
+ * Displays a tree view of document headings (H1-H6) from the document's
+ * OutlineIndex through an OutlineModel, so even documents with tens of
+ * thousands of headings cost a few flat arrays rather than one item each.
+ * A filter field above the tree narrows it to headings containing the typed
+ * text, with their ancestors. Allows navigation by clicking on headings,
+ * and highlights the heading of the section the editor's cursor is in.
+ *
+ * Every document gets its own model and view, kept up to date by its index
+ * while the document is in the background, so switching documents only
+ * brings another page to the front and keeps each tree's expansion and
+ * scroll position.
  */
-class DocumentOutlineWidget : public QTreeWidget
+class DocumentOutlineWidget : public QWidget
 {
     Q_OBJECT
 
@@ -21,22 +36,41 @@ public:
     explicit DocumentOutlineWidget(QWidget *parent = nullptr);
     ~DocumentOutlineWidget();
     
-    /// Set the editor to parse for outline
-    void setEditor(EditorWidget *editor);
-    
-    /// Update the outline tree from current editor content
-    void updateOutline();
+    /// Show the headings of @p index and follow its changes; nullptr clears the outline
+    void setIndex(OutlineIndex *index);
 
 protected:
     void keyPressEvent(QKeyEvent *event) override;
 
 private slots:
-    void onItemClicked(QTreeWidgetItem *item, int column);
+    void onItemClicked(const QModelIndex &index);
+    void onFilterChanged(const QString &text);
+    void updateCurrentSection();
 
 private:
-    void parseHeadings(const QString &markdown);
+    // The outline of one document
+    struct Page {
+        OutlineModel *model;
+        QSortFilterProxyModel *filterModel;
+        QTreeView *treeView;
+        QString filterText;
+        int currentHeading = -1; // Heading of the section containing the editor's cursor
+    };
+    
+    Page *createPage(OutlineIndex *index);
+    void removePage(OutlineIndex *index);
+    void applyFilter(Page *page);
+    void expandDefault(Page *page);
+    void onHeadingsChanged(Page *page, int first, int removed, int added);
+    int sectionAtCursor(const Page *page) const;
+    void showCurrentSection(Page *page);
     
-    EditorWidget *currentEditor;
+    QLineEdit *filterEdit;
+    QStackedWidget *pageStack;
+    QWidget *emptyPage;
     OutlineDelegate *outlineDelegate;
-    QTimer *updateTimer;
+    QHash<OutlineIndex*, Page*> pages;
+    Page *currentPage = nullptr;
+    OutlineIndex *currentIndex = nullptr;
+    QMetaObject::Connection cursorConnection;
 };
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "textstats.h"
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+
+class EditorWidget;
+
+/**
+ * @brief Word and character totals of one document, kept current edit by edit
+ *
+ * Like OutlineIndex, the statistics follow EditorWidget::rawLinesChanged():
+ * the counts of every raw line are cached, an edit subtracts the counts of
+ * the lines it removed and adds those of the lines it inserted, so the
+ * totals are exact and cost nothing to read whatever the document's size.
+ * Only a load counts the whole document, once.
+ */
+class DocumentStats : public QObject
+{
+    Q_OBJECT
+
+public:
+    /// Counts the content of @p editor, which becomes the parent
+    explicit DocumentStats(EditorWidget *editor);
+
+    /// Words and characters of the raw Markdown; characters include the line breaks
+    TextStats::Counts totals() const;
+
+    /// Recounts the whole document
+    void reset();
+
+    /// EditorWidget::contentRevision() the totals reflect
+    quint64 revision() const { return m_revision; }
+
+signals:
+    void changed();
+
+private:
+    // Counts of one line; lines are far shorter than 4G characters
+    struct LineCounts {
+        quint32 words = 0;
+        quint32 characters = 0;
+    };
+
+    static LineCounts countLine(QStringView line);
+    void onRawLinesChanged(int firstLine, int removedLines, const QStringList &addedLines);
+
+    EditorWidget *m_editor;
+    QVector<LineCounts> m_lines;
+    TextStats::Counts m_totals; // Sum over m_lines, without line breaks
+    quint64 m_revision = 0;
+};
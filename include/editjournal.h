@@ -0,0 +1,92 @@
+#pragma once
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <memory>
+
+class EditorWidget;
+class QLockFile;
+class QThreadPool;
+
+/**
+ * @brief Append-only record of unsaved edits, replayed after a crash
+ *
+ * Every edit of the document is appended as a compact record (raw lines
+ * replaced at a line index) to a journal file in the state directory.
+ * Records are buffered and written and fsync'd in batches on a background
+ * thread, so typing never waits for the disk and the cost of a record is
+ * proportional to the edit, not to the document.
+ *
+ * A journal starts from the unmodified file on disk when there is one, so
+ * the first edit of a large file costs no more than any other. Once the
+ * records outgrow the base, the journal is compacted into a snapshot of the
+ * whole document. Saving, or undoing back to the saved state, drops the
+ * journal; closing a tab deletes it. Journals still present at the next
+ * launch belong to a session that did not shut down and are offered for
+ * recovery.
+ */
+class EditJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    /// Journals the edits of @p editor, which becomes the parent
+    explicit EditJournal(EditorWidget *editor);
+    ~EditJournal();
+
+    /// File the document is saved to; empty for untitled documents
+    void setFilePath(const QString &path);
+
+    /// Call after the document was written to its file
+    void documentSaved();
+
+    /// Writes the whole document as the base, for content that exists nowhere else
+    void recordSnapshot();
+
+    /// Document reconstructed from a journal left behind by an earlier session
+    struct Recovery {
+        QString journalPath;
+        QString filePath; ///< Empty for untitled documents
+        QString text;
+    };
+
+    /// Replays the journals of sessions that ended without closing their documents
+    static QList<Recovery> findOrphans();
+
+    /// Deletes a journal returned by findOrphans()
+    static void discard(const QString &journalPath);
+
+private slots:
+    void onRawLinesChanged(int firstLine, int removedLines, const QStringList &addedLines);
+    void onModificationChanged(bool modified);
+    void flush();
+
+private:
+    void appendRecord(const QByteArray &payload);
+    void reset();
+    void captureDiskBase();
+
+    static QString journalDirectory();
+    static QThreadPool *ioPool();
+
+    QPointer<EditorWidget> m_editor;
+    QString m_filePath;
+    QString m_journalPath;
+    std::shared_ptr<QLockFile> m_lock;   ///< Held while the journal may exist; released by the last I/O task
+
+    bool m_active = false;               ///< The journal file holds a base record
+    qint64 m_diskSize = -1;              ///< Size and modification time of m_filePath while the document matched it
+    QDateTime m_diskModified;
+
+    QByteArray m_unflushed;              ///< Records not yet handed to the I/O thread
+    qint64 m_baseBytes = 0;              ///< Size of the base the records apply to
+    qint64 m_recordBytes = 0;            ///< Size of the records since the base
+    int m_recordCount = 0;
+    QTimer m_flushTimer;
+};
@@ -7,6 +7,7 @@ class MarkdownBlockData : public QTextBlockUserData {
 public:
     QString rawMarkdown;
     bool isRendered = false;
+    bool isContinuation = false; // Extra block of a multi-block rendering (HR); its raw text belongs to the block before
 };
 
 class MarkdownHighlighter; // Forward declaration
@@ -17,9 +18,15 @@ class MarkdownHighlighter; // Forward declaration
 #include <QTextEdit>
 #include <QPointer>
 #include <QTimer>
+#include <QBitArray>
+#include "spelltokenizer.h"
+#include "textcodec.h"
+#include "linediff.h"
 
 class MarkdownHighlighter; // Forward declaration
 class SpellChecker;
+class QAction;
+class QMenu;
 
 class EditorWidget : public QTextEdit
 {
@@ -44,10 +51,54 @@ public:
     // Spell checker methods
     void setSpellCheckEnabled(bool enabled);
     void setSpellCheckLanguage(const QString &language);
+    void setWorkspacePath(const QString &rootPath); // Selects the workspace spelling dictionary
     bool isSpellCheckEnabled() const;
     QString getRawMarkdown() const;
     void renderAllBlocks();
 
+    // Incremental loading: the document is filled chunk by chunk across event-loop turns
+    void beginIncrementalLoad();
+    void appendMarkdownChunk(const QString &text); // Text ends at a line boundary except for the last chunk
+    bool renderLoadedBlocks(int budgetMs); // Renders appended blocks for up to @p budgetMs; true once all are
+    void endIncrementalLoad();
+    bool isLoading() const { return loading; }
+
+    // Incremented for every edit of the content; formatting passes do not count
+    quint64 contentRevision() const { return revisionCounter; }
+
+    // Raw Markdown of one block, or an empty string for continuation blocks
+    QString rawTextOfBlock(const QTextBlock &block) const;
+
+    // Block holding line @p line of getRawMarkdown(); invalid past the last line
+    QTextBlock blockOfRawLine(int line) const;
+
+    // Line of getRawMarkdown() shown by @p block; continuation blocks belong to the line before
+    int rawLineOfBlock(const QTextBlock &block) const;
+
+    // Selects @p length characters from column @p column of raw line @p line and
+    // scrolls to them; the line's block is revealed, so raw columns apply
+    void selectRawText(int line, int column, int length);
+
+    // Applies a diff of getRawMarkdown() lines as one undoable edit; blocks
+    // outside the hunks keep their render state, the cursor and the undo history
+    void applyLineChanges(const QVector<LineDiff::Hunk> &hunks, const QStringList &newLines);
+
+    // Replaces raw lines @p lines, in ascending order, by @p texts in the same way;
+    // for edits that keep the number of lines, such as replacing matches
+    void replaceRawLines(const QVector<int> &lines, const QStringList &texts);
+
+    // On-disk encoding details of the loaded file, written back on save
+    TextCodec::FileFormat fileFormat() const { return diskFormat; }
+    void setFileFormat(const TextCodec::FileFormat &format) { diskFormat = format; }
+
+signals:
+    // Emitted for every edit outside a load, in lines of getRawMarkdown():
+    // @p removedLines lines starting at @p firstLine were replaced by @p addedLines
+    void rawLinesChanged(int firstLine, int removedLines, const QStringList &addedLines);
+
+    // Emitted when endIncrementalLoad() replaced the whole content without rawLinesChanged()
+    void loadFinished();
+
 protected:
     void keyPressEvent(QKeyEvent *event) override;
     void focusInEvent(QFocusEvent *event) override;
@@ -63,10 +114,32 @@ private:
     Theme currentTheme; // Track current theme state
     int currentZoom;
     int activeBlockNumber = -1; // Track the block currently being edited
+    bool loading = false; // True between beginIncrementalLoad() and endIncrementalLoad()
+    bool applyingLineChanges = false; // Suppresses live preview while applyLineChanges() edits
+    int loadRenderedBlocks = 0; // Blocks before this one are rendered during an incremental load
+    void renderVisibleLoadedBlocks(); // Blocks on screen first, while loading
+    TextCodec::FileFormat diskFormat; // BOM and line endings of the file on disk
+    quint64 revisionCounter = 0; // See contentRevision()
+
+    // Rendering and revealing change the block structure with signals blocked,
+    // so the block count and the continuation blocks are tracked to translate
+    // contentsChange into raw lines.
+    int trackedBlockCount = 1;
+    QList<QTextCursor> continuationMarkers; // One cursor at the start of each continuation block
+    // Block numbers of the markers, sorted, so raw lines map with a binary search;
+    // rebuilt on first use after the block structure changed
+    mutable QVector<int> continuationBlocks;
+    mutable QVector<int> continuationLines; // continuationBlocks[i] - i
+    mutable bool continuationBlocksStale = false;
+    void updateContinuationBlocks() const;
+    void syncBlockTracking(); // Call after changing blocks with signals blocked
+    bool isContinuationMarker(const QTextCursor &marker) const;
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
 
     void applyTheme(); // Apply the current theme (palette, stylesheet)
 
     void renderBlock(QTextBlock block);
+    void applyHunks(const QVector<LineDiff::Hunk> &hunks, const QVector<QStringList> &replacements);
     int revealBlock(QTextBlock block); // Returns number of blocks merged
     QString renderMarkdownToHtml(const QString& markdown);
 
@@ -81,6 +154,20 @@ private:
     QScopedPointer<SpellChecker> spellChecker; // Use QScopedPointer for automatic cleanup
     bool spellCheckEnabled = true;
     QTimer *spellCheckTimer; // Timer for delayed checking
-    void highlightMisspelledWords();
+    QTimer *suggestionPrecomputeTimer; // Idle timer that warms the suggestion cache
+    QStringList flaggedWords; // Misspelled words on screen, nearest to the cursor first
+    QTimer *spellSliceTimer; // Drives background slices of the current spell pass
+    QBitArray spellCheckedBlocks; // Blocks already checked in the current pass
+    QBitArray spellFencedBlocks; // Blocks inside fenced code, resolved when the pass starts
+    int spellScanBlock = 0; // Next block considered by background slices
+    int spellPendingBlocks = 0; // Blocks left to check in the current pass
+    void highlightMisspelledWords(); // Starts a pass: visible blocks now, the rest in slices
+    void restartSpellPass(); // The block count changed under the pass
+    void checkVisibleBlocks();
+    void continueSpellPass();
+    void checkSpellingInBlock(const QTextBlock &block, QVector<QPair<int, QString>> *flagged);
+    QVector<SpellToken> spellTokensForBlock(const QTextBlock &block) const;
+    QTextCursor misspelledWordAt(int position) const;
+    QList<QAction*> createSuggestionActions(const QStringList &suggestions, const QTextCursor &cursor, QMenu *menu);
     QTextCursor findWordUnderCursor();
 };
@@ -1,9 +1,18 @@
 // filemanager.h
 #pragma once
 
+#include <QDateTime>
+#include <QFuture>
 #include <QObject>
 #include <QString>
+#include <QStringList>
+#include <memory>
+#include "htmlexporter.h"
+#include "linediff.h"
+#include "pdfexporter.h"
+#include "textcodec.h"
 class EditorWidget;
+class DocumentLoader;
 class QTextDocument;
 
 class FileManager : public QObject
@@ -13,14 +22,42 @@ class FileManager : public QObject
 public:
     explicit FileManager(QObject *parent = nullptr);
 
-    bool loadFile(const QString &fileName, EditorWidget *editor);
-    bool saveFile(const QString &fileName, EditorWidget *editor);
-    bool exportToHtml(const QString &fileName, EditorWidget *editor);
-    bool exportToPdf(const QString &fileName, EditorWidget *editor);
+    /// Starts streaming @p fileName into @p editor; returns nullptr after reporting an error
+    DocumentLoader *loadFile(const QString &fileName, EditorWidget *editor);
+    /// Outcome of a background save
+    struct SaveResult {
+        bool ok = false;
+        QString errorString;
+        qint64 size = -1;   ///< The written file as stat'ed right after the write
+        QDateTime modified;
+    };
+
+    /// Snapshots the editor's Markdown and writes it atomically on a worker thread
+    QFuture<SaveResult> saveFileAsync(const QString &fileName, EditorWidget *editor);
+
+    /// Encodes @p markdown and replaces @p fileName through QSaveFile; safe to call from any thread
+    static SaveResult writeFileAtomically(const QString &fileName, const QString &markdown,
+                                          const TextCodec::FileFormat &format);
+
+    /// Outcome of comparing an editor with its file on disk
+    struct ReloadResult {
+        bool ok = false;
+        QString errorString;
+        QStringList lines;              ///< The file's text, split into lines
+        QVector<LineDiff::Hunk> hunks;  ///< Changes from the editor's Markdown to lines
+        TextCodec::FileFormat format;
+    };
+
+    /// Snapshots the editor's Markdown, then reads @p fileName and diffs the two on a worker thread
+    QFuture<ReloadResult> diffWithDiskAsync(const QString &fileName, EditorWidget *editor);
+
+    /// Streams the editor's Markdown to @p fileName as HTML on a worker thread; progress is reported in 1/1000 steps
+    QFuture<HtmlExporter::Result> exportToHtmlAsync(const QString &fileName, EditorWidget *editor);
+    /// Paginates the editor's Markdown into @p fileName as PDF on a worker thread; progress is reported in 1/1000 steps
+    QFuture<PdfExporter::Result> exportToPdfAsync(const QString &fileName, EditorWidget *editor);
 
 signals:
 
 private:
-    // Helper functions if needed
-    QString convertMarkdownToHtml(const QString &markdown);
+    std::shared_ptr<PdfExporter::LayoutCache> pdfLayoutCache; // Shared with running exports
 };
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "findengine.h"
+#include <QFuture>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @brief Find in files over a folder tree
+ *
+ * The tree is listed breadth first, each level's folders in parallel on the
+ * thread pool, and the files found on a level are searched in parallel
+ * before the next level is listed. Every file is memory-mapped; a
+ * case-sensitive literal query is first looked for in the mapped bytes, so
+ * only files that contain it are decoded. Matching is FindEngine's on the
+ * decoded text, so a file yields the matches the find bar would find in it.
+ *
+ * Each file with matches is reported as soon as it has been searched, in no
+ * particular order. Cancelling the future stops the walk and skips the files
+ * not searched yet.
+ */
+namespace FileSearch
+{
+    struct Query {
+        QString rootPath;
+        QString pattern;
+        FindEngine::Options options;
+        QStringList nameFilters;  ///< Wildcards of the files searched at all, as in the file explorer
+        QStringList includeGlobs; ///< If any, files must also match one of these
+        QStringList excludeGlobs; ///< Files and folders matching one of these are skipped
+    };
+
+    struct Hit {
+        int line = 0;          ///< Raw line, counted from 0
+        int column = 0;
+        int length = 0;
+        QString preview;       ///< The line, shortened around the match when it is long
+        int previewColumn = 0; ///< Where the match starts in the preview
+    };
+
+    struct FileResult {
+        QString filePath;
+        QVector<Hit> hits;
+        bool truncated = false; ///< The file has more matches than were reported
+    };
+
+    /// Starts the search; each result is one file with matches
+    QFuture<FileResult> search(const Query &query);
+
+    /// Globs as typed in an include or exclude field, separated by commas or whitespace
+    QStringList parseGlobs(const QString &text);
+}
@@ -5,6 +5,10 @@
 #include <QLabel>
 #include <QCheckBox>
 #include <QPushButton>
+#include <QPointer>
+#include <QFutureWatcher>
+#include <QTimer>
+#include "findengine.h"
 
 class EditorWidget;
 
@@ -12,7 +16,22 @@ class EditorWidget;
  * @brief Find bar widget for searching text in documents
  *
  * Embedded search bar that appears at the bottom of the editor
- * with support for case-sensitive and whole-word searches.
+ * with support for case-sensitive, whole-word and regular expression
+ * searches, and for replacing matches.
+ *
+ * Every query finds all matches at once with FindEngine, on a snapshot of
+ * the Markdown source taken when the document changed; while typing, each
+ * query narrows the matches of the one before. Next/previous pick the
+ * neighbouring match with a binary search.
+ *
+ * Match offsets map to the document through the snapshot's line offsets and
+ * EditorWidget::blockOfRawLine(). Selecting a match reveals its block, so
+ * matches in link targets and markup can be shown; the visible blocks that
+ * are rendered highlight the occurrences in their rendered text.
+ *
+ * Replace All builds the new text of every line with a match from the
+ * snapshot and hands the lines to EditorWidget::replaceRawLines(), which
+ * edits only those blocks, back to front, in one undo step.
  */
 class FindBarWidget : public QWidget
 {
@@ -27,6 +46,9 @@ public:
     /// Show the find bar and focus the input
     void showFindBar();
 
+    /// Show the find bar with the focus on the replacement
+    void showReplaceBar();
+
     /// Hide the find bar
     void hideFindBar();
 
@@ -50,19 +72,65 @@ private slots:
     void onFindPrevious();
     void onFindTextEdited();
     void onClose();
+    void onReplace();
+    void onReplaceAll();
+    void onSearchResultsReady(int begin, int end);
+    void onSearchFinished();
+    void onDocumentChanged();
+    void onCursorMoved();
+    void refreshHighlights();
 
 private:
+    // Navigation waiting for matches the running search has not reported yet
+    enum class PendingStep {
+        None,
+        Next,
+        Previous,
+        Nearest, // First match at or after the selection, which keeps the current match while typing
+        ReplaceAll
+    };
+
     void createLayout();
-    void updateFindStatus(bool found);
+    void updateFindStatus();
+    void startSearch();
+    void cancelSearch();
+    bool matchesAreCurrent() const;
+    void step(PendingStep direction);
+    void resolvePendingStep();
+    void selectMatch(int match);
+    int lineOfOffset(int offset) const;
+    int rawOffsetOf(int position) const;
+    void clearHighlights();
+    void replaceAll();
 
     QLineEdit *findLineEdit;
     QLabel *findStatusLabel;
     QCheckBox *caseSensitiveCheckBox;
     QCheckBox *wholeWordsCheckBox;
+    QCheckBox *regularExpressionCheckBox;
+    QLineEdit *replaceLineEdit;
+    QPushButton *replaceButton;
+    QPushButton *replaceAllButton;
     QPushButton *findNextButton;
     QPushButton *findPreviousButton;
     QPushButton *closeButton;
 
-    EditorWidget *currentEditor;
+    QPointer<EditorWidget> currentEditor;
     bool m_isFindBarVisible;
+
+    QFutureWatcher<FindEngine::Matches> *searchWatcher;
+    QTimer *researchTimer;          // Searches again once changes to the document pause
+    FindEngine::Matches matches;    // Sorted by position, in searchedEditor at searchRevision
+    QPointer<EditorWidget> searchedEditor;
+    quint64 searchRevision;
+    QString searchedSnapshot;       // Markdown source the search runs on; matches are offsets in it
+    QVector<int> searchedLineStarts; // Offsets of the snapshot's lines, the raw lines of the editor
+    QString searchedPattern;
+    FindEngine::Options searchedOptions;
+    bool searchComplete;
+    int currentMatch;               // Match selected by the last step, or -1
+    PendingStep pendingStep;
+    int cursorBlockNumber;          // Block the highlights were last laid out around
+    bool invalidExpression;         // The query is a regular expression that does not compile
+    int replacedCount;              // Matches the last Replace All replaced, shown until the next query, or -1
 };
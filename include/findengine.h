@@ -0,0 +1,92 @@
+#pragma once
+
+#include <QFuture>
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Find-all search over a snapshot of a document
+ *
+ * The search runs on the thread pool over its own copy of the text, so the
+ * editor stays responsive and may change meanwhile; callers keep the
+ * revision the snapshot was taken at and search again when it moved on.
+ * Matches are reported in batches as the scan advances, each batch
+ * following the previous one, so the concatenated results are sorted by
+ * position and can be navigated with a binary search.
+ *
+ * The scan compares the first and last code unit of the query at 8 (SSE2)
+ * or 16 (AVX2, chosen at run time) positions at once and verifies only the
+ * positions where both agree. A query that extends the previous one over
+ * the same text needs no scan at all: narrow() checks the previous matches.
+ *
+ * Regular expressions are matched by QRegularExpression with `^` and `$`
+ * anchored at line ends. Matches never span lines, so they map to the
+ * editor line by line; a match that would is skipped.
+ */
+namespace FindEngine
+{
+    struct Options {
+        bool caseSensitive = false;
+        bool wholeWords = false; ///< Word boundaries as `\b` in QRegularExpression
+        bool regularExpression = false;
+    };
+
+    struct Match {
+        int start = 0;
+        int length = 0;
+    };
+
+    using Matches = QVector<Match>;
+
+    /**
+     * @brief Text that replaces matches
+     *
+     * In a regular expression search `\0` to `\99` in the replacement stand
+     * for the captured groups and `\\` for a backslash; otherwise the
+     * replacement is taken as it is.
+     */
+    class Replacer
+    {
+    public:
+        Replacer(const QString &pattern, const QString &replacement, const Options &options);
+
+        /// Text replacing @p match, one of the matches of the pattern in @p text
+        QString replacementFor(const QString &text, const Match &match) const;
+
+    private:
+        struct Piece {
+            QString text;
+            int group = -1; ///< Captured group inserted after the text, if not negative
+        };
+
+        QRegularExpression m_expression;
+        QVector<Piece> m_pieces;
+    };
+
+    /// Expression a regular expression search for @p pattern runs; check isValid() before searching
+    QRegularExpression regularExpression(const QString &pattern, const Options &options);
+
+    /// Starts finding every non-overlapping match of @p pattern in @p text
+    QFuture<Matches> findAll(const QString &text, const QString &pattern, const Options &options);
+
+    /// Every match of @p pattern in @p text, found on the calling thread; meant for short texts
+    Matches findIn(const QString &text, const QString &pattern, const Options &options);
+
+    /// Every match of @p expression, made by regularExpression(), in @p text; for searching many texts
+    Matches findIn(const QString &text, const QRegularExpression &expression);
+
+    /// Offsets at which the lines of @p text start, the first being 0
+    QVector<int> lineStarts(QStringView text);
+
+    /// Where @p previous occurs in @p pattern, if every match of @p pattern contains a match of @p previous there; else -1
+    int narrowingOffset(const QString &previous, const QString &pattern, const Options &options);
+
+    /// Starts finding the matches of @p pattern among @p candidates, the complete matches in @p text of a query
+    /// found at @p offset in @p pattern
+    QFuture<Matches> narrow(const QString &text, const Matches &candidates, int offset, const QString &pattern,
+                            const Options &options);
+
+    /// Index of the first of the sorted @p matches starting at or after @p position, or matches.size()
+    int firstMatchFrom(const Matches &matches, int position);
+}
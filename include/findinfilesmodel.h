@@ -0,0 +1,51 @@
+#pragma once
+
+#include "filesearch.h"
+#include <QAbstractItemModel>
+#include <QDir>
+#include <QVector>
+
+/**
+ * @brief Results of a find in files as a two-level item model
+ *
+ * Files are the top-level rows, in the order the search reported them, and
+ * their matches the rows below. A model index carries 0 for a file and the
+ * file's row plus one for a match, so index() and parent() need no lookup.
+ * Results are only appended, each batch with one beginInsertRows(); text is
+ * built when a view asks for it, so a view with uniform row heights only
+ * ever touches the rows on screen.
+ */
+class FindInFilesModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    explicit FindInFilesModel(QObject *parent = nullptr);
+
+    /// Removes all results; file rows show paths relative to @p rootPath
+    void clear(const QString &rootPath);
+
+    /// Adds the files of @p results as new rows
+    void appendResults(const QVector<FileSearch::FileResult> &results);
+
+    int fileCount() const { return int(m_files.size()); }
+    int hitCount() const { return m_hitCount; }
+
+    /// File of a file or match row, or nullptr
+    const FileSearch::FileResult *fileAt(const QModelIndex &index) const;
+
+    /// Match of a match row, or nullptr
+    const FileSearch::Hit *hitAt(const QModelIndex &index) const;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+private:
+    QDir m_root;
+    QVector<FileSearch::FileResult> m_files;
+    int m_hitCount = 0;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QWidget>
+#include <QFutureWatcher>
+#include <QStringList>
+#include "filesearch.h"
+
+class FindInFilesModel;
+class QCheckBox;
+class QLabel;
+class QLineEdit;
+class QModelIndex;
+class QPushButton;
+class QTreeView;
+
+/**
+ * @brief Sidebar panel searching every note under the open folder
+ *
+ * Runs a FileSearch over the file explorer's folder, with its name filters
+ * and the include and exclude globs typed in the panel, and shows the files
+ * with matches as they are found. The results view has uniform row heights
+ * over a FindInFilesModel, so it only lays out the rows on screen however
+ * many matches there are. A new search, or Stop, cancels the running one.
+ */
+class FindInFilesWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit FindInFilesWidget(QWidget *parent = nullptr);
+    ~FindInFilesWidget();
+
+    /// Folder to search; a search already shown runs again there
+    void setRootPath(const QString &path);
+
+    /// Wildcards of the files searched at all, e.g. the file explorer's
+    void setNameFilters(const QStringList &filters);
+
+    /// Focus the query, selecting it
+    void focusQuery();
+
+signals:
+    /// A match was chosen; @p line is the raw line, counted from 0
+    void hitActivated(const QString &filePath, int line, int column, int length);
+
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+
+private slots:
+    void startSearch();
+    void stopSearch();
+    void onResultsReady(int begin, int end);
+    void onSearchFinished();
+    void onItemActivated(const QModelIndex &index);
+
+private:
+    void updateStatus();
+
+    QLineEdit *queryEdit;
+    QCheckBox *caseSensitiveCheckBox;
+    QCheckBox *wholeWordsCheckBox;
+    QCheckBox *regularExpressionCheckBox;
+    QLineEdit *includeEdit;
+    QLineEdit *excludeEdit;
+    QPushButton *stopButton;
+    QLabel *statusLabel;
+    QTreeView *resultsView;
+    FindInFilesModel *resultsModel;
+
+    QFutureWatcher<FileSearch::FileResult> *searchWatcher;
+    QString rootPath;
+    QStringList nameFilters;
+    bool searched = false;         // Results of a query are shown, so a new folder searches again
+    bool invalidExpression = false;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QString>
+#include <QStringView>
+#include <functional>
+
+class QIODevice;
+struct cmark_node;
+
+/**
+ * @brief Renders Markdown to a standalone HTML page without building it in memory
+ *
+ * The Markdown is fed to cmark in UTF-8 chunks and the parsed tree is walked
+ * node by node, writing HTML through a small buffered UTF-8 writer straight
+ * to the output device. Apart from the tree, memory use does not grow with
+ * the document, and nothing is converted back to UTF-16. The output matches
+ * cmark's own safe HTML renderer: raw HTML is omitted and dangerous URLs are
+ * dropped.
+ *
+ * All functions are reentrant and may run on worker threads.
+ */
+namespace HtmlExporter
+{
+    /// Receives lines rendered so far and the total; returning false cancels the export
+    using ProgressCallback = std::function<bool(qint64 done, qint64 total)>;
+
+    struct Result {
+        bool ok = false;
+        bool canceled = false;
+        QString errorString;
+    };
+
+    /// Parses @p markdown; free the tree with cmark_node_free()
+    cmark_node *parse(QStringView markdown);
+
+    /// Parses UTF-8 bytes as read from a file; invalid sequences become U+FFFD
+    cmark_node *parseUtf8(const char *data, qsizetype size);
+
+    /// Writes @p document as a complete HTML page titled @p title to @p device
+    Result writePage(cmark_node *document, const QString &title, QIODevice *device,
+                     const ProgressCallback &progress = {});
+
+    /// Renders @p document and replaces @p fileName with the page through QSaveFile
+    Result exportDocument(cmark_node *document, const QString &fileName,
+                          const ProgressCallback &progress = {});
+
+    /// Parses @p markdown and exports it to @p fileName
+    Result exportToFile(QStringView markdown, const QString &fileName,
+                        const ProgressCallback &progress = {});
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @brief Line-based diff used to apply external file changes in place
+ *
+ * Lines are interned to integers and the common prefix and suffix are
+ * trimmed before Myers' O(ND) algorithm runs on what remains, so a small
+ * change in a large file costs little more than reading it. Diffs with more
+ * than a few thousand edits fall back to a single hunk covering the
+ * differing middle.
+ */
+namespace LineDiff
+{
+    /// @p oldCount lines at @p oldStart were replaced by @p newCount lines at @p newStart
+    struct Hunk {
+        int oldStart = 0;
+        int oldCount = 0;
+        int newStart = 0;
+        int newCount = 0;
+    };
+
+    /// Hunks that turn @p oldLines into @p newLines, in ascending order; empty if they are equal
+    QVector<Hunk> diff(const QStringList &oldLines, const QStringList &newLines);
+}
@@ -6,29 +6,41 @@
 #include <QLabel>
 #include <QTabWidget>
 #include <QList>
+#include <QHash>
+#include <QSet>
+#include <QDateTime>
+#include <QFutureWatcher>
+#include "filemanager.h"
 
 class EditorWidget;
-class FileManager;
 class QString;
 class QAction;
 class QMenu;
 class QDockWidget;
 class QTimer;
+class QFileSystemWatcher;
 class QTreeWidget;
 class QTreeWidgetItem;
 class QVBoxLayout;
 
 class FindBarWidget;
 class DocumentOutlineWidget;
+class FindInFilesWidget;
 class SidebarFileExplorer;
 class ToastNotification;
-class OutlineDelegate;
+class TaskProgressWidget;
+class EditJournal;
+class OutlineIndex;
+class DocumentStats;
 
 // Structure to track editor and file path per tab
 struct EditorTab {
     EditorWidget *editor;
     QString filePath;
     bool isModified;
+    EditJournal *journal = nullptr; // Owned by the editor
+    OutlineIndex *outline = nullptr; // Owned by the editor
+    DocumentStats *stats = nullptr; // Owned by the editor
 };
 
 class MainWindow : public QMainWindow
@@ -41,6 +53,11 @@ public:
     
     void openFile(const QString &path = QString());
     void newFile();
+    bool recoverUnsavedDocuments(); // Offers documents left unsaved by a crash; true if any were reopened
+
+signals:
+    /// Emitted when a background save of @p editor completed or failed
+    void saveFinished(EditorWidget *editor);
 
 protected:
     void closeEvent(QCloseEvent *event) override;
@@ -56,6 +73,7 @@ private slots:
     void open();
     bool save();
     bool saveAs();
+    void saveAll();
     void exportToHtml();
     void exportToPdf();
     
@@ -63,6 +81,8 @@ private slots:
     void selectTheme();
     void about();
     void find();
+    void replace();
+    void findInFiles();
     bool isFindBarVisible() const;
     
     // Outline
@@ -82,12 +102,28 @@ private:
     
     // Tab management
     void openFileInNewTab(const QString &fileName);
+    void openSearchHit(const QString &fileName, int line, int column, int length);
     void updateTabTitle(int index);
     void updateWindowTitle();
     void updateActionsState();
     bool maybeSave();
     bool maybeSaveCurrentTab();
     void setCurrentFile(const QString &fileName);
+    int indexOfEditor(EditorWidget *editor) const;
+    void refreshAnalysis(const EditorTab &tab); // Recomputes outline and statistics only if stale
+
+    // Background saves
+    bool startSave(int index, const QString &fileName);
+    void onSaveFinished(EditorWidget *editor);
+    bool waitForSave(EditorWidget *editor); // Returns true if the document ended up saved
+
+    // External changes to open files
+    void watchFile(const QString &path);
+    void unwatchFile(const QString &path);
+    void rememberDiskState(const QString &path);
+    void onFileChangedOnDisk(const QString &path);
+    void reloadChangedFiles();
+    void startReload(EditorWidget *editor, const QString &path);
     
     // UI components
     void setupEditorConnections(EditorWidget *editor);
@@ -96,14 +132,35 @@ private:
     QTabWidget *tabWidget;
     QList<EditorTab> editorTabs;
     QPointer<FileManager> fileManager;
+
+    // A save in flight for one editor; keyed by editor since tab indices shift
+    struct PendingSave {
+        QFutureWatcher<FileManager::SaveResult> *watcher = nullptr;
+        QString fileName;
+        quint64 revision = 0;     // Content revision that was snapshotted
+        bool saveAgain = false;   // Save requested again while this one ran
+        QString nextFileName;
+    };
+    QHash<EditorWidget*, PendingSave> pendingSaves;
+
+    // Open files are watched; notifications are coalesced because many
+    // tools save by writing a temporary file and renaming it over the original.
+    QFileSystemWatcher *fileWatcher;
+    QTimer *reloadTimer;
+    QSet<QString> changedFiles;
+    struct DiskState {
+        qint64 size = -1;
+        QDateTime modified;
+    };
+    QHash<QString, DiskState> knownDiskStates; // Last version loaded, saved or declined per file
     
     // Sidebar
     QDockWidget *sidebarDock;
     QTabWidget *sidebarTabs;
     SidebarFileExplorer *fileExplorer;
     DocumentOutlineWidget *outlineWidget;
+    FindInFilesWidget *findInFilesWidget;
     QAction *toggleSidebarAct;
-    OutlineDelegate *outlineDelegate;
     
     // Find bar
     FindBarWidget *findBarWidget;
@@ -114,21 +171,24 @@ private:
     // Status bar
     QLabel *wordCountLabel;
     QLabel *charCountLabel;
+    TaskProgressWidget *taskProgress;
     
     // Timers
     QTimer *wordCountTimer;
-    QTimer *outlineTimer;
     
     // Menu actions
     QAction newAct;
     QAction openAct;
     QAction saveAct;
     QAction saveAsAct;
+    QAction saveAllAct;
     QAction exportHtmlAct;
     QAction exportPdfAct;
     QAction exitAct;
     QAction selectThemeAct;
     QAction aboutAct;
     QAction findAct;
+    QAction replaceAct;
+    QAction findInFilesAct;
     QAction closeTabAct;
 };
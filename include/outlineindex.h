@@ -0,0 +1,105 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTextBlock>
+#include <QVector>
+
+class EditorWidget;
+
+/**
+ * @brief Headings of one document, kept current edit by edit
+ *
+ * The index follows EditorWidget::rawLinesChanged() instead of reparsing the
+ * document. It remembers a small state per raw line (what kind of line it is
+ * and whether a code fence is open after it), so an edit only rescans the
+ * lines it replaced, the paragraphs around them (a Setext underline turns
+ * the paragraph above it into a heading) and, when a fence opened or closed,
+ * the following lines until the fence state is the same as before. Headings are kept sorted by line;
+ * those below the edit only have their line numbers shifted.
+ *
+ * Headings are recognised line by line as CommonMark describes ATX and
+ * Setext headings outside fenced code. Their text is the inline content
+ * parsed with cmark, as in the rendered document.
+ *
+ * Each heading also keeps its QTextBlock, which survives edits elsewhere in
+ * the document. Navigation checks that the block still shows the heading's
+ * line and only searches the document again when it does not.
+ */
+class OutlineIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Heading {
+        int line = 0;  ///< Raw line, counted from 0; the first of a Setext heading's lines
+        int level = 1;
+        QString text;  ///< Plain text of the inline content; may be empty
+        QTextBlock block; ///< Last known block of the heading; see blockOfHeading()
+    };
+
+    /// Indexes the headings of @p editor, which becomes the parent
+    explicit OutlineIndex(EditorWidget *editor);
+
+    EditorWidget *editor() const { return m_editor; }
+
+    /// Headings sorted by line
+    const QVector<Heading> &headings() const { return m_headings; }
+
+    /// Rescans the whole document
+    void reset();
+
+    /// EditorWidget::contentRevision() the headings reflect
+    quint64 revision() const { return m_revision; }
+
+    /// Block of heading @p heading, found again if the stored reference went stale
+    QTextBlock blockOfHeading(int heading);
+
+    /// Last heading at or above raw line @p line, or -1; the section containing the line
+    int headingAtLine(int line) const;
+
+signals:
+    /// Headings [first, first + removed) were replaced by [first, first + added); later ones moved
+    void headingsChanged(int first, int removed, int added);
+
+    /// Every heading may have changed
+    void headingsReset();
+
+private:
+    enum class LineKind : quint8 {
+        Blank,
+        Paragraph, // Text a Setext underline below would turn into a heading
+        Atx,
+        EqualsUnderline,
+        DashUnderline,
+        Fence,
+        Code,
+        Other
+    };
+
+    struct LineState {
+        LineKind kind = LineKind::Blank;
+        quint8 level = 0;       // ATX heading level
+        char fenceChar = 0;     // Fence still open after this line, if fenceLength > 0
+        quint16 fenceLength = 0;
+
+        bool sameFence(const LineState &other) const
+        {
+            return fenceLength == other.fenceLength && fenceChar == other.fenceChar;
+        }
+    };
+
+    static LineState scanLine(QStringView line, const LineState &previous);
+    static QString headingText(QStringView line, LineKind kind);
+
+    void onRawLinesChanged(int firstLine, int removedLines, const QStringList &addedLines);
+    QString rawLine(int line) const;
+    int headingLevel(int line) const;
+    QVector<Heading> collectHeadings(int first, int end, const QStringList &texts, int textsFirst) const;
+
+    EditorWidget *m_editor;
+    QVector<LineState> m_lines;
+    QVector<Heading> m_headings;
+    quint64 m_revision = 0;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QAbstractItemModel>
+#include <QPointer>
+#include <QVector>
+
+class OutlineIndex;
+
+/**
+ * @brief Heading tree of an OutlineIndex as a lightweight item model
+ *
+ * Every heading is one small node in a flat array holding its parent,
+ * level, row, text and the ids of its children, so index(), parent(),
+ * rowCount() and data() are a couple of array reads. Model indexes carry
+ * the node id, which stays the same while the heading moves. Nodes keep
+ * their own copy of the text because a proxy on top may read data() while
+ * the tree is still catching up with OutlineIndex::headings().
+ *
+ * Edits that only change heading text are reported as dataChanged(). Added
+ * and removed headings are reported as inserted and removed rows, with the
+ * headings whose parent changes as moved rows, so views keep their
+ * expansion and selection; only headingsReset() rebuilds the tree.
+ */
+class OutlineModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    explicit OutlineModel(QObject *parent = nullptr);
+
+    /// Shows the headings of @p index and follows its changes; nullptr empties the model
+    void setIndex(OutlineIndex *index);
+    OutlineIndex *outlineIndex() const { return m_index; }
+
+    /// Position of the heading in OutlineIndex::headings(), or -1
+    int headingAt(const QModelIndex &index) const;
+    QModelIndex indexOfHeading(int heading) const;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+private:
+    struct Node {
+        int parent;      // Node, or -1 for top level
+        int level;
+        int row;         // Among the parent's children
+        int heading;     // Position in OutlineIndex::headings()
+        QString text;
+        QVector<int> children;
+    };
+
+    void buildTree();
+    void onHeadingsReset();
+    void onHeadingsChanged(int first, int removed, int added);
+    void removeHeading(int heading);
+    void insertHeading(int heading, int level, const QString &text);
+    void moveChildren(int from, int first, int count, int to, int row);
+    void renumber(int node, int fromRow);
+    QVector<int> &childrenOf(int node) { return node < 0 ? m_topLevel : m_nodes[node].children; }
+    QModelIndex indexOfNode(int node) const;
+
+    QPointer<OutlineIndex> m_index;
+    QVector<Node> m_nodes;         // By node id; ids of removed headings are reused
+    QVector<int> m_nodeOfHeading;  // Parallel to OutlineIndex::headings()
+    QVector<int> m_topLevel;
+    QVector<int> m_freeNodes;
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "htmlexporter.h"
+#include <QByteArray>
+#include <QCache>
+#include <QColor>
+#include <QFont>
+#include <QMutex>
+#include <QPicture>
+#include <QString>
+#include <QStringView>
+#include <QVector>
+
+struct cmark_node;
+
+/**
+ * @brief Lays out Markdown and paginates it into a PDF without a GUI thread
+ *
+ * PdfPaginator lays out each top-level cmark block straight from the tree
+ * with QTextLayout, records it into a QPicture and places it onto QPdfWriter
+ * pages, splitting blocks taller than the remaining space between text
+ * lines. There is no HTML round trip. Only one block's layout is alive at a
+ * time and the PDF is written straight into a QSaveFile, so memory use does
+ * not grow with the page count.
+ *
+ * Recorded blocks can be kept in a LayoutCache keyed by their content and
+ * style, so exporting a document again only lays out the blocks that changed.
+ *
+ * All functions are reentrant and may run on worker threads once a
+ * QGuiApplication exists.
+ */
+namespace PdfExporter
+{
+    /// Receives top-level blocks placed so far and the total whenever a page is completed; returning false cancels
+    using ProgressCallback = HtmlExporter::ProgressCallback;
+
+    struct Result {
+        bool ok = false;
+        bool canceled = false;
+        int pageCount = 0;
+        QString errorString;
+    };
+
+    /**
+     * @brief Fonts and colours used on the pages
+     *
+     * A plain value, so it can be filled from ThemeManager on the GUI thread
+     * and handed to a worker. The defaults match the Light theme.
+     */
+    struct Style {
+        Style();
+
+        QFont bodyFont;
+        QFont codeFont;
+        qreal lineSpacing = 1.25;       ///< Multiple of the font's line height
+        qreal pageMarginMillimeters = 20;
+
+        QColor page = QColor("#FFFFFF");
+        QColor text = QColor("#24292F");
+        QColor heading = QColor("#24292F");
+        QColor link = QColor("#0366D6");
+        QColor image = QColor("#6A737D");
+        QColor codeText = QColor("#9C27B0");
+        QColor codeBackground = QColor("#F6F8FA");
+        QColor quoteText = QColor("#6A737D");
+        QColor tableHeaderBackground = QColor("#F6F8FA");
+        QColor border = QColor("#C8C8C8");
+        QColor rule = QColor("#DCDCDC");
+
+        /// Identifies the style in LayoutCache keys
+        QByteArray fingerprint() const;
+    };
+
+    /// A top-level block after layout, ready to be replayed onto pages
+    struct LaidOutBlock {
+        QPicture picture;
+        qreal height = 0;
+        qreal spaceBefore = 0;      ///< Collapsed with the previous block's spaceAfter; dropped at the top of a page
+        qreal spaceAfter = 0;
+        bool keepWithNext = false;  ///< Headings move to the next page rather than end one
+        QVector<qreal> lineBottoms; ///< Sorted offsets where the block may be split across pages
+    };
+
+    /**
+     * @brief Thread-safe store of laid-out blocks shared between exports
+     *
+     * Bounded by the recorded size of its pictures; least recently used
+     * blocks are dropped first.
+     */
+    class LayoutCache
+    {
+    public:
+        explicit LayoutCache(qsizetype maxBytes = 32 * 1024 * 1024);
+
+        bool find(const QByteArray &key, LaidOutBlock *block);
+        void insert(const QByteArray &key, const LaidOutBlock &block);
+
+    private:
+        QMutex m_mutex;
+        QCache<QByteArray, LaidOutBlock> m_blocks;
+    };
+
+    /// Paginates @p document and replaces @p fileName with the PDF through QSaveFile
+    Result exportDocument(cmark_node *document, const QString &fileName, const Style &style = Style(),
+                          LayoutCache *cache = nullptr, const ProgressCallback &progress = {});
+
+    /// Parses @p markdown and exports it to @p fileName
+    Result exportToFile(QStringView markdown, const QString &fileName, const Style &style = Style(),
+                        LayoutCache *cache = nullptr, const ProgressCallback &progress = {});
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "pdfexporter.h"
+
+class QPainter;
+class QPdfWriter;
+
+/**
+ * @brief Lays out cmark blocks with QTextLayout and places them on PDF pages
+ *
+ * layOut() turns one top-level block (a heading, paragraph, list, code
+ * block, quote, rule or pipe table) into a LaidOutBlock: text is shaped with
+ * QTextLayout in the Style's fonts and painted into a QPicture together with
+ * backgrounds, markers and borders. place() then puts blocks onto the pages
+ * one after another, collapsing the space between them, keeping headings with
+ * the text that follows and splitting long blocks between lines.
+ *
+ * The paginator draws on the painter it is given and owns no output; it is
+ * meant to live on the stack of one export.
+ */
+class PdfPaginator
+{
+public:
+    PdfPaginator(QPdfWriter &writer, QPainter &painter, const PdfExporter::Style &style,
+                 const PdfExporter::ProgressCallback &progress);
+
+    qreal width() const { return m_width; }
+    int pageCount() const { return m_pageCount; }
+
+    /// Lays out the top-level block @p node at the page width
+    PdfExporter::LaidOutBlock layOut(cmark_node *node) const;
+
+    /// Places @p block below the previous one; false if the export was canceled at a page break
+    bool place(const PdfExporter::LaidOutBlock &block, qint64 placed, qint64 total);
+
+    /// Reports the last page
+    bool finish(qint64 total);
+
+private:
+    void beginPage();
+    bool newPage(qint64 placed, qint64 total);
+    void draw(const PdfExporter::LaidOutBlock &block, qreal offset, qreal height);
+
+    QPdfWriter &m_writer;
+    QPainter &m_painter;
+    const PdfExporter::Style &m_style;
+    const PdfExporter::ProgressCallback &m_progress;
+    const qreal m_width;
+    const qreal m_pageHeight;
+    const qreal m_keepWithNextHeight; // Room left below a heading for the lines that follow it
+    qreal m_y = 0;
+    qreal m_pendingSpace = 0; // Space after the previous block, owed unless a page starts
+    int m_pageCount = 1;
+};
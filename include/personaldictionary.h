@@ -0,0 +1,82 @@
+#pragma once
+
+#include <QFile>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <QTimer>
+
+/**
+ * @brief Persistent list of words the user accepted, shared by every editor
+ *
+ * Words live in a sorted binary file that is memory-mapped and binary searched
+ * in place, so opening a dictionary with tens of thousands of words does not
+ * parse or allocate per word. New words go to an in-memory set and a plain
+ * append log next to the binary file; the log is written and fsync'd in
+ * batches and merged into the sorted file when it grows or the dictionary is
+ * closed. Appending and merging take a lock file, so several running
+ * instances sharing a dictionary keep each other's words.
+ *
+ * One instance exists per file: user() for the global dictionary and
+ * forWorkspace() for a project folder.
+ */
+class PersonalDictionary : public QObject
+{
+    Q_OBJECT
+
+public:
+    ~PersonalDictionary();
+
+    /// Dictionary stored in the user's application data directory
+    static PersonalDictionary *user();
+
+    /// Dictionary for the workspace rooted at @p rootPath, or nullptr if the path is empty
+    static PersonalDictionary *forWorkspace(const QString &rootPath);
+
+    /// True if @p word, or its lower-cased form when @p word is capitalised, was added
+    bool contains(QStringView word) const;
+
+    /// Adds @p word and schedules it to be persisted; returns false if it was already known
+    bool addWord(const QString &word);
+
+    /// Number of words, including those not yet merged into the sorted file
+    int wordCount() const;
+
+    /// Writes pending log entries and fsyncs the log
+    void flush();
+
+    /// Merges the sorted file and log on disk with the words added here, then truncates the log
+    bool compact();
+
+    QString filePath() const { return m_path; }
+
+signals:
+    /// Emitted after a word was added so other editors can re-check
+    void wordsChanged();
+
+private:
+    explicit PersonalDictionary(const QString &path, QObject *parent = nullptr);
+
+    static PersonalDictionary *instanceFor(const QString &path);
+
+    bool map();
+    void unmap();
+    void loadLog();
+    bool containsExact(QStringView word) const;
+    QStringView sortedWordAt(quint32 index) const;
+    bool appendUnflushed();
+    QString logPath() const;
+    QString lockPath() const;
+
+    QString m_path;
+    QFile m_file;
+    const quint32 *m_offsets = nullptr;  ///< wordCount + 1 offsets into m_strings
+    const char16_t *m_strings = nullptr;
+    quint32 m_sortedCount = 0;
+
+    QSet<QString> m_logWords;            ///< Words added since the last compaction
+    QStringList m_unflushed;             ///< Log entries not yet written to disk
+    QTimer m_flushTimer;
+};
@@ -51,6 +51,9 @@ public:
     
     /// Get the current root path
     QString currentPath() const;
+
+    /// Wildcards of the files shown
+    QStringList nameFilters() const;
     
     /// Refresh the file tree view
     void refresh();
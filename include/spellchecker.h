@@ -2,9 +2,13 @@
 #include <QObject>
 #include <QString>
 #include <QStringList>
+#include <QFutureWatcher>
+#include <QPointer>
 #include <memory>
 
 class Hunspell;
+class CompiledDictionary;
+class PersonalDictionary;
 
 class SpellChecker : public QObject
 {
@@ -24,6 +28,14 @@ public:
 
     /**
      * @brief Loads a dictionary for a specific language.
+     *
+     * If a compiled dictionary for the language is cached and up to date it is
+     * memory-mapped and used immediately; Hunspell is only loaded, in the
+     * background, once a word is not in the compiled set. Otherwise Hunspell
+     * is loaded synchronously and the cache is compiled in the background for
+     * the next load. Either way one Hunspell instance per language serves
+     * every editor.
+     *
      * @param language The language code (e.g., "en_US", "fr_FR").
      * @return true if the dictionary was loaded successfully, false otherwise.
      */
@@ -45,17 +57,98 @@ public:
     QStringList getSuggestions(const QString &word) const;
 
     /**
-     * @brief Adds a word to the personal dictionary (runtime only).
+     * @brief Returns already computed suggestions without blocking.
+     * @param word The misspelled word.
+     * @param suggestions Receives the cached suggestions.
+     * @return true if suggestions for @p word were cached.
+     */
+    bool cachedSuggestions(const QString &word, QStringList *suggestions) const;
+
+    /**
+     * @brief Computes suggestions on a worker thread.
+     *
+     * Requests are served by a single-thread pool with its own Hunspell
+     * instance, shared by every editor using the same language, so the GUI
+     * thread's spell checks never wait on a slow suggest call. Cancelling
+     * the returned future before the request starts drops it; results are
+     * cached for later calls.
+     *
+     * @param word The misspelled word.
+     * @return A future holding the list of suggested corrections.
+     */
+    QFuture<QStringList> requestSuggestions(const QString &word);
+
+    /**
+     * @brief Queues low-priority suggestion requests so later lookups are instant.
+     * @param words Recently flagged words, most relevant first.
+     */
+    void precomputeSuggestions(const QStringList &words);
+
+    /**
+     * @brief Adds a word to the user's persistent personal dictionary.
+     *
+     * The dictionary is shared by every editor, so all open tabs stop
+     * flagging the word once personalDictionaryChanged() is handled.
+     *
      * @param word The word to add.
      */
     void addWord(const QString &word);
 
+    /**
+     * @brief Adds a word to the current workspace's dictionary.
+     * @param word The word to add.
+     * @note Falls back to addWord() when no workspace is set.
+     */
+    void addWordToWorkspace(const QString &word);
+
+    /**
+     * @brief Selects the workspace whose dictionary is consulted alongside the user's.
+     * @param rootPath The workspace folder, or an empty string for none.
+     */
+    void setWorkspacePath(const QString &rootPath);
+
+    /**
+     * @brief Checks if a workspace dictionary is active.
+     * @return true if setWorkspacePath() was given a folder.
+     */
+    bool hasWorkspaceDictionary() const;
+
     /**
      * @brief Checks if the spell checker is properly initialized.
      * @return true if initialized, false otherwise.
      */
     bool isInitialized() const;
 
+signals:
+    /**
+     * @brief Emitted when Hunspell finished loading in the background.
+     *
+     * Until then only the compiled dictionary answers lookups, so callers
+     * should re-run their spell pass to pick up the remaining verdicts.
+     */
+    void dictionaryReady();
+
+    /**
+     * @brief Emitted when words were added to a personal dictionary in use,
+     * from this or any other editor, or the workspace changed.
+     */
+    void personalDictionaryChanged();
+
+private slots:
+    void onHunspellLoaded();
+
 private:
-    std::unique_ptr<Hunspell> hunspell; ///< Pointer to the Hunspell instance.
+    struct HunspellBackend;
+    struct SuggestionEngine;
+
+    Hunspell *hunspellInstance() const;
+
+    std::shared_ptr<HunspellBackend> hunspellBackend; ///< Hunspell for checking, shared per language.
+    std::unique_ptr<CompiledDictionary> compiledDictionary; ///< Memory-mapped word forms, if cached.
+    PersonalDictionary *userDictionary = nullptr; ///< Shared per-user word list.
+    QPointer<PersonalDictionary> workspaceDictionary; ///< Shared per-workspace word list, if any.
+    QFutureWatcher<std::shared_ptr<Hunspell>> *hunspellLoader = nullptr; ///< Watches the backend's background load.
+    mutable bool watchingHunspellLoad = false; ///< Whether hunspellLoader follows the current backend.
+    std::shared_ptr<SuggestionEngine> suggestionEngine; ///< Suggestion thread and cache, shared per language.
+    QList<QFuture<QStringList>> pendingPrecomputes; ///< Idle-time jobs, cancelled on language change.
 };
\ No newline at end of file
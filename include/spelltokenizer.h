@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QString>
+#include <QStringView>
+#include <QVector>
+
+/**
+ * @brief A word span emitted by SpellTokenizer, relative to the tokenized text
+ */
+struct SpellToken {
+    int start = -1;
+    int length = 0;
+
+    bool isValid() const { return start >= 0 && length > 0; }
+    int end() const { return start + length; }
+};
+
+/**
+ * @brief Markdown-aware tokenizer that only emits prose words for spell checking
+ *
+ * Skips inline code spans, autolinks, HTML tags, link/image destinations,
+ * bare URLs, e-mail addresses, paths and identifiers such as my_variable_name
+ * or camelCase. Words may contain Unicode letters, combining marks and
+ * internal apostrophes (don't, l'homme).
+ */
+namespace SpellTokenizer
+{
+    /// Tokenize one raw Markdown line (a block that is not inside a fenced code block)
+    QVector<SpellToken> tokenizeMarkdownLine(QStringView line);
+
+    /// Tokenize already rendered text, where Markdown syntax is no longer present
+    QVector<SpellToken> tokenizeProse(QStringView text);
+
+    /// Fenced code block open after a line; none while length is 0
+    struct CodeFence {
+        QChar marker;
+        int length = 0;
+    };
+
+    /// Moves @p fence past the raw line; true if the line opens or closes a
+    /// fenced code block. Only a run of the opening character, at least as
+    /// long as the opening run, closes it.
+    bool advanceCodeFence(QStringView line, CodeFence &fence);
+
+    /// Returns the token covering @p position, or an invalid token
+    SpellToken tokenAt(const QVector<SpellToken> &tokens, int position);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <QList>
+#include <QWidget>
+#include <functional>
+
+class QLabel;
+class QProgressBar;
+class QToolButton;
+
+/**
+ * @brief Status bar indicator for long-running work such as loading or exporting
+ *
+ * Several tasks may run at once; the most recently started one is shown and
+ * the cancel button cancels that task. The widget hides itself when no task
+ * is left.
+ */
+class TaskProgressWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit TaskProgressWidget(QWidget *parent = nullptr);
+
+    /// Registers a task and returns its id; @p onCancel runs when the user cancels it
+    int startTask(const QString &label, std::function<void()> onCancel);
+
+    /// Updates the progress of task @p id; a @p total of 0 shows a busy indicator
+    void setTaskProgress(int id, qint64 done, qint64 total);
+
+    /// Updates the label of task @p id
+    void setTaskLabel(int id, const QString &label);
+
+    /// Removes task @p id
+    void finishTask(int id);
+
+private:
+    struct Task {
+        int id;
+        QString label;
+        qint64 done;
+        qint64 total;
+        std::function<void()> onCancel;
+        bool canceled;
+    };
+
+    void cancelCurrentTask();
+    void updateDisplay();
+    Task *findTask(int id);
+
+    QLabel *label;
+    QProgressBar *progressBar;
+    QToolButton *cancelButton;
+    QList<Task> tasks;
+    int nextTaskId = 1;
+};
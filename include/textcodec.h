@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include <QStringView>
+
+/**
+ * @brief UTF-8 validation, UTF-8/UTF-16 transcoding and line-ending handling
+ *
+ * The kernels process ASCII runs 16 (SSE2) or 32 (AVX2, chosen at run time)
+ * bytes at a time and fall back to scalar code for multi-byte sequences and
+ * on other architectures. Markdown is overwhelmingly ASCII, so loading and
+ * saving run close to memory bandwidth.
+ */
+namespace TextCodec
+{
+    enum class LineEnding {
+        LF,
+        CRLF
+    };
+
+    /// How a file was stored on disk, so a save writes it back the same way
+    struct FileFormat {
+        bool byteOrderMark = false;
+#ifdef Q_OS_WIN
+        LineEnding lineEnding = LineEnding::CRLF;
+#else
+        LineEnding lineEnding = LineEnding::LF;
+#endif
+    };
+
+    /// True if @p size bytes at @p data are well-formed UTF-8
+    bool isValidUtf8(const char *data, qsizetype size);
+
+    /// Line ending of the first line break in @p data; LF if there is none
+    LineEnding detectLineEnding(const char *data, qsizetype size);
+
+    /**
+     * Decodes UTF-8 into @p out, which must hold at least @p size code units.
+     * Invalid sequences become U+FFFD and clear @p valid. With
+     * @p stripCarriageReturns, CR LF pairs are written as LF.
+     * @return Number of UTF-16 code units written
+     */
+    qsizetype utf8ToUtf16(const char *data, qsizetype size, char16_t *out,
+                          bool stripCarriageReturns, bool *valid = nullptr);
+
+    /**
+     * Encodes UTF-16 into @p out, which must hold at least 3 * @p size bytes.
+     * Unpaired surrogates become U+FFFD.
+     * @return Number of bytes written
+     */
+    qsizetype utf16ToUtf8(const char16_t *data, qsizetype size, char *out);
+
+    /// Records BOM and line ending of @p bytes in @p format, then decodes with line endings normalised to LF
+    QString decode(QByteArrayView bytes, FileFormat *format, bool *valid = nullptr);
+
+    /// Decodes one chunk of a file whose format was already detected; the chunk must not split a line break
+    QString decodeChunk(QByteArrayView bytes, bool *valid = nullptr);
+
+    /// Encodes LF-separated @p text for disk using @p format's line ending and BOM
+    QByteArray encode(QStringView text, const FileFormat &format);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QStringView>
+
+/**
+ * @brief Word and character counting for the status bar
+ *
+ * A word is a run of characters that are not whitespace as QChar::isSpace()
+ * defines it, the same words `split(QRegularExpression("\\s+"))` yields.
+ * Characters are Unicode code points, so a surrogate pair counts once.
+ *
+ * The kernel classifies 8 (SSE2) or 16 (AVX2, chosen at run time) UTF-16
+ * code units at a time into a whitespace bit mask and counts word starts
+ * with a shift and a population count. Blocks containing non-ASCII code
+ * units take the scalar path.
+ */
+namespace TextStats
+{
+    struct Counts {
+        qint64 words = 0;
+        qint64 characters = 0;
+
+        Counts &operator+=(const Counts &other)
+        {
+            words += other.words;
+            characters += other.characters;
+            return *this;
+        }
+        Counts &operator-=(const Counts &other)
+        {
+            words -= other.words;
+            characters -= other.characters;
+            return *this;
+        }
+    };
+
+    /// Counts the words and characters of @p text
+    Counts count(QStringView text);
+}
@@ -49,6 +49,16 @@ public:
     QColor secondaryColor() const;
     QColor baseColor() const;
 
+    // Markdown colors, for output rendered outside the editor
+    QColor headingColor() const;
+    QColor linkColor() const;
+    QColor imageColor() const;
+    QColor codeTextColor() const;
+    QColor codeBackgroundColor() const;
+    QColor blockquoteTextColor() const;
+    QColor tableHeaderBackgroundColor() const;
+    QColor horizontalRuleColor() const;
+
     // Apply theme to a specific widget and all its children
     void applyThemeToWidget(QWidget *widget);
 
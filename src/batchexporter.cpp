@@ -0,0 +1,549 @@
+#include "batchexporter.h"
+#include "htmlexporter.h"
+#include "pdfexporter.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSet>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrentMap>
+#include <algorithm>
+#include <cmark.h>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+// Same extensions the sidebar lists
+const QStringList MarkdownNameFilters = { "*.md", "*.markdown", "*.txt" };
+
+// Slowest files listed in the summary
+const int SlowestFilesShown = 5;
+
+// Kept in the output folder by incremental exports
+const char ManifestFileName[] = ".scriber-export.json";
+const int ManifestVersion = 1;
+
+// Changes arriving within this window are exported in one run
+const int WatchDebounceMs = 250;
+
+QString formatArgument(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (std::strncmp(arg, "--export=", 9) == 0) {
+            return QString::fromLocal8Bit(arg + 9);
+        }
+        if (std::strcmp(arg, "--export") == 0) {
+            return i + 1 < argc ? QString::fromLocal8Bit(argv[i + 1]) : QString();
+        }
+    }
+    return QString();
+}
+
+QString formatMilliseconds(qint64 nsecs)
+{
+    return QString::number(nsecs / 1e6, 'f', 1) + QStringLiteral(" ms");
+}
+
+qint64 modificationTime(const QFileInfo &info)
+{
+    return info.exists() ? info.lastModified().toMSecsSinceEpoch() : 0;
+}
+
+} // namespace
+
+BatchExporter::BatchExporter(Format format, const QString &outputDirectory)
+    : m_format(format), m_outputDirectory(outputDirectory)
+{
+}
+
+bool BatchExporter::isExportCommand(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--export") == 0 || std::strncmp(argv[i], "--export=", 9) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int BatchExporter::run(int &argc, char *argv[])
+{
+    const QString formatName = formatArgument(argc, argv).toLower();
+    const bool pdf = formatName == QLatin1String("pdf");
+
+    // HTML runs without any platform plugin. PDF layout needs fonts, which
+    // come with a QGuiApplication; default it to the offscreen platform so
+    // build machines without a display work.
+    std::unique_ptr<QCoreApplication> app;
+    if (pdf) {
+        if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+        app.reset(new QGuiApplication(argc, argv));
+    } else {
+        app.reset(new QCoreApplication(argc, argv));
+    }
+    app->setApplicationName("Scriber");
+    app->setApplicationVersion("0.1");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Converts Markdown files to HTML or PDF without opening the editor");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption exportOption("export", "Output format: html or pdf.", "format");
+    QCommandLineOption outOption("out", "Directory the converted files are written to.", "dir");
+    QCommandLineOption jobsOption("jobs", "Number of files converted in parallel (default: all cores).", "n");
+    QCommandLineOption incrementalOption("incremental", "Skip inputs unchanged since the last export into the same folder.");
+    QCommandLineOption watchOption("watch", "Keep running and re-export inputs as they change (implies --incremental).");
+    parser.addOption(exportOption);
+    parser.addOption(outOption);
+    parser.addOption(jobsOption);
+    parser.addOption(incrementalOption);
+    parser.addOption(watchOption);
+    parser.addPositionalArgument("inputs", "Markdown files or folders to convert.", "files/dirs...");
+    parser.process(*app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (formatName != QLatin1String("html") && !pdf) {
+        err << "scriber: --export expects html or pdf\n";
+        return 2;
+    }
+    if (!parser.isSet(outOption) || parser.positionalArguments().isEmpty()) {
+        err << "usage: scriber --export html|pdf --out DIR [--incremental | --watch] files/dirs...\n";
+        return 2;
+    }
+
+    int threads = QThread::idealThreadCount();
+    if (parser.isSet(jobsOption)) {
+        threads = qMax(1, parser.value(jobsOption).toInt());
+    }
+
+    BatchExporter exporter(pdf ? Format::Pdf : Format::Html, parser.value(outOption));
+    bool inputsFound = true;
+    for (const QString &input : parser.positionalArguments()) {
+        if (!exporter.addInput(input)) {
+            err << "scriber: no such file or directory: " << input << "\n";
+            inputsFound = false;
+        }
+    }
+
+    const bool watch = parser.isSet(watchOption);
+    if (watch || parser.isSet(incrementalOption)) {
+        exporter.loadManifest();
+    }
+
+    const bool ok = exporter.exportAll(threads, out, err);
+    if (watch) {
+        return exporter.watch(threads, out, err);
+    }
+    return ok && inputsFound ? 0 : 1;
+}
+
+bool BatchExporter::addInput(const QString &path)
+{
+    if (!collect(path)) {
+        return false;
+    }
+    m_inputs.append(path);
+    return true;
+}
+
+bool BatchExporter::collect(const QString &path)
+{
+    const QFileInfo info(path);
+    if (!info.exists()) {
+        return false;
+    }
+
+    if (!info.isDir()) {
+        addJob(info.absoluteFilePath(), QStringLiteral("."));
+        // Saves that replace the file are only seen on its folder
+        m_directories.append(info.absolutePath());
+        return true;
+    }
+
+    // Folders keep their structure below the output directory
+    const QDir root(info.absoluteFilePath());
+    QDirIterator it(root.path(), MarkdownNameFilters, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString file = it.next();
+        addJob(file, QFileInfo(root.relativeFilePath(file)).path());
+    }
+
+    m_directories.append(root.path());
+    QDirIterator folders(root.path(), QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (folders.hasNext()) {
+        m_directories.append(folders.next());
+    }
+    return true;
+}
+
+void BatchExporter::addJob(const QString &input, const QString &relativeFolder)
+{
+    // A file given directly and again through its folder is converted once
+    if (m_queuedInputs.contains(input)) {
+        return;
+    }
+    m_queuedInputs.insert(input);
+
+    const QString extension = m_format == Format::Pdf ? QStringLiteral(".pdf") : QStringLiteral(".html");
+    const QString folder = m_outputDirectory.absoluteFilePath(relativeFolder) + QLatin1Char('/');
+    const QFileInfo info(input);
+
+    Job job;
+    job.input = input;
+    job.output = QDir::cleanPath(folder + info.completeBaseName() + extension);
+
+    // Inputs differing only in extension, like a.md and a.txt, both keep it
+    // in their output names, a.md.html and a.txt.html, so the names do not
+    // depend on the order the files were listed in
+    if (m_outputJobs.contains(job.output)) {
+        const qsizetype claimed = m_outputJobs.value(job.output);
+        if (claimed >= 0) {
+            m_outputJobs.insert(job.output, -1); // Taken by no job, but no longer free either
+            Job &other = m_jobs[claimed];
+            other.output = QDir::cleanPath(QFileInfo(other.output).path() + QLatin1Char('/')
+                                           + QFileInfo(other.input).fileName() + extension);
+            m_outputJobs.insert(other.output, claimed);
+        }
+        job.output = QDir::cleanPath(folder + info.fileName() + extension);
+    }
+
+    // Two inputs of the same relative path, from different folders, cannot both be written
+    const auto taken = m_outputJobs.constFind(job.output);
+    if (taken != m_outputJobs.constEnd()) {
+        job.errorString = taken.value() >= 0
+            ? QStringLiteral("output %1 is already written for %2").arg(job.output, m_jobs[taken.value()].input)
+            : QStringLiteral("output %1 clashes with another input").arg(job.output);
+    } else {
+        m_outputJobs.insert(job.output, m_jobs.size());
+    }
+    m_jobs.append(job);
+}
+
+void BatchExporter::rescan()
+{
+    m_jobs.clear();
+    m_queuedInputs.clear();
+    m_outputJobs.clear();
+    m_directories.clear();
+    for (const QString &input : std::as_const(m_inputs)) {
+        collect(input);
+    }
+}
+
+QString BatchExporter::formatName() const
+{
+    return m_format == Format::Pdf ? QStringLiteral("pdf") : QStringLiteral("html");
+}
+
+QString BatchExporter::manifestPath() const
+{
+    return m_outputDirectory.absoluteFilePath(QLatin1String(ManifestFileName));
+}
+
+void BatchExporter::loadManifest()
+{
+    m_incremental = true;
+    m_manifest.clear();
+
+    QFile file(manifestPath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return; // First export into this folder
+    }
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    // Another format or an unknown layout starts over
+    if (root.value("version").toInt() != ManifestVersion || root.value("format").toString() != formatName()) {
+        return;
+    }
+
+    const QJsonArray files = root.value("files").toArray();
+    for (const QJsonValue &value : files) {
+        const QJsonObject entry = value.toObject();
+        Job job;
+        job.input = entry.value("input").toString();
+        job.output = entry.value("output").toString();
+        job.bytes = entry.value("size").toInteger();
+        job.modified = entry.value("modified").toInteger();
+        job.outputModified = entry.value("outputModified").toInteger();
+        job.hash = QByteArray::fromHex(entry.value("hash").toString().toLatin1());
+        job.ok = true;
+        m_manifest.insert(job.input, job);
+    }
+}
+
+bool BatchExporter::saveManifest(QString *errorString) const
+{
+    QJsonArray files;
+    for (const Job &job : m_manifest) {
+        QJsonObject entry;
+        entry.insert("input", job.input);
+        entry.insert("output", job.output);
+        entry.insert("size", job.bytes);
+        entry.insert("modified", job.modified);
+        entry.insert("outputModified", job.outputModified);
+        entry.insert("hash", QString::fromLatin1(job.hash.toHex()));
+        files.append(entry);
+    }
+    QJsonObject root;
+    root.insert("version", ManifestVersion);
+    root.insert("format", formatName());
+    root.insert("files", files);
+
+    QSaveFile file(manifestPath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        *errorString = file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        *errorString = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+int BatchExporter::removeStaleOutputs()
+{
+    QSet<QString> inputs;
+    for (const Job &job : std::as_const(m_jobs)) {
+        inputs.insert(job.input);
+    }
+
+    int removed = 0;
+    for (auto it = m_manifest.begin(); it != m_manifest.end();) {
+        if (inputs.contains(it.key())) {
+            ++it;
+            continue;
+        }
+        // Only files this exporter wrote, and nobody changed since, are removed
+        const QFileInfo output(it->output);
+        if (output.exists() && modificationTime(output) == it->outputModified && QFile::remove(it->output)) {
+            ++removed;
+        }
+        it = m_manifest.erase(it);
+    }
+    return removed;
+}
+
+bool BatchExporter::exportAll(int threads, QTextStream &out, QTextStream &err)
+{
+    // Create every output folder up front instead of racing in the workers
+    QSet<QString> folders;
+    for (const Job &job : std::as_const(m_jobs)) {
+        folders.insert(QFileInfo(job.output).path());
+    }
+    for (const QString &folder : std::as_const(folders)) {
+        QDir().mkpath(folder);
+    }
+    const int removed = m_incremental ? removeStaleOutputs() : 0;
+
+    QThreadPool::globalInstance()->setMaxThreadCount(threads);
+    const Format format = m_format;
+    const QHash<QString, Job> &manifest = m_manifest; // Only read while the workers run
+
+    QElapsedTimer timer;
+    timer.start();
+    QtConcurrent::blockingMap(m_jobs, [format, &manifest](Job &job) {
+        if (!job.errorString.isEmpty()) {
+            return; // Refused when it was queued
+        }
+        const auto previous = manifest.constFind(job.input);
+        exportFile(job, format, previous != manifest.constEnd() ? &previous.value() : nullptr);
+    });
+    const qint64 wallNsecs = timer.nsecsElapsed();
+
+    int failed = 0;
+    int skipped = 0;
+    qint64 totalBytes = 0;
+    qint64 busyNsecs = 0;
+    QList<Job> converted;
+    for (const Job &job : std::as_const(m_jobs)) {
+        busyNsecs += job.nsecs;
+        if (!job.ok) {
+            ++failed;
+            err << "scriber: " << job.input << ": " << job.errorString << "\n";
+        } else if (job.skipped) {
+            ++skipped;
+        } else {
+            totalBytes += job.bytes;
+            converted.append(job);
+        }
+    }
+
+    if (m_incremental) {
+        bool changed = removed > 0;
+        for (const Job &job : std::as_const(m_jobs)) {
+            const auto previous = m_manifest.constFind(job.input);
+            if (!job.ok) {
+                changed |= m_manifest.remove(job.input) > 0; // Retried next time
+            } else if (previous == m_manifest.constEnd() || previous->modified != job.modified
+                       || previous->outputModified != job.outputModified || previous->output != job.output) {
+                m_manifest.insert(job.input, job);
+                changed = true;
+            }
+        }
+        // An untouched manifest is not rewritten, so a watched output folder stays quiet
+        QString errorString;
+        if (changed && !saveManifest(&errorString)) {
+            err << "scriber: " << manifestPath() << ": " << errorString << "\n";
+            ++failed;
+        }
+    }
+
+    if (m_incremental && converted.isEmpty() && failed == 0 && removed == 0) {
+        out << "Up to date: " << m_jobs.size() << " files checked in " << formatMilliseconds(wallNsecs) << "\n";
+        out.flush();
+        err.flush();
+        return true;
+    }
+
+    std::sort(converted.begin(), converted.end(), [](const Job &a, const Job &b) { return a.nsecs > b.nsecs; });
+
+    const double seconds = wallNsecs / 1e9;
+    out << "Exported " << converted.size() << " of " << m_jobs.size() << " files ("
+        << QString::number(totalBytes / (1024.0 * 1024.0), 'f', 1) << " MiB) on " << threads << " threads\n";
+    if (m_incremental) {
+        out << "  unchanged:  " << skipped << " files, " << removed << " stale outputs removed\n";
+    }
+    out << "  wall time:  " << formatMilliseconds(wallNsecs) << "\n";
+    out << "  busy time:  " << formatMilliseconds(busyNsecs) << " ("
+        << QString::number(wallNsecs > 0 ? double(busyNsecs) / wallNsecs : 0.0, 'f', 1) << "x parallel)\n";
+    if (seconds > 0 && !converted.isEmpty()) {
+        out << "  throughput: " << QString::number(converted.size() / seconds, 'f', 0) << " files/s, "
+            << QString::number(totalBytes / (1024.0 * 1024.0) / seconds, 'f', 1) << " MiB/s\n";
+    }
+    if (!converted.isEmpty()) {
+        out << "  slowest:\n";
+        for (qsizetype i = 0; i < qMin<qsizetype>(converted.size(), SlowestFilesShown); ++i) {
+            out << "    " << formatMilliseconds(converted[i].nsecs) << "  " << converted[i].input << "\n";
+        }
+    }
+    out.flush();
+    err.flush();
+    return failed == 0;
+}
+
+int BatchExporter::watch(int threads, QTextStream &out, QTextStream &err)
+{
+    QFileSystemWatcher watcher;
+    QTimer debounce;
+    debounce.setSingleShot(true);
+    debounce.setInterval(WatchDebounceMs);
+
+    // Files catch writes in place, folders catch new, removed and renamed files
+    auto rewatch = [this, &watcher]() {
+        QSet<QString> wanted(m_directories.cbegin(), m_directories.cend());
+        for (const Job &job : std::as_const(m_jobs)) {
+            wanted.insert(job.input);
+        }
+        QSet<QString> watched;
+        for (const QString &path : watcher.files() + watcher.directories()) {
+            watched.insert(path);
+        }
+        const QStringList stale = (watched - wanted).values();
+        if (!stale.isEmpty()) {
+            watcher.removePaths(stale);
+        }
+        const QStringList added = (wanted - watched).values();
+        if (!added.isEmpty()) {
+            watcher.addPaths(added);
+        }
+    };
+
+    QObject::connect(&watcher, &QFileSystemWatcher::fileChanged, &debounce, qOverload<>(&QTimer::start));
+    QObject::connect(&watcher, &QFileSystemWatcher::directoryChanged, &debounce, qOverload<>(&QTimer::start));
+    QObject::connect(&debounce, &QTimer::timeout, &watcher, [this, threads, &out, &err, rewatch]() {
+        rescan();
+        exportAll(threads, out, err);
+        rewatch(); // Replaced files drop out of the watcher
+    });
+
+    rewatch();
+    out << "Watching " << m_jobs.size() << " files for changes; press Ctrl+C to stop\n";
+    out.flush();
+    return QCoreApplication::exec();
+}
+
+void BatchExporter::exportFile(Job &job, Format format, const Job *previous)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const QFileInfo info(job.input);
+    job.bytes = info.size();
+    job.modified = modificationTime(info);
+
+    // The output still counts if it is the very file written for this input
+    const bool outputCurrent = previous && previous->output == job.output
+        && modificationTime(QFileInfo(job.output)) == previous->outputModified;
+    if (outputCurrent && previous->bytes == job.bytes && previous->modified == job.modified) {
+        job.hash = previous->hash;
+        job.outputModified = previous->outputModified;
+        job.ok = job.skipped = true;
+        job.nsecs = timer.nsecsElapsed();
+        return;
+    }
+
+    QFile file(job.input);
+    if (!file.open(QIODevice::ReadOnly)) {
+        job.errorString = file.errorString();
+        job.nsecs = timer.nsecsElapsed();
+        return;
+    }
+    job.bytes = file.size();
+
+    // Map the input; pipes and some filesystems fall back to reading
+    QByteArray buffer;
+    const char *data = job.bytes > 0 ? reinterpret_cast<const char *>(file.map(0, job.bytes)) : nullptr;
+    if (!data) {
+        buffer = file.readAll();
+        data = buffer.constData();
+        job.bytes = buffer.size();
+    }
+
+    // Touched but unchanged files, e.g. after a checkout, are not converted again
+    job.hash = QCryptographicHash::hash(QByteArrayView(data, job.bytes), QCryptographicHash::Sha1);
+    if (outputCurrent && previous->hash == job.hash) {
+        job.outputModified = previous->outputModified;
+        job.ok = job.skipped = true;
+        job.nsecs = timer.nsecsElapsed();
+        return;
+    }
+
+    // cmark skips the BOM, accepts CRLF and replaces invalid UTF-8 itself
+    cmark_node *document = HtmlExporter::parseUtf8(data, job.bytes);
+    if (format == Format::Html) {
+        const HtmlExporter::Result result = HtmlExporter::exportDocument(document, job.output);
+        job.ok = result.ok;
+        job.errorString = result.errorString;
+    } else {
+        const PdfExporter::Result result = PdfExporter::exportDocument(document, job.output);
+        job.ok = result.ok;
+        job.errorString = result.errorString;
+    }
+    cmark_node_free(document);
+
+    if (job.ok) {
+        job.outputModified = modificationTime(QFileInfo(job.output));
+    }
+    job.nsecs = timer.nsecsElapsed();
+}
@@ -0,0 +1,95 @@
+// bench_textcodec.cpp
+// Throughput of the TextCodec kernels against QString's own conversions.
+// Build with -DSCRIBER_BUILD_BENCHMARKS=ON and run: bench_textcodec [megabytes]
+#include "textcodec.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <functional>
+
+namespace {
+
+QByteArray makeMarkdown(qsizetype targetSize, bool crlf)
+{
+    // Mostly ASCII prose with occasional multi-byte characters, like real notes.
+    const QByteArray eol = crlf ? QByteArray("\r\n") : QByteArray("\n");
+    const QByteArray lines[] = {
+        "# Section heading",
+        "Some *emphasised* text with a [link](https://example.com) and `code`.",
+        "- A list item that goes on for a while to make the line realistic",
+        "Caf\xc3\xa9 na\xc3\xafve r\xc3\xa9sum\xc3\xa9 \xe2\x80\x94 \xe2\x82\xac 42 \xf0\x9f\x98\x80",
+        "",
+    };
+    QByteArray data;
+    data.reserve(targetSize + 128);
+    int i = 0;
+    while (data.size() < targetSize) {
+        data += lines[i++ % 5];
+        data += eol;
+    }
+    return data;
+}
+
+void measure(QTextStream &out, const char *name, qsizetype bytes, const std::function<void()> &run)
+{
+    run(); // Warm up caches and the kernel dispatch
+
+    const int repetitions = 10;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < repetitions; ++i) {
+        run();
+    }
+    const double seconds = timer.nsecsElapsed() / 1e9;
+    const double gbPerSecond = double(bytes) * repetitions / seconds / 1e9;
+    out << QString::asprintf("%-34s %8.2f GB/s\n", name, gbPerSecond);
+    out.flush();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const qsizetype megabytes = argc > 1 ? QByteArray(argv[1]).toLongLong() : 64;
+    const qsizetype size = qMax<qsizetype>(1, megabytes) * 1024 * 1024;
+
+    QTextStream out(stdout);
+    const QByteArray lf = makeMarkdown(size, false);
+    const QByteArray crlf = makeMarkdown(size, true);
+    const QString text = QString::fromUtf8(lf);
+    QString decoded(qMax(lf.size(), crlf.size()), Qt::Uninitialized);
+    QByteArray encoded(text.size() * 3, Qt::Uninitialized);
+    volatile qsizetype sink = 0;
+
+    out << "Input: " << lf.size() / (1024 * 1024) << " MiB of Markdown\n";
+
+    measure(out, "TextCodec::isValidUtf8", lf.size(), [&]() {
+        sink = TextCodec::isValidUtf8(lf.constData(), lf.size());
+    });
+    measure(out, "TextCodec::utf8ToUtf16", lf.size(), [&]() {
+        sink = TextCodec::utf8ToUtf16(lf.constData(), lf.size(),
+                                      reinterpret_cast<char16_t *>(decoded.data()), false);
+    });
+    measure(out, "TextCodec::utf8ToUtf16 (CRLF->LF)", crlf.size(), [&]() {
+        sink = TextCodec::utf8ToUtf16(crlf.constData(), crlf.size(),
+                                      reinterpret_cast<char16_t *>(decoded.data()), true);
+    });
+    measure(out, "QString::fromUtf8", lf.size(), [&]() {
+        sink = QString::fromUtf8(lf).size();
+    });
+    measure(out, "TextCodec::utf16ToUtf8", lf.size(), [&]() {
+        sink = TextCodec::utf16ToUtf8(reinterpret_cast<const char16_t *>(text.constData()), text.size(), encoded.data());
+    });
+    measure(out, "TextCodec::encode (LF->CRLF)", lf.size(), [&]() {
+        TextCodec::FileFormat format;
+        format.lineEnding = TextCodec::LineEnding::CRLF;
+        sink = TextCodec::encode(text, format).size();
+    });
+    measure(out, "QString::toUtf8", lf.size(), [&]() {
+        sink = text.toUtf8().size();
+    });
+
+    Q_UNUSED(sink);
+    return 0;
+}
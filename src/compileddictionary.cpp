@@ -0,0 +1,663 @@
+#include "compileddictionary.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QStringDecoder>
+#include <QVarLengthArray>
+#include <QVector>
+#include <QThreadPool>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+const char CacheMagic[8] = {'S', 'C', 'R', 'D', 'A', 'W', 'G', '\0'};
+const quint32 CacheVersion = 1;
+const quint32 ByteOrderMark = 0x01020304;
+
+// Upper bound on expanded word forms; anything beyond is left to Hunspell.
+const size_t MaxWordForms = 4000000;
+
+struct FileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrderMark;
+    quint32 edgeCount;
+    quint32 root;
+    quint32 wordCount;
+    quint32 reserved;
+    qint64 affSize;
+    qint64 affModified;
+    qint64 dicSize;
+    qint64 dicModified;
+};
+static_assert(sizeof(FileHeader) == 64, "FileHeader must keep the edge array 8-byte aligned");
+
+struct RawEdge {
+    quint32 target;
+    quint16 label;
+    quint16 flags;
+};
+static_assert(sizeof(RawEdge) == 8, "RawEdge must match CompiledDictionary::Edge");
+
+void stampSources(FileHeader &header, const QString &affPath, const QString &dicPath)
+{
+    QFileInfo aff(affPath);
+    QFileInfo dic(dicPath);
+    header.affSize = aff.size();
+    header.affModified = aff.lastModified().toMSecsSinceEpoch();
+    header.dicSize = dic.size();
+    header.dicModified = dic.lastModified().toMSecsSinceEpoch();
+}
+
+// --- Hunspell affix expansion ----------------------------------------------
+
+struct ConditionAtom {
+    QString chars;
+    bool negated = false;
+    bool any = false;
+};
+
+struct AffixRule {
+    QString strip;
+    QString affix;
+    QVector<ConditionAtom> condition;
+};
+
+struct AffixClass {
+    bool crossProduct = false;
+    QVector<AffixRule> rules;
+};
+
+enum class FlagType { Char, Long, Number };
+
+struct AffixData {
+    FlagType flagType = FlagType::Char;
+    QHash<QString, AffixClass> prefixes;
+    QHash<QString, AffixClass> suffixes;
+    QVector<QString> aliases;
+    QString needAffix;
+    QString onlyInCompound;
+    QString forbiddenWord;
+
+    QStringList parseFlags(const QString &field) const
+    {
+        QString flags = field;
+        if (!aliases.isEmpty()) {
+            bool ok = false;
+            int alias = field.toInt(&ok);
+            if (!ok || alias < 1 || alias > aliases.size()) {
+                return QStringList();
+            }
+            flags = aliases.at(alias - 1);
+        }
+
+        QStringList result;
+        switch (flagType) {
+        case FlagType::Long:
+            for (int i = 0; i + 1 < flags.size(); i += 2) {
+                result << flags.mid(i, 2);
+            }
+            break;
+        case FlagType::Number:
+            result = flags.split(QLatin1Char(','), Qt::SkipEmptyParts);
+            break;
+        case FlagType::Char:
+            for (QChar c : flags) {
+                result << QString(c);
+            }
+            break;
+        }
+        return result;
+    }
+};
+
+QVector<ConditionAtom> parseCondition(const QString &condition)
+{
+    QVector<ConditionAtom> atoms;
+    if (condition == QLatin1String(".")) {
+        return atoms;
+    }
+
+    for (int i = 0; i < condition.size(); ++i) {
+        ConditionAtom atom;
+        QChar c = condition.at(i);
+        if (c == u'.') {
+            atom.any = true;
+        } else if (c == u'[') {
+            int close = condition.indexOf(u']', i + 1);
+            if (close < 0) {
+                close = condition.size();
+            }
+            QString set = condition.mid(i + 1, close - i - 1);
+            if (set.startsWith(u'^')) {
+                atom.negated = true;
+                set.remove(0, 1);
+            }
+            atom.chars = set;
+            i = close;
+        } else {
+            atom.chars = QString(c);
+        }
+        atoms.append(atom);
+    }
+    return atoms;
+}
+
+bool matchesCondition(const QString &word, const QVector<ConditionAtom> &atoms, bool atEnd)
+{
+    if (atoms.size() > word.size()) {
+        return false;
+    }
+    int offset = atEnd ? word.size() - atoms.size() : 0;
+    for (int i = 0; i < atoms.size(); ++i) {
+        const ConditionAtom &atom = atoms.at(i);
+        if (atom.any) {
+            continue;
+        }
+        bool contains = atom.chars.contains(word.at(offset + i));
+        if (contains == atom.negated) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QString affixText(const QString &field)
+{
+    // Strip continuation flags ("ing/S") and the "0" placeholder for empty strings.
+    QString text = field.section(QLatin1Char('/'), 0, 0);
+    return text == QLatin1String("0") ? QString() : text;
+}
+
+QStringDecoder decoderForDictionary(const QByteArray &aff)
+{
+    QByteArray encoding = "ISO8859-1";
+    for (const QByteArray &line : aff.split('\n')) {
+        if (line.startsWith("SET ")) {
+            encoding = line.mid(4).trimmed().toUpper();
+            break;
+        }
+    }
+    if (encoding == "UTF-8") {
+        return QStringDecoder(QStringDecoder::Utf8);
+    }
+    if (encoding == "ISO8859-1" || encoding == "ISO-8859-1") {
+        return QStringDecoder(QStringDecoder::Latin1);
+    }
+    return QStringDecoder(encoding.constData());
+}
+
+bool parseAffixFile(const QString &text, AffixData &data)
+{
+    bool aliasCountSeen = false;
+    const QStringList lines = text.split(QLatin1Char('\n'));
+    for (const QString &rawLine : lines) {
+        const QStringList parts = rawLine.simplified().split(QLatin1Char(' '), Qt::SkipEmptyParts);
+        if (parts.isEmpty() || parts.first().startsWith(QLatin1Char('#'))) {
+            continue;
+        }
+
+        const QString &keyword = parts.first();
+        if (keyword == QLatin1String("FLAG") && parts.size() > 1) {
+            if (parts.at(1) == QLatin1String("long")) {
+                data.flagType = FlagType::Long;
+            } else if (parts.at(1) == QLatin1String("num")) {
+                data.flagType = FlagType::Number;
+            }
+        } else if (keyword == QLatin1String("AF") && parts.size() > 1) {
+            // The first AF line only declares the number of aliases.
+            if (aliasCountSeen) {
+                data.aliases.append(parts.at(1));
+            } else {
+                aliasCountSeen = true;
+                data.aliases.reserve(parts.at(1).toInt());
+            }
+        } else if (keyword == QLatin1String("NEEDAFFIX") || keyword == QLatin1String("PSEUDOROOT")) {
+            data.needAffix = parts.value(1);
+        } else if (keyword == QLatin1String("ONLYINCOMPOUND")) {
+            data.onlyInCompound = parts.value(1);
+        } else if (keyword == QLatin1String("FORBIDDENWORD")) {
+            data.forbiddenWord = parts.value(1);
+        } else if ((keyword == QLatin1String("PFX") || keyword == QLatin1String("SFX")) && parts.size() >= 4) {
+            QHash<QString, AffixClass> &classes = (keyword == QLatin1String("PFX")) ? data.prefixes : data.suffixes;
+            const QString &flag = parts.at(1);
+            bool isHeader = !classes.contains(flag) && (parts.at(2) == QLatin1String("Y") || parts.at(2) == QLatin1String("N"));
+            if (isHeader) {
+                AffixClass affixClass;
+                affixClass.crossProduct = parts.at(2) == QLatin1String("Y");
+                classes.insert(flag, affixClass);
+                continue;
+            }
+            if (parts.size() < 4 || !classes.contains(flag)) {
+                continue;
+            }
+            AffixRule rule;
+            rule.strip = affixText(parts.at(2));
+            rule.affix = affixText(parts.at(3));
+            rule.condition = parseCondition(parts.value(4, QStringLiteral(".")));
+            classes[flag].rules.append(rule);
+        }
+    }
+    return !data.suffixes.isEmpty() || !data.prefixes.isEmpty();
+}
+
+class WordFormCollector
+{
+public:
+    explicit WordFormCollector(const AffixData &affixData) : data(affixData) {}
+
+    void addStem(const QString &word, const QStringList &flags)
+    {
+        if (!data.forbiddenWord.isEmpty() && flags.contains(data.forbiddenWord)) {
+            return;
+        }
+        if (!data.onlyInCompound.isEmpty() && flags.contains(data.onlyInCompound)) {
+            return;
+        }
+        if (data.needAffix.isEmpty() || !flags.contains(data.needAffix)) {
+            emitForm(word);
+        }
+
+        QVector<QString> crossSuffixed;
+        for (const QString &flag : flags) {
+            auto it = data.suffixes.constFind(flag);
+            if (it == data.suffixes.constEnd()) continue;
+            for (const AffixRule &rule : it->rules) {
+                if (!word.endsWith(rule.strip) || !matchesCondition(word, rule.condition, true)) continue;
+                QString form = word.chopped(rule.strip.size()) + rule.affix;
+                emitForm(form);
+                if (it->crossProduct) {
+                    crossSuffixed.append(form);
+                }
+            }
+        }
+
+        for (const QString &flag : flags) {
+            auto it = data.prefixes.constFind(flag);
+            if (it == data.prefixes.constEnd()) continue;
+            for (const AffixRule &rule : it->rules) {
+                if (word.startsWith(rule.strip) && matchesCondition(word, rule.condition, false)) {
+                    emitForm(rule.affix + word.mid(rule.strip.size()));
+                }
+                if (!it->crossProduct) continue;
+                for (const QString &suffixed : std::as_const(crossSuffixed)) {
+                    if (suffixed.startsWith(rule.strip) && matchesCondition(suffixed, rule.condition, false)) {
+                        emitForm(rule.affix + suffixed.mid(rule.strip.size()));
+                    }
+                }
+            }
+        }
+    }
+
+    bool isFull() const { return forms.size() >= MaxWordForms; }
+
+    std::vector<std::u16string> forms;
+
+private:
+    void emitForm(const QString &form)
+    {
+        if (!form.isEmpty() && !isFull()) {
+            forms.emplace_back(reinterpret_cast<const char16_t *>(form.utf16()), size_t(form.size()));
+        }
+    }
+
+    const AffixData &data;
+};
+
+// --- Minimised DAWG construction (Daciuk et al., sorted input) -------------
+
+class DawgBuilder
+{
+public:
+    DawgBuilder()
+    {
+        nodes.emplace_back();
+    }
+
+    void insert(const std::u16string &word)
+    {
+        size_t common = 0;
+        while (common < word.size() && common < previous.size() && word[common] == previous[common]) {
+            ++common;
+        }
+        minimize(common);
+
+        quint32 node = unchecked.empty() ? 0 : unchecked.back().child;
+        for (size_t i = common; i < word.size(); ++i) {
+            quint32 child = createNode();
+            nodes[node].edges.push_back({word[i], child});
+            unchecked.push_back({node, child});
+            node = child;
+        }
+        nodes[node].final = true;
+        previous = word;
+        ++count;
+    }
+
+    // Flattens the graph into the on-disk edge array; returns the root offset.
+    quint32 finish(std::vector<RawEdge> &edges)
+    {
+        minimize(0);
+
+        std::vector<quint32> offsets(nodes.size(), 0);
+        std::vector<quint32> order;
+        std::vector<quint32> stack = {0};
+        edges.assign(1, RawEdge{0, 0, 0}); // Offset 0 means "no children"
+
+        while (!stack.empty()) {
+            quint32 id = stack.back();
+            stack.pop_back();
+            if (offsets[id] != 0 || nodes[id].edges.empty()) continue;
+            offsets[id] = quint32(edges.size());
+            order.push_back(id);
+            edges.resize(edges.size() + nodes[id].edges.size());
+            for (const Transition &t : nodes[id].edges) {
+                stack.push_back(t.child);
+            }
+        }
+
+        for (quint32 id : order) {
+            const std::vector<Transition> &transitions = nodes[id].edges;
+            for (size_t i = 0; i < transitions.size(); ++i) {
+                const Node &child = nodes[transitions[i].child];
+                RawEdge &edge = edges[offsets[id] + i];
+                edge.target = offsets[transitions[i].child];
+                edge.label = transitions[i].label;
+                edge.flags = (child.final ? 0x1 : 0) | (i + 1 == transitions.size() ? 0x2 : 0);
+            }
+        }
+        return offsets[0];
+    }
+
+    quint32 wordCount() const { return count; }
+
+private:
+    struct Transition {
+        char16_t label;
+        quint32 child;
+    };
+    struct Node {
+        bool final = false;
+        std::vector<Transition> edges;
+    };
+    struct Pending {
+        quint32 parent;
+        quint32 child;
+    };
+
+    quint32 createNode()
+    {
+        if (!freeNodes.empty()) {
+            quint32 id = freeNodes.back();
+            freeNodes.pop_back();
+            nodes[id] = Node();
+            return id;
+        }
+        nodes.emplace_back();
+        return quint32(nodes.size() - 1);
+    }
+
+    std::string signature(quint32 id) const
+    {
+        const Node &node = nodes[id];
+        std::string key(1, node.final ? '1' : '0');
+        key.reserve(1 + node.edges.size() * 6);
+        for (const Transition &t : node.edges) {
+            key.append(reinterpret_cast<const char *>(&t.label), sizeof(t.label));
+            key.append(reinterpret_cast<const char *>(&t.child), sizeof(t.child));
+        }
+        return key;
+    }
+
+    void minimize(size_t downTo)
+    {
+        while (unchecked.size() > downTo) {
+            Pending pending = unchecked.back();
+            unchecked.pop_back();
+            std::string key = signature(pending.child);
+            auto it = registry.find(key);
+            if (it != registry.end()) {
+                nodes[pending.parent].edges.back().child = it->second;
+                freeNodes.push_back(pending.child);
+            } else {
+                registry.emplace(std::move(key), pending.child);
+            }
+        }
+    }
+
+    std::vector<Node> nodes;
+    std::vector<quint32> freeNodes;
+    std::vector<Pending> unchecked;
+    std::unordered_map<std::string, quint32> registry;
+    std::u16string previous;
+    quint32 count = 0;
+};
+
+QMutex s_buildMutex;
+QSet<QString> s_buildsInProgress;
+
+} // namespace
+
+bool CompiledDictionary::open(const QString &cachePath, const QString &affPath, const QString &dicPath)
+{
+    m_edges = nullptr;
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+
+    m_file.setFileName(cachePath);
+    if (!m_file.open(QIODevice::ReadOnly) || m_file.size() < qint64(sizeof(FileHeader))) {
+        return false;
+    }
+
+    const uchar *mapped = m_file.map(0, m_file.size());
+    if (!mapped) {
+        m_file.close();
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, mapped, sizeof(header));
+    FileHeader expected;
+    stampSources(expected, affPath, dicPath);
+
+    bool valid = std::memcmp(header.magic, CacheMagic, sizeof(CacheMagic)) == 0
+                 && header.version == CacheVersion
+                 && header.byteOrderMark == ByteOrderMark
+                 && header.root < header.edgeCount
+                 && m_file.size() == qint64(sizeof(FileHeader)) + qint64(header.edgeCount) * qint64(sizeof(Edge))
+                 && header.affSize == expected.affSize && header.affModified == expected.affModified
+                 && header.dicSize == expected.dicSize && header.dicModified == expected.dicModified;
+    if (!valid) {
+        m_file.unmap(const_cast<uchar *>(mapped));
+        m_file.close();
+        return false;
+    }
+
+    m_edges = reinterpret_cast<const Edge *>(mapped + sizeof(FileHeader));
+    m_edgeCount = header.edgeCount;
+    m_root = header.root;
+    m_wordCount = header.wordCount;
+    return true;
+}
+
+bool CompiledDictionary::containsExact(const char16_t *word, qsizetype length) const
+{
+    quint32 node = m_root;
+    for (qsizetype i = 0; i < length; ++i) {
+        if (node == 0 || node >= m_edgeCount) {
+            return false;
+        }
+        const Edge *edge = m_edges + node;
+        const quint16 c = word[i];
+        // Edges of a node are sorted by label and the last one is flagged.
+        while (edge->label != c) {
+            if (edge->label > c || (edge->flags & EdgeLast)) {
+                return false;
+            }
+            ++edge;
+        }
+        if (i + 1 == length) {
+            return edge->flags & EdgeFinal;
+        }
+        node = edge->target;
+    }
+    return false;
+}
+
+bool CompiledDictionary::contains(QStringView word) const
+{
+    if (!isOpen() || word.isEmpty()) {
+        return false;
+    }
+
+    const char16_t *data = word.utf16();
+    const qsizetype length = word.size();
+    if (containsExact(data, length)) {
+        return true;
+    }
+
+    // Mirror Hunspell's capitalisation rules: "Hello" may be stored as "hello",
+    // "HELLO" as "hello" or "Hello".
+    bool firstUpper = QChar::isUpper(char32_t(data[0]));
+    bool restUpper = true;
+    for (qsizetype i = 1; i < length; ++i) {
+        if (QChar::isLower(char32_t(data[i]))) {
+            restUpper = false;
+            break;
+        }
+    }
+    if (!firstUpper) {
+        return false;
+    }
+
+    QVarLengthArray<char16_t, 64> variant(length);
+    std::copy(data, data + length, variant.data());
+    variant[0] = char16_t(QChar::toLower(char32_t(data[0])));
+    if (!restUpper || length == 1) {
+        return containsExact(variant.constData(), length);
+    }
+
+    for (qsizetype i = 1; i < length; ++i) {
+        variant[i] = char16_t(QChar::toLower(char32_t(data[i])));
+    }
+    if (containsExact(variant.constData(), length)) {
+        return true;
+    }
+    variant[0] = data[0];
+    return containsExact(variant.constData(), length);
+}
+
+bool CompiledDictionary::compile(const QString &affPath, const QString &dicPath, const QString &cachePath)
+{
+    QFile affFile(affPath);
+    QFile dicFile(dicPath);
+    if (!affFile.open(QIODevice::ReadOnly) || !dicFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const QByteArray affBytes = affFile.readAll();
+    QStringDecoder affDecoder = decoderForDictionary(affBytes);
+    QStringDecoder dicDecoder = decoderForDictionary(affBytes);
+    if (!affDecoder.isValid() || !dicDecoder.isValid()) {
+        qWarning() << "CompiledDictionary: Unsupported dictionary encoding in" << affPath;
+        return false;
+    }
+
+    AffixData affixData;
+    if (!parseAffixFile(affDecoder.decode(affBytes), affixData)) {
+        qWarning() << "CompiledDictionary: No affix rules found in" << affPath;
+        return false;
+    }
+
+    WordFormCollector collector(affixData);
+    const QString dicText = dicDecoder.decode(dicFile.readAll());
+    const QStringList lines = dicText.split(QLatin1Char('\n'));
+    for (int i = 1; i < lines.size() && !collector.isFull(); ++i) { // Line 0 is the entry count
+        QString entry = lines.at(i).trimmed().section(QLatin1Char('\t'), 0, 0).section(QLatin1Char(' '), 0, 0);
+        if (entry.isEmpty()) continue;
+
+        // Find the first unescaped '/' separating the word from its flags.
+        int slash = -1;
+        for (int j = 1; j < entry.size(); ++j) {
+            if (entry.at(j) == u'/' && entry.at(j - 1) != u'\\') {
+                slash = j;
+                break;
+            }
+        }
+        QString word = (slash < 0) ? entry : entry.left(slash);
+        word.replace(QLatin1String("\\/"), QLatin1String("/"));
+        QStringList flags = (slash < 0) ? QStringList() : affixData.parseFlags(entry.mid(slash + 1));
+        collector.addStem(word, flags);
+    }
+
+    std::vector<std::u16string> &forms = collector.forms;
+    std::sort(forms.begin(), forms.end());
+    forms.erase(std::unique(forms.begin(), forms.end()), forms.end());
+
+    DawgBuilder builder;
+    for (const std::u16string &form : forms) {
+        builder.insert(form);
+    }
+    std::vector<std::u16string>().swap(forms);
+
+    std::vector<RawEdge> edges;
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+    header.version = CacheVersion;
+    header.byteOrderMark = ByteOrderMark;
+    header.root = builder.finish(edges);
+    header.edgeCount = quint32(edges.size());
+    header.wordCount = builder.wordCount();
+    stampSources(header, affPath, dicPath);
+
+    QDir().mkpath(QFileInfo(cachePath).absolutePath());
+    QSaveFile out(cachePath);
+    if (!out.open(QIODevice::WriteOnly)) {
+        qWarning() << "CompiledDictionary: Cannot write" << cachePath << out.errorString();
+        return false;
+    }
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(edges.data()), qint64(edges.size() * sizeof(RawEdge)));
+    if (!out.commit()) {
+        qWarning() << "CompiledDictionary: Failed to commit" << cachePath << out.errorString();
+        return false;
+    }
+
+    qDebug() << "CompiledDictionary: Compiled" << header.wordCount << "word forms into" << cachePath;
+    return true;
+}
+
+void CompiledDictionary::compileInBackground(const QString &affPath, const QString &dicPath, const QString &cachePath)
+{
+    {
+        QMutexLocker locker(&s_buildMutex);
+        if (s_buildsInProgress.contains(cachePath)) {
+            return;
+        }
+        s_buildsInProgress.insert(cachePath);
+    }
+
+    QThreadPool::globalInstance()->start([affPath, dicPath, cachePath]() {
+        compile(affPath, dicPath, cachePath);
+        QMutexLocker locker(&s_buildMutex);
+        s_buildsInProgress.remove(cachePath);
+    });
+}
+
+QString CompiledDictionary::cachePathForLanguage(const QString &language)
+{
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    return QDir(cacheDir).absoluteFilePath(QStringLiteral("dictionaries/%1.dawg").arg(language));
+}
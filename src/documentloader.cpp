@@ -0,0 +1,129 @@
+#include "documentloader.h"
+#include "editorwidget.h"
+#include "textcodec.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <cstring>
+
+namespace {
+
+// Bytes decoded and appended per step; a turn runs steps until its budget is spent.
+const qint64 ChunkSize = 256 * 1024;
+
+// Time one event-loop turn may spend appending before yielding.
+const int TurnBudgetMs = 12;
+
+} // namespace
+
+DocumentLoader::DocumentLoader(const QString &fileName, EditorWidget *editor)
+    : QObject(editor), file(fileName), editor(editor)
+{
+}
+
+bool DocumentLoader::start(QString *errorString)
+{
+    if (!file.open(QIODevice::ReadOnly)) {
+        *errorString = file.errorString();
+        return false;
+    }
+
+    // Pipes and files like those in /proc report no size and cannot be mapped
+    size = file.size();
+    if (size > 0) {
+        data = reinterpret_cast<const char *>(file.map(0, size));
+    }
+    if (!data) {
+        fallbackBuffer = file.readAll();
+        if (file.error() != QFileDevice::NoError) {
+            *errorString = file.errorString();
+            return false;
+        }
+        size = fallbackBuffer.size();
+        data = fallbackBuffer.constData();
+    }
+
+    editor->beginIncrementalLoad();
+    QTimer::singleShot(0, this, &DocumentLoader::loadNextChunk);
+    return true;
+}
+
+void DocumentLoader::cancel()
+{
+    cancelRequested = true;
+}
+
+void DocumentLoader::loadNextChunk()
+{
+    if (!editor) {
+        deleteLater();
+        return;
+    }
+    if (cancelRequested) {
+        editor->endIncrementalLoad();
+        emit canceled();
+        deleteLater();
+        return;
+    }
+
+    QElapsedTimer budget;
+    budget.start();
+
+    // Appending raw text is cheap; rendering the appended blocks takes the
+    // rest of each turn, and the load ends once both are done
+    bool rendered = false;
+    do {
+        if (offset >= size) {
+            rendered = editor->renderLoadedBlocks(TurnBudgetMs - int(budget.elapsed()));
+            if (rendered) {
+                break;
+            }
+            continue;
+        }
+
+        // Cut each chunk after a newline so a block is never split between
+        // two appends; a single huge line is taken whole.
+        qint64 end = qMin(size, offset + ChunkSize);
+        if (end < size) {
+            qint64 cut = end;
+            while (cut > offset && data[cut - 1] != '\n') {
+                --cut;
+            }
+            if (cut == offset) {
+                const void *next = std::memchr(data + end, '\n', size_t(size - end));
+                cut = next ? (static_cast<const char *>(next) - data) + 1 : size;
+            }
+            end = cut;
+        }
+
+        // Chunks end after a line feed, so neither a CR LF pair nor a UTF-8
+        // sequence is ever split and each chunk decodes on its own.
+        QString text;
+        bool valid = true;
+        if (offset == 0) {
+            TextCodec::FileFormat format;
+            text = TextCodec::decode(QByteArrayView(data, end), &format, &valid);
+            editor->setFileFormat(format); // Saves write the BOM and line endings back
+        } else {
+            text = TextCodec::decodeChunk(QByteArrayView(data + offset, end - offset), &valid);
+        }
+        if (!valid && !invalidUtf8Reported) {
+            qWarning() << "DocumentLoader:" << file.fileName() << "is not valid UTF-8; invalid bytes were replaced";
+            invalidUtf8Reported = true;
+        }
+        offset = end;
+
+        editor->appendMarkdownChunk(text);
+    } while (budget.elapsed() < TurnBudgetMs);
+
+    emit progress(offset, size);
+
+    if (offset >= size && rendered) {
+        editor->endIncrementalLoad();
+        emit finished();
+        deleteLater();
+        return;
+    }
+
+    QTimer::singleShot(0, this, &DocumentLoader::loadNextChunk);
+}
@@ -1,143 +1,265 @@
 #include "documentoutlinewidget.h"
 #include "editorwidget.h"
 #include "outlinedelegate.h"
+#include "outlineindex.h"
+#include "outlinemodel.h"
 #include "thememanager.h"
-#include <QTreeWidgetItem>
 #include <QKeyEvent>
-#include <cmark.h>
+#include <QLineEdit>
+#include <QSortFilterProxyModel>
+#include <QStackedWidget>
+#include <QTextEdit>
+#include <QTextBlock>
+#include <QTreeView>
+#include <QVBoxLayout>
+
+namespace {
+
+// Larger outlines open with only the top level expanded
+const int LargeOutlineHeadings = 2000;
+
+bool isLargeOutline(const OutlineModel *model)
+{
+    OutlineIndex *index = model->outlineIndex();
+    return index && index->headings().size() > LargeOutlineHeadings;
+}
+
+} // namespace
 
 DocumentOutlineWidget::DocumentOutlineWidget(QWidget *parent)
-    : QTreeWidget(parent)
-    , currentEditor(nullptr)
-    , updateTimer(nullptr)
+    : QWidget(parent)
 {
-    setHeaderHidden(true);
-    setColumnCount(1);
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    mainLayout->setContentsMargins(0, 0, 0, 0);
+    mainLayout->setSpacing(0);
+    
+    filterEdit = new QLineEdit();
+    filterEdit->setPlaceholderText(tr("Filter headings"));
+    filterEdit->setClearButtonEnabled(true);
+    mainLayout->addWidget(filterEdit);
     
-    // Set up custom delegate for theme-aware arrow icons
+    // Shown without a document
+    pageStack = new QStackedWidget();
+    QTreeView *emptyTree = new QTreeView();
+    emptyTree->setHeaderHidden(true);
+    emptyPage = emptyTree;
+    pageStack->addWidget(emptyPage);
+    mainLayout->addWidget(pageStack);
+    
+    // Set up custom delegate for theme-aware arrow icons; the pages share it
     outlineDelegate = new OutlineDelegate(this);
-    setItemDelegate(outlineDelegate);
     
     // Connect to theme changes to update arrow colors
     connect(ThemeManager::instance(), &ThemeManager::themeChanged, this, [this]() {
         outlineDelegate->setArrowColor(ThemeManager::instance()->textColor());
-        viewport()->update();
+        if (currentPage) {
+            currentPage->treeView->viewport()->update();
+        }
     });
     
     // Initialize arrow color
     outlineDelegate->setArrowColor(ThemeManager::instance()->textColor());
     
-    // Setup update timer
-    updateTimer = new QTimer(this);
-    updateTimer->setSingleShot(true);
-    updateTimer->setInterval(1000);
-    connect(updateTimer, &QTimer::timeout, this, &DocumentOutlineWidget::updateOutline);
-    
-    connect(this, &QTreeWidget::itemClicked, this, &DocumentOutlineWidget::onItemClicked);
+    connect(filterEdit, &QLineEdit::textChanged, this, &DocumentOutlineWidget::onFilterChanged);
 }
 
 DocumentOutlineWidget::~DocumentOutlineWidget()
 {
+    // The views, with their models, are children of the stack
+    qDeleteAll(pages);
 }
 
-void DocumentOutlineWidget::setEditor(EditorWidget *editor)
+DocumentOutlineWidget::Page *DocumentOutlineWidget::createPage(OutlineIndex *index)
 {
-    currentEditor = editor;
+    Page *page = new Page;
+    page->treeView = new QTreeView();
+    page->treeView->setHeaderHidden(true);
+    page->treeView->setUniformRowHeights(true);
+    page->treeView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    page->treeView->setItemDelegate(outlineDelegate);
+    
+    page->model = new OutlineModel(page->treeView);
+    page->model->setIndex(index);
+    
+    // Matches keep their ancestors, so the filtered outline is still a tree
+    page->filterModel = new QSortFilterProxyModel(page->treeView);
+    page->filterModel->setSourceModel(page->model);
+    page->filterModel->setFilterCaseSensitivity(Qt::CaseInsensitive);
+    page->filterModel->setRecursiveFilteringEnabled(true);
+    page->treeView->setModel(page->filterModel);
+    
+    connect(page->treeView, &QTreeView::clicked, this, &DocumentOutlineWidget::onItemClicked);
+    connect(page->model, &QAbstractItemModel::modelReset, this, [this, page]() {
+        expandDefault(page);
+        page->currentHeading = sectionAtCursor(page);
+        showCurrentSection(page);
+    });
+    // The model connected first, so it has caught up when this runs
+    connect(index, &OutlineIndex::headingsChanged, this, [this, page](int first, int removed, int added) {
+        onHeadingsChanged(page, first, removed, added);
+    });
+    connect(index, &QObject::destroyed, this, [this, index]() { removePage(index); });
+    
+    pageStack->addWidget(page->treeView);
+    expandDefault(page);
+    pages.insert(index, page);
+    return page;
 }
 
-void DocumentOutlineWidget::updateOutline()
+void DocumentOutlineWidget::removePage(OutlineIndex *index)
 {
-    if (!currentEditor) return;
-    
-    clear();
-    
-    QString markdown = currentEditor->getRawMarkdown();
-    QByteArray utf8 = markdown.toUtf8();
-    
-    cmark_node *doc = cmark_parse_document(utf8.constData(), utf8.size(), CMARK_OPT_DEFAULT);
-    if (!doc) return;
-    
-    cmark_iter *iter = cmark_iter_new(doc);
-    cmark_event_type ev_type;
-    
-    QList<QTreeWidgetItem*> parents;
-    parents.append(nullptr);
-    
-    while ((ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
-        cmark_node *cur = cmark_iter_get_node(iter);
-        
-        if (ev_type == CMARK_EVENT_ENTER && cmark_node_get_type(cur) == CMARK_NODE_HEADING) {
-            int level = cmark_node_get_heading_level(cur);
-            int startLine = cmark_node_get_start_line(cur);
-            
-            QString headingText;
-            cmark_iter *subIter = cmark_iter_new(cur);
-            while (cmark_iter_next(subIter) != CMARK_EVENT_DONE) {
-                cmark_node *subNode = cmark_iter_get_node(subIter);
-                if (cmark_node_get_type(subNode) == CMARK_NODE_TEXT ||
-                    cmark_node_get_type(subNode) == CMARK_NODE_CODE) {
-                    const char *text = cmark_node_get_literal(subNode);
-                    if (text) headingText += QString::fromUtf8(text);
-                }
-            }
-            cmark_iter_free(subIter);
-            
-            if (headingText.isEmpty())
-                headingText = tr("(Empty Heading)");
-            
-            QTreeWidgetItem *item = new QTreeWidgetItem();
-            item->setText(0, headingText);
-            item->setData(0, Qt::UserRole, startLine);
-            
-            while (parents.size() <= level) parents.append(nullptr);
-            while (parents.size() > level + 1) parents.removeLast();
-            
-            QTreeWidgetItem *parentItem = nullptr;
-            if (level > 0 && level < parents.size()) {
-                parentItem = parents[level - 1];
-            }
-            
-            if (parentItem) {
-                parentItem->addChild(item);
-            } else {
-                addTopLevelItem(item);
-            }
-            
-            if (parents.size() > level) {
-                parents[level] = item;
-            } else {
-                parents.append(item);
-            }
-            
-            item->setExpanded(true);
+    Page *page = pages.take(index);
+    if (!page) return;
+    
+    if (page == currentPage) {
+        currentPage = nullptr;
+        currentIndex = nullptr;
+        disconnect(cursorConnection);
+        pageStack->setCurrentWidget(emptyPage);
+    }
+    delete page->treeView;
+    delete page;
+}
+
+void DocumentOutlineWidget::setIndex(OutlineIndex *index)
+{
+    if (currentIndex == index) return;
+    
+    disconnect(cursorConnection);
+    currentIndex = index;
+    if (!index) {
+        currentPage = nullptr;
+        pageStack->setCurrentWidget(emptyPage);
+        return;
+    }
+    
+    // Pages stay current in the background, so switching costs nothing
+    Page *page = pages.value(index);
+    if (!page) {
+        page = createPage(index);
+    }
+    currentPage = page;
+    applyFilter(page);
+    pageStack->setCurrentWidget(page->treeView);
+    
+    cursorConnection = connect(index->editor(), &QTextEdit::cursorPositionChanged,
+                               this, &DocumentOutlineWidget::updateCurrentSection);
+    updateCurrentSection();
+}
+
+void DocumentOutlineWidget::expandDefault(Page *page)
+{
+    if (!page->filterText.isEmpty() || !isLargeOutline(page->model)) {
+        page->treeView->expandAll();
+    } else {
+        page->treeView->expandToDepth(0);
+    }
+}
+
+void DocumentOutlineWidget::onHeadingsChanged(Page *page, int first, int removed, int added)
+{
+    if (!isLargeOutline(page->model)) {
+        // New headings open expanded like the rest; edited ones keep their state
+        for (int i = first + qMin(removed, added); i < first + added; ++i) {
+            page->treeView->expand(page->filterModel->mapFromSource(page->model->indexOfHeading(i)));
         }
     }
     
-    cmark_iter_free(iter);
-    cmark_node_free(doc);
+    // Headings after the change were renumbered
+    if (page == currentPage) {
+        page->currentHeading = sectionAtCursor(page);
+        showCurrentSection(page);
+    }
 }
 
-void DocumentOutlineWidget::onItemClicked(QTreeWidgetItem *item, int column)
+void DocumentOutlineWidget::onFilterChanged(const QString &text)
 {
-    if (!currentEditor) return;
-    
-    int line = item->data(0, Qt::UserRole).toInt();
-    if (line > 0) {
-        QTextCursor cursor = currentEditor->textCursor();
-        cursor.movePosition(QTextCursor::Start);
-        cursor.movePosition(QTextCursor::Down, QTextCursor::MoveAnchor, line - 1);
-        currentEditor->setTextCursor(cursor);
-        currentEditor->ensureCursorVisible();
-        currentEditor->setFocus();
+    Q_UNUSED(text);
+    if (currentPage) {
+        applyFilter(currentPage);
+    }
+}
+
+void DocumentOutlineWidget::applyFilter(Page *page)
+{
+    // Background pages catch up with the filter when they are shown
+    if (page->filterText == filterEdit->text()) return;
+    
+    page->filterText = filterEdit->text();
+    page->filterModel->setFilterFixedString(page->filterText);
+    expandDefault(page);
+    showCurrentSection(page);
+}
+
+int DocumentOutlineWidget::sectionAtCursor(const Page *page) const
+{
+    OutlineIndex *outline = page->model->outlineIndex();
+    if (!outline) return -1;
+    
+    // A binary search over the headings, so this can run on every cursor move
+    EditorWidget *editor = outline->editor();
+    return outline->headingAtLine(editor->rawLineOfBlock(editor->textCursor().block()));
+}
+
+void DocumentOutlineWidget::updateCurrentSection()
+{
+    if (!currentPage) return;
+    
+    const int heading = sectionAtCursor(currentPage);
+    if (heading == currentPage->currentHeading) return;
+    
+    currentPage->currentHeading = heading;
+    showCurrentSection(currentPage);
+}
+
+void DocumentOutlineWidget::showCurrentSection(Page *page)
+{
+    QTreeView *treeView = page->treeView;
+    const QModelIndex index = page->filterModel->mapFromSource(page->model->indexOfHeading(page->currentHeading));
+    if (!index.isValid()) {
+        treeView->clearSelection();
+        return;
+    }
+    treeView->setCurrentIndex(index);
+    // Leave the scroll position alone while the outline is being browsed
+    if (!treeView->hasFocus()) {
+        treeView->scrollTo(index);
+    }
+}
+
+void DocumentOutlineWidget::onItemClicked(const QModelIndex &index)
+{
+    if (!currentPage) return;
+    
+    OutlineIndex *outline = currentPage->model->outlineIndex();
+    const int heading = currentPage->model->headingAt(currentPage->filterModel->mapToSource(index));
+    if (!outline || heading < 0) return;
+    
+    // The heading's stored block is only looked up again if it went stale
+    EditorWidget *editor = outline->editor();
+    const QTextBlock block = outline->blockOfHeading(heading);
+    if (block.isValid()) {
+        QTextCursor cursor = editor->textCursor();
+        cursor.setPosition(block.position());
+        editor->setTextCursor(cursor);
+        editor->ensureCursorVisible();
+        editor->setFocus();
     }
 }
 
 void DocumentOutlineWidget::keyPressEvent(QKeyEvent *event)
 {
-    // Prevent escape from being handled here - let parent handle it
+    // Escape clears the filter first, then goes to the parent
     if (event->key() == Qt::Key_Escape) {
+        if (!filterEdit->text().isEmpty()) {
+            filterEdit->clear();
+            if (currentPage) {
+                currentPage->treeView->setFocus();
+            }
+            return;
+        }
         event->ignore();
         return;
     }
-    QTreeWidget::keyPressEvent(event);
+    QWidget::keyPressEvent(event);
 }
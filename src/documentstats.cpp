@@ -0,0 +1,73 @@
+#include "documentstats.h"
+#include "editorwidget.h"
+
+DocumentStats::DocumentStats(EditorWidget *editor)
+    : QObject(editor), m_editor(editor)
+{
+    connect(editor, &EditorWidget::rawLinesChanged, this, &DocumentStats::onRawLinesChanged);
+    connect(editor, &EditorWidget::loadFinished, this, &DocumentStats::reset);
+    reset();
+}
+
+TextStats::Counts DocumentStats::totals() const
+{
+    TextStats::Counts totals = m_totals;
+    totals.characters += qMax<qsizetype>(0, m_lines.size() - 1);
+    return totals;
+}
+
+DocumentStats::LineCounts DocumentStats::countLine(QStringView line)
+{
+    const TextStats::Counts counts = TextStats::count(line);
+    return { quint32(counts.words), quint32(counts.characters) };
+}
+
+void DocumentStats::reset()
+{
+    m_lines.clear();
+    m_totals = TextStats::Counts();
+    m_revision = m_editor->contentRevision();
+
+    if (!m_editor->isLoading()) {
+        const QString markdown = m_editor->getRawMarkdown();
+        QStringView rest(markdown);
+        for (;;) {
+            const qsizetype end = rest.indexOf(QLatin1Char('\n'));
+            const LineCounts line = countLine(end < 0 ? rest : rest.left(end));
+            m_lines.append(line);
+            m_totals.words += line.words;
+            m_totals.characters += line.characters;
+            if (end < 0) {
+                break;
+            }
+            rest = rest.mid(end + 1);
+        }
+    }
+
+    emit changed();
+}
+
+void DocumentStats::onRawLinesChanged(int firstLine, int removedLines, const QStringList &addedLines)
+{
+    if (firstLine < 0 || removedLines < 0 || firstLine + removedLines > m_lines.size()) {
+        reset(); // Out of step with the editor
+        return;
+    }
+    m_revision = m_editor->contentRevision();
+
+    for (int i = firstLine; i < firstLine + removedLines; ++i) {
+        m_totals.words -= m_lines[i].words;
+        m_totals.characters -= m_lines[i].characters;
+    }
+    m_lines.remove(firstLine, removedLines);
+
+    m_lines.insert(firstLine, addedLines.size(), LineCounts());
+    for (int i = 0; i < addedLines.size(); ++i) {
+        const LineCounts line = countLine(addedLines[i]);
+        m_lines[firstLine + i] = line;
+        m_totals.words += line.words;
+        m_totals.characters += line.characters;
+    }
+
+    emit changed();
+}
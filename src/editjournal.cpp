@@ -0,0 +1,475 @@
+#include "editjournal.h"
+#include "editorwidget.h"
+#include "textcodec.h"
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <QUuid>
+#include <cstring>
+#include <utility>
+
+#if defined(Q_OS_UNIX)
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <io.h>
+#endif
+
+namespace {
+
+const char JournalMagic[8] = { 'S', 'C', 'R', 'J', 'R', 'N', 'L', '\0' };
+const quint32 JournalVersion = 1;
+
+// Delay before buffered records are written and fsync'd as one batch. A crash
+// loses at most this much typing.
+const int FlushDelayMs = 1000;
+
+// Records are compacted into a snapshot once they outgrow the base (but not
+// before this size), or at this many records, which bounds replay time.
+const qint64 MinCompactBytes = 1024 * 1024;
+const int CompactRecordCount = 4096;
+
+enum RecordType : quint8 {
+    BaseFile = 1,     // path, size, modification time: start from the file on disk
+    Snapshot = 2,     // path, UTF-8 text: start from this text
+    ReplaceLines = 3, // first line, removed count, added lines as UTF-8
+    FilePath = 4      // path: the document was saved under a new name
+};
+
+void syncToDisk(QFile &file)
+{
+    file.flush();
+#if defined(Q_OS_UNIX)
+    ::fsync(file.handle());
+#elif defined(Q_OS_WIN)
+    ::_commit(file.handle());
+#endif
+}
+
+void setStreamVersion(QDataStream &stream)
+{
+    stream.setVersion(QDataStream::Qt_6_0); // Journals must stay readable across Qt upgrades
+}
+
+QByteArray journalHeader()
+{
+    QByteArray header;
+    QDataStream out(&header, QIODevice::WriteOnly);
+    setStreamVersion(out);
+    out.writeRawData(JournalMagic, sizeof(JournalMagic));
+    out << JournalVersion;
+    return header;
+}
+
+// Each record is prefixed with its size and checksum, so a record torn by a
+// crash ends the replay instead of corrupting it.
+QByteArray frameRecord(const QByteArray &payload)
+{
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    setStreamVersion(out);
+    out << quint32(payload.size()) << quint16(qChecksum(payload));
+    out.writeRawData(payload.constData(), payload.size());
+    return record;
+}
+
+void writeJournal(const QString &journalPath, const QByteArray &contents)
+{
+    QSaveFile file(journalPath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(contents) != contents.size() || !file.commit()) {
+        qWarning() << "EditJournal: Cannot write" << journalPath << file.errorString();
+    }
+}
+
+void appendToJournal(const QString &journalPath, const QByteArray &records)
+{
+    QFile file(journalPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "EditJournal: Cannot append to" << journalPath << file.errorString();
+        return;
+    }
+    file.write(records);
+    syncToDisk(file);
+}
+
+bool replayJournal(const QString &journalPath, EditJournal::Recovery *recovery)
+{
+    QFile file(journalPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    setStreamVersion(in);
+    char magic[sizeof(JournalMagic)];
+    quint32 version = 0;
+    if (in.readRawData(magic, sizeof(magic)) != int(sizeof(magic))
+        || std::memcmp(magic, JournalMagic, sizeof(magic)) != 0) {
+        return false;
+    }
+    in >> version;
+    if (in.status() != QDataStream::Ok || version != JournalVersion) {
+        return false;
+    }
+
+    QStringList lines;
+    bool haveBase = false;
+    while (!in.atEnd()) {
+        quint32 size = 0;
+        quint16 checksum = 0;
+        in >> size >> checksum;
+        if (in.status() != QDataStream::Ok || size > quint64(file.bytesAvailable())) {
+            break; // Torn record at the end
+        }
+        QByteArray payload(size, Qt::Uninitialized);
+        if (in.readRawData(payload.data(), size) != int(size) || qChecksum(payload) != checksum) {
+            break;
+        }
+
+        QDataStream record(payload);
+        setStreamVersion(record);
+        quint8 type = 0;
+        record >> type;
+        switch (type) {
+        case BaseFile: {
+            QString path;
+            qint64 baseSize = 0;
+            qint64 baseModified = 0;
+            record >> path >> baseSize >> baseModified;
+            QFileInfo info(path);
+            if (!info.exists() || info.size() != baseSize
+                || info.lastModified().toMSecsSinceEpoch() != baseModified) {
+                qWarning() << "EditJournal: File changed since its journal was started:" << path;
+                return false;
+            }
+            QFile base(path);
+            if (!base.open(QIODevice::ReadOnly)) {
+                return false;
+            }
+            TextCodec::FileFormat format;
+            lines = TextCodec::decode(base.readAll(), &format).split(QLatin1Char('\n'));
+            recovery->filePath = path;
+            haveBase = true;
+            break;
+        }
+        case Snapshot: {
+            QString path;
+            QByteArray text;
+            record >> path >> text;
+            lines = QString::fromUtf8(text).split(QLatin1Char('\n'));
+            recovery->filePath = path;
+            haveBase = true;
+            break;
+        }
+        case FilePath:
+            record >> recovery->filePath;
+            break;
+        case ReplaceLines: {
+            quint32 first = 0;
+            quint32 removed = 0;
+            quint32 count = 0;
+            record >> first >> removed >> count;
+            if (!haveBase || first > quint32(lines.size()) || removed > quint32(lines.size()) - first
+                || count > quint32(payload.size())) {
+                qWarning() << "EditJournal: Inconsistent record in" << journalPath;
+                return false;
+            }
+            // Typing replaces one line with one line, which needs no shifting
+            if (removed > count) {
+                lines.remove(first + count, removed - count);
+            } else if (count > removed) {
+                lines.insert(first + removed, count - removed, QString());
+            }
+            for (quint32 i = 0; i < count; ++i) {
+                QByteArray line;
+                record >> line;
+                lines[first + i] = QString::fromUtf8(line);
+            }
+            break;
+        }
+        default:
+            return false;
+        }
+
+        if (record.status() != QDataStream::Ok) {
+            return false;
+        }
+    }
+
+    if (!haveBase) {
+        return false;
+    }
+    recovery->journalPath = journalPath;
+    recovery->text = lines.join(QLatin1Char('\n'));
+    return true;
+}
+
+} // namespace
+
+EditJournal::EditJournal(EditorWidget *editor)
+    : QObject(editor), m_editor(editor)
+{
+    m_journalPath = journalDirectory() + QLatin1Char('/')
+        + QUuid::createUuid().toString(QUuid::WithoutBraces) + QStringLiteral(".journal");
+
+    // The lock tells other instances this journal is live; it only goes stale
+    // when this process dies.
+    m_lock = std::make_shared<QLockFile>(m_journalPath + QStringLiteral(".lock"));
+    m_lock->setStaleLockTime(0);
+    if (!m_lock->tryLock(0)) {
+        qWarning() << "EditJournal: Cannot lock" << m_journalPath;
+    }
+
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(FlushDelayMs);
+    connect(&m_flushTimer, &QTimer::timeout, this, &EditJournal::flush);
+
+    connect(editor, &EditorWidget::rawLinesChanged, this, &EditJournal::onRawLinesChanged);
+    connect(editor->document(), &QTextDocument::modificationChanged, this, &EditJournal::onModificationChanged);
+}
+
+EditJournal::~EditJournal()
+{
+    // Closing the document, saved or discarded, ends its journal. The lock is
+    // released once the I/O thread has removed the file.
+    const QString journalPath = m_journalPath;
+    std::shared_ptr<QLockFile> lock = std::move(m_lock);
+    ioPool()->start([journalPath, lock]() {
+        QFile::remove(journalPath);
+        lock->unlock();
+    });
+}
+
+void EditJournal::setFilePath(const QString &path)
+{
+    if (path == m_filePath) {
+        return;
+    }
+    m_filePath = path;
+
+    if (m_active) {
+        QByteArray payload;
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        setStreamVersion(out);
+        out << quint8(FilePath) << m_filePath;
+        appendRecord(payload);
+    } else if (m_editor && !m_editor->document()->isModified()) {
+        captureDiskBase();
+    }
+}
+
+void EditJournal::documentSaved()
+{
+    if (!m_editor) {
+        return;
+    }
+    if (!m_editor->document()->isModified()) {
+        reset();
+    } else if (m_active) {
+        // Edits made during the save are still unsaved, but the file the
+        // journal may have started from was just overwritten.
+        recordSnapshot();
+    }
+}
+
+void EditJournal::recordSnapshot()
+{
+    if (!m_editor) {
+        return;
+    }
+
+    m_flushTimer.stop();
+    m_unflushed.clear(); // Superseded by the snapshot
+
+    const QString text = m_editor->getRawMarkdown();
+    const QString journalPath = m_journalPath;
+    const QString filePath = m_filePath;
+    ioPool()->start([journalPath, filePath, text]() {
+        QByteArray payload;
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        setStreamVersion(out);
+        out << quint8(Snapshot) << filePath << text.toUtf8();
+        writeJournal(journalPath, journalHeader() + frameRecord(payload));
+    });
+
+    m_active = true;
+    m_baseBytes = text.size();
+    m_recordBytes = 0;
+    m_recordCount = 0;
+}
+
+QList<EditJournal::Recovery> EditJournal::findOrphans()
+{
+    QList<Recovery> recoveries;
+    QDir dir(journalDirectory());
+
+    const QFileInfoList journals = dir.entryInfoList({ QStringLiteral("*.journal") }, QDir::Files, QDir::Time);
+    for (const QFileInfo &info : journals) {
+        QLockFile lock(info.filePath() + QStringLiteral(".lock"));
+        lock.setStaleLockTime(0);
+        if (!lock.tryLock(0)) {
+            continue; // Document open in a running instance
+        }
+
+        Recovery recovery;
+        if (replayJournal(info.filePath(), &recovery)) {
+            recoveries.append(recovery);
+        } else {
+            qWarning() << "EditJournal: Discarding unusable journal" << info.filePath();
+            QFile::remove(info.filePath());
+        }
+    }
+
+    // Locks of documents that crashed before their first edit
+    const QFileInfoList locks = dir.entryInfoList({ QStringLiteral("*.journal.lock") }, QDir::Files);
+    for (const QFileInfo &info : locks) {
+        QString journalPath = info.filePath();
+        journalPath.chop(5);
+        if (!QFile::exists(journalPath)) {
+            QLockFile lock(info.filePath());
+            lock.setStaleLockTime(0);
+            lock.tryLock(0); // Removes the lock of a dead process
+        }
+    }
+
+    return recoveries;
+}
+
+void EditJournal::discard(const QString &journalPath)
+{
+    // Queued behind any snapshot that took over the recovered content
+    ioPool()->start([journalPath]() {
+        QFile::remove(journalPath);
+    });
+}
+
+void EditJournal::onRawLinesChanged(int firstLine, int removedLines, const QStringList &addedLines)
+{
+    if (!m_active) {
+        // The first edit after a save starts from the file on disk if it is
+        // still the one the document was loaded from.
+        QFileInfo info(m_filePath);
+        const bool diskBaseValid = m_diskSize >= 0 && info.exists()
+            && info.size() == m_diskSize && info.lastModified() == m_diskModified;
+        if (!diskBaseValid) {
+            recordSnapshot(); // Already includes this edit
+            return;
+        }
+
+        QByteArray base;
+        QDataStream out(&base, QIODevice::WriteOnly);
+        setStreamVersion(out);
+        out << quint8(BaseFile) << m_filePath << m_diskSize << m_diskModified.toMSecsSinceEpoch();
+        const QString journalPath = m_journalPath;
+        ioPool()->start([journalPath, base]() {
+            writeJournal(journalPath, journalHeader() + frameRecord(base));
+        });
+
+        m_active = true;
+        m_baseBytes = m_diskSize;
+        m_recordBytes = 0;
+        m_recordCount = 0;
+    }
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    setStreamVersion(out);
+    out << quint8(ReplaceLines) << quint32(firstLine) << quint32(removedLines) << quint32(addedLines.size());
+    for (const QString &line : addedLines) {
+        out << line.toUtf8();
+    }
+    appendRecord(payload);
+
+    if (m_recordCount >= CompactRecordCount || m_recordBytes > qMax(MinCompactBytes, m_baseBytes)) {
+        recordSnapshot();
+    }
+}
+
+void EditJournal::onModificationChanged(bool modified)
+{
+    // Saved, or undone back to the saved state
+    if (!modified) {
+        reset();
+    }
+}
+
+void EditJournal::flush()
+{
+    if (m_unflushed.isEmpty()) {
+        return;
+    }
+    const QString journalPath = m_journalPath;
+    const QByteArray records = std::exchange(m_unflushed, QByteArray());
+    ioPool()->start([journalPath, records]() {
+        appendToJournal(journalPath, records);
+    });
+}
+
+void EditJournal::appendRecord(const QByteArray &payload)
+{
+    m_unflushed += frameRecord(payload);
+    m_recordBytes += payload.size();
+    ++m_recordCount;
+    // Not restarted by later records, so continuous typing is still flushed
+    if (!m_flushTimer.isActive()) {
+        m_flushTimer.start();
+    }
+}
+
+void EditJournal::reset()
+{
+    m_flushTimer.stop();
+    m_unflushed.clear();
+    if (m_active) {
+        const QString journalPath = m_journalPath;
+        ioPool()->start([journalPath]() {
+            QFile::remove(journalPath);
+        });
+    }
+    m_active = false;
+    m_baseBytes = 0;
+    m_recordBytes = 0;
+    m_recordCount = 0;
+    captureDiskBase();
+}
+
+void EditJournal::captureDiskBase()
+{
+    QFileInfo info(m_filePath);
+    if (m_filePath.isEmpty() || !info.exists()) {
+        m_diskSize = -1;
+        m_diskModified = QDateTime();
+        return;
+    }
+    m_diskSize = info.size();
+    m_diskModified = info.lastModified();
+}
+
+QString EditJournal::journalDirectory()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+    const QString base = QStandardPaths::writableLocation(QStandardPaths::StateLocation);
+#else
+    const QString base = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+#endif
+    const QString path = base + QStringLiteral("/journal");
+    QDir().mkpath(path);
+    return path;
+}
+
+QThreadPool *EditJournal::ioPool()
+{
+    // A single thread keeps the writes of every journal in submission order
+    static QThreadPool *pool = []() {
+        QThreadPool *threadPool = new QThreadPool(QCoreApplication::instance());
+        threadPool->setMaxThreadCount(1);
+        return threadPool;
+    }();
+    return pool;
+}
@@ -1,6 +1,7 @@
 #include "editorwidget.h"
 #include "markdownhighlighter.h"
 #include "spellchecker.h"
+#include "spelltokenizer.h"
 #include "thememanager.h"
 #include <QFont>
 #include <QDir>
@@ -12,11 +13,20 @@
 #include <QShortcut> 
 #include <QMenu> 
 #include <QAction> 
+#include <QFutureWatcher>
 #include <QScrollBar>
 #include <QTextDocumentFragment>
 #include <QTextList>
+#include <QSet>
+#include <QElapsedTimer>
 #include <cmark.h>
+#include <algorithm>
+#include <cstdlib>
 
+namespace {
+// Time a background spell-check slice may run before yielding to the event loop
+const int SpellSliceBudgetMs = 8;
+}
 
 EditorWidget::EditorWidget(QWidget *parent)
     : QTextEdit(parent), currentTheme(Theme::Dark), currentZoom(0)
@@ -78,12 +88,50 @@ EditorWidget::EditorWidget(QWidget *parent)
         qDebug() << "EditorWidget: Successfully loaded spell checker with 'en_US' dictionary.";
     }
 
+    // Words outside the compiled dictionary are only verified once Hunspell has loaded
+    connect(spellChecker.data(), &SpellChecker::dictionaryReady, this, &EditorWidget::checkSpelling);
+    connect(spellChecker.data(), &SpellChecker::personalDictionaryChanged, this, [this]() {
+        if (spellCheckEnabled) {
+            spellCheckTimer->start();
+        }
+    });
+
     // Create a timer for delayed spell checking to avoid checking on every keystroke
     spellCheckTimer = new QTimer(this);
     spellCheckTimer->setSingleShot(true);
     spellCheckTimer->setInterval(500);
     connect(spellCheckTimer, &QTimer::timeout, this, &EditorWidget::checkSpelling);
 
+    // Blocks outside the viewport are checked in short slices between events
+    spellSliceTimer = new QTimer(this);
+    spellSliceTimer->setSingleShot(true);
+    spellSliceTimer->setInterval(0);
+    connect(spellSliceTimer, &QTimer::timeout, this, &EditorWidget::continueSpellPass);
+
+    // Blocks scrolled into view while loading are rendered ahead of the rest
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, [this]() {
+        if (loading) {
+            renderVisibleLoadedBlocks();
+        }
+    });
+
+    // Newly exposed blocks jump ahead of the background slices
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, [this]() {
+        if (spellCheckEnabled && spellPendingBlocks > 0) {
+            checkVisibleBlocks();
+        }
+    });
+
+    // Warm the suggestion cache for flagged words once the user pauses
+    suggestionPrecomputeTimer = new QTimer(this);
+    suggestionPrecomputeTimer->setSingleShot(true);
+    suggestionPrecomputeTimer->setInterval(1500);
+    connect(suggestionPrecomputeTimer, &QTimer::timeout, this, [this]() {
+        if (spellChecker && !flaggedWords.isEmpty()) {
+            spellChecker->precomputeSuggestions(flaggedWords);
+        }
+    });
+
     // Connect to text changes to trigger delayed spell checking
     connect(this, &QTextEdit::textChanged, [this]() {
         if (spellCheckEnabled && spellChecker && spellChecker->isInitialized()) {
@@ -98,6 +146,10 @@ EditorWidget::EditorWidget(QWidget *parent)
 
     // Connect cursor position tracking for Live Preview
     connect(this, &QTextEdit::cursorPositionChanged, this, &EditorWidget::onCursorPositionChanged);
+
+    // Rendering, revealing and spell underlines run with document signals
+    // blocked, so only real edits advance the revision.
+    connect(document(), &QTextDocument::contentsChange, this, &EditorWidget::onContentsChange);
 }
 
 EditorWidget::~EditorWidget()
@@ -107,6 +159,10 @@ EditorWidget::~EditorWidget()
 
 void EditorWidget::onCursorPositionChanged()
 {
+    if (loading || applyingLineChanges) {
+        return; // Synced once the load or the external change completes
+    }
+
     int currentBlockNumber = textCursor().blockNumber();
 
     // If we've moved to a new block
@@ -131,7 +187,7 @@ void EditorWidget::onCursorPositionChanged()
                     QTextBlock checkBlock = prevBlock;
                     while (checkBlock.isValid()) {
                         MarkdownBlockData* checkData = static_cast<MarkdownBlockData*>(checkBlock.userData());
-                        if (checkData && checkData->isRendered && checkData->rawMarkdown == rawMd) {
+                        if (checkBlock == prevBlock || (checkData && checkData->isContinuation && checkData->rawMarkdown == rawMd)) {
                             // Already marked, continue
                             checkBlock = checkBlock.next();
                         } else {
@@ -160,7 +216,7 @@ void EditorWidget::onCursorPositionChanged()
                 QTextBlock nextBlock = currentBlock.next();
                 while (nextBlock.isValid()) {
                     MarkdownBlockData* nextData = static_cast<MarkdownBlockData*>(nextBlock.userData());
-                    if (nextData && nextData->isRendered && nextData->rawMarkdown == rawMd) {
+                    if (nextData && nextData->isRendered && nextData->isContinuation && nextData->rawMarkdown == rawMd) {
                         totalMerged += revealBlock(nextBlock);
                         nextBlock = nextBlock.next();
                     } else {
@@ -180,12 +236,13 @@ void EditorWidget::onCursorPositionChanged()
         }
 
         document()->blockSignals(oldState);
+        syncBlockTracking();
     }
 }
 
 QString EditorWidget::renderMarkdownToHtml(const QString& markdown) {
     QByteArray utf8 = markdown.toUtf8();
-    int options = CMARK_OPT_DEFAULT | CMARK_OPT_SMART | CMARK_OPT_VALIDATE_UTF8;
+    int options = CMARK_OPT_DEFAULT | CMARK_OPT_SMART; // QString::toUtf8() never yields invalid UTF-8
     char *html = cmark_markdown_to_html(utf8.constData(), utf8.size(), options);
     QString result = QString::fromUtf8(html);
     free(html);
@@ -204,6 +261,115 @@ QString EditorWidget::renderMarkdownToHtml(const QString& markdown) {
     return result;
 }
 
+void EditorWidget::beginIncrementalLoad()
+{
+    loading = true;
+    loadRenderedBlocks = 0;
+    setReadOnly(true); // Edits would interleave with appended chunks
+    document()->setUndoRedoEnabled(false);
+    clear();
+}
+
+void EditorWidget::appendMarkdownChunk(const QString &text)
+{
+    if (!loading || text.isEmpty()) {
+        return;
+    }
+
+    const bool firstChunk = document()->isEmpty();
+    bool oldState = document()->signalsBlocked();
+    document()->blockSignals(true);
+
+    // Only raw text goes in here; rendering a chunk's blocks costs far more
+    // than a turn, so they are rendered by renderLoadedBlocks() in slices
+    QTextCursor cursor(document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(text);
+
+    document()->blockSignals(oldState);
+    syncBlockTracking();
+
+    if (firstChunk) {
+        moveCursor(QTextCursor::Start); // Later chunks are appended behind the cursor
+        renderVisibleLoadedBlocks();
+        if (spellCheckEnabled) {
+            checkSpelling(); // Underlines for the first screen; the full pass runs at the end
+        }
+    }
+}
+
+bool EditorWidget::renderLoadedBlocks(int budgetMs)
+{
+    if (!loading) {
+        return true;
+    }
+
+    QElapsedTimer budget;
+    budget.start();
+
+    bool oldState = document()->signalsBlocked();
+    document()->blockSignals(true);
+    // The last block may still be continued by the next chunk; blocks
+    // rendered early because they were on screen are skipped by renderBlock()
+    QTextBlock block = document()->findBlockByNumber(loadRenderedBlocks);
+    while (block.isValid() && block.next().isValid() && budget.elapsed() < budgetMs) {
+        renderBlock(block);
+        block = block.next();
+    }
+    loadRenderedBlocks = block.isValid() ? block.blockNumber() : document()->blockCount();
+    document()->blockSignals(oldState);
+    syncBlockTracking();
+
+    return !block.isValid() || !block.next().isValid();
+}
+
+void EditorWidget::renderVisibleLoadedBlocks()
+{
+    const int first = qMax(cursorForPosition(QPoint(0, 0)).blockNumber(), loadRenderedBlocks);
+    const int last = cursorForPosition(QPoint(viewport()->width() - 1, viewport()->height() - 1)).blockNumber();
+    if (first > last) {
+        return;
+    }
+
+    bool oldState = document()->signalsBlocked();
+    document()->blockSignals(true);
+    int count = last - first + 1;
+    for (QTextBlock block = document()->findBlockByNumber(first);
+         block.isValid() && block.next().isValid() && count > 0; block = block.next(), --count) {
+        renderBlock(block);
+    }
+    document()->blockSignals(oldState);
+    syncBlockTracking();
+}
+
+void EditorWidget::endIncrementalLoad()
+{
+    if (!loading) {
+        return;
+    }
+
+    bool oldState = document()->signalsBlocked();
+    document()->blockSignals(true);
+    for (QTextBlock block = document()->findBlockByNumber(loadRenderedBlocks); block.isValid(); block = block.next()) {
+        renderBlock(block);
+    }
+    document()->blockSignals(oldState);
+    syncBlockTracking();
+
+    loading = false;
+    ++revisionCounter;
+    document()->setUndoRedoEnabled(true);
+    setReadOnly(false);
+    document()->setModified(false);
+
+    // Reveal the block under the cursor, as after a regular load
+    onCursorPositionChanged();
+
+    // Listeners skipped the chunk edits while signals were blocked
+    emit textChanged();
+    emit loadFinished();
+}
+
 void EditorWidget::renderBlock(QTextBlock block) {
     if (!block.isValid()) return;
 
@@ -282,6 +448,9 @@ void EditorWidget::renderBlock(QTextBlock block) {
             }
             extraData->rawMarkdown = raw;
             extraData->isRendered = true;
+            extraData->isContinuation = true;
+            continuationMarkers.append(QTextCursor(extraBlock));
+            continuationBlocksStale = true;
         }
     }
     
@@ -307,7 +476,10 @@ int EditorWidget::revealBlock(QTextBlock block) {
     
     while (currentBlock.isValid()) {
         MarkdownBlockData* currentData = static_cast<MarkdownBlockData*>(currentBlock.userData());
-        if (currentData && currentData->isRendered && currentData->rawMarkdown == rawMarkdown) {
+        bool partOfElement = currentBlock == block
+            || (currentData && currentData->isRendered && currentData->isContinuation
+                && currentData->rawMarkdown == rawMarkdown);
+        if (partOfElement) {
             renderedBlocks.append(currentBlock);
             currentBlock = currentBlock.next();
         } else {
@@ -371,27 +543,313 @@ void EditorWidget::renderAllBlocks() {
     }
 
     document()->blockSignals(oldState);
+    syncBlockTracking();
 }
 
 QString EditorWidget::getRawMarkdown() const {
     QString fullText;
-    QTextBlock block = document()->begin();
-    while (block.isValid()) {
+    bool firstLine = true;
+    for (QTextBlock block = document()->begin(); block.isValid(); block = block.next()) {
         MarkdownBlockData* data = static_cast<MarkdownBlockData*>(block.userData());
-        if (data && data->isRendered) {
-            fullText += data->rawMarkdown;
-        } else {
-            fullText += block.text();
+        if (data && data->isRendered && data->isContinuation) {
+            continue; // Its raw text was emitted with the primary block
         }
-        
-        if (block.next().isValid()) {
+        if (!firstLine) {
             fullText += "\n";
         }
-        block = block.next();
+        firstLine = false;
+        fullText += (data && data->isRendered) ? data->rawMarkdown : block.text();
     }
     return fullText;
 }
 
+QString EditorWidget::rawTextOfBlock(const QTextBlock &block) const
+{
+    MarkdownBlockData* data = static_cast<MarkdownBlockData*>(block.userData());
+    if (data && data->isRendered) {
+        return data->isContinuation ? QString() : data->rawMarkdown;
+    }
+    return block.text();
+}
+
+QTextBlock EditorWidget::blockOfRawLine(int line) const
+{
+    if (line < 0) {
+        return QTextBlock();
+    }
+
+    // Every continuation block at or before the target pushes it one block down
+    updateContinuationBlocks();
+    const auto pushing = std::upper_bound(continuationLines.cbegin(), continuationLines.cend(), line);
+    return document()->findBlockByNumber(line + int(pushing - continuationLines.cbegin()));
+}
+
+int EditorWidget::rawLineOfBlock(const QTextBlock &block) const
+{
+    if (!block.isValid() || block.document() != document()) {
+        return -1;
+    }
+
+    // Counting a continuation block itself maps it to the line before
+    updateContinuationBlocks();
+    const int blockNumber = block.blockNumber();
+    const auto after = std::upper_bound(continuationBlocks.cbegin(), continuationBlocks.cend(), blockNumber);
+    return blockNumber - int(after - continuationBlocks.cbegin());
+}
+
+void EditorWidget::selectRawText(int line, int column, int length)
+{
+    const QTextBlock target = blockOfRawLine(line);
+    if (!target.isValid()) {
+        return;
+    }
+
+    // Entering the block reveals its Markdown, which moves the blocks after it
+    QTextCursor cursor = textCursor();
+    cursor.setPosition(target.position());
+    setTextCursor(cursor);
+
+    const QTextBlock block = blockOfRawLine(line);
+    const int start = block.position() + qBound(0, column, block.length() - 1);
+    const int end = qMin(start + qMax(0, length), block.position() + block.length() - 1);
+    cursor.setPosition(start);
+    cursor.setPosition(end, QTextCursor::KeepAnchor);
+    setTextCursor(cursor);
+    ensureCursorVisible();
+}
+
+void EditorWidget::applyLineChanges(const QVector<LineDiff::Hunk> &hunks, const QStringList &newLines)
+{
+    QVector<QStringList> replacements;
+    replacements.reserve(hunks.size());
+    for (const LineDiff::Hunk &hunk : hunks) {
+        replacements.append(newLines.mid(hunk.newStart, hunk.newCount));
+    }
+    applyHunks(hunks, replacements);
+}
+
+void EditorWidget::replaceRawLines(const QVector<int> &lines, const QStringList &texts)
+{
+    // Runs of consecutive lines become one hunk each
+    QVector<LineDiff::Hunk> hunks;
+    QVector<QStringList> replacements;
+    for (int i = 0; i < lines.size(); ++i) {
+        if (hunks.isEmpty() || lines[i] != hunks.last().oldStart + hunks.last().oldCount) {
+            LineDiff::Hunk hunk;
+            hunk.oldStart = hunk.newStart = lines[i];
+            hunks.append(hunk);
+            replacements.append(QStringList());
+        }
+        ++hunks.last().oldCount;
+        ++hunks.last().newCount;
+        replacements.last().append(texts[i]);
+    }
+    applyHunks(hunks, replacements);
+}
+
+void EditorWidget::applyHunks(const QVector<LineDiff::Hunk> &hunks, const QVector<QStringList> &replacements)
+{
+    if (hunks.isEmpty() || loading) {
+        return;
+    }
+
+    // Span of every raw line; continuation blocks extend the line before them
+    QVector<int> lineStart;
+    QVector<int> lineEnd;
+    lineStart.reserve(document()->blockCount());
+    lineEnd.reserve(document()->blockCount());
+    for (QTextBlock block = document()->begin(); block.isValid(); block = block.next()) {
+        MarkdownBlockData* data = static_cast<MarkdownBlockData*>(block.userData());
+        if (!(data && data->isRendered && data->isContinuation) || lineStart.isEmpty()) {
+            lineStart.append(block.position());
+            lineEnd.append(0);
+        }
+        lineEnd.last() = block.position() + block.length() - 1;
+    }
+    const int lineCount = lineStart.size();
+
+    const int scrollValue = verticalScrollBar()->value();
+    QVector<QPair<int, int>> changedLines; // [first, end) in the new text, descending
+    applyingLineChanges = true;
+
+    // Back to front, so the spans of earlier lines stay valid
+    QTextCursor cursor(document());
+    cursor.beginEditBlock();
+    for (int i = hunks.size() - 1; i >= 0; --i) {
+        const LineDiff::Hunk &hunk = hunks[i];
+        QStringList replacement = replacements[i];
+        int oldCount = hunk.oldCount;
+
+        if (hunk.oldStart > 0) {
+            // Replacing from the end of the line before leaves every block
+            // that survives, with its render state, where it was.
+            const int from = lineEnd[hunk.oldStart - 1];
+            const int to = oldCount > 0 ? lineEnd[hunk.oldStart + oldCount - 1] : from;
+            QString text;
+            for (const QString &line : std::as_const(replacement)) {
+                text += QLatin1Char('\n') + line;
+            }
+            cursor.setPosition(from);
+            cursor.setPosition(to, QTextCursor::KeepAnchor);
+            cursor.insertText(text, QTextCharFormat());
+        } else {
+            // The first line has none before it, so it is always replaced
+            // along with the hunk, and so is the line after a pure deletion.
+            if ((oldCount == 0 || replacement.isEmpty()) && oldCount < lineCount) {
+                replacement.append(rawTextOfBlock(document()->findBlock(lineStart[oldCount])));
+                ++oldCount;
+            }
+            if (replacement.isEmpty()) {
+                replacement.append(QString());
+            }
+            document()->begin().setUserData(nullptr); // Its raw text is about to change
+            cursor.setPosition(0);
+            cursor.setPosition(lineEnd[oldCount - 1], QTextCursor::KeepAnchor);
+            cursor.insertText(replacement.join(QLatin1Char('\n')), QTextCharFormat());
+        }
+        changedLines.append(qMakePair(hunk.newStart, hunk.newStart + int(replacement.size())));
+    }
+    cursor.endEditBlock();
+
+    // Render the inserted lines; the one holding the cursor stays raw
+    bool oldState = document()->signalsBlocked();
+    document()->blockSignals(true);
+    const QTextBlock cursorBlock = textCursor().block();
+    int line = -1;
+    int range = changedLines.size() - 1;
+    for (QTextBlock block = document()->begin(); block.isValid() && range >= 0; block = block.next()) {
+        MarkdownBlockData* data = static_cast<MarkdownBlockData*>(block.userData());
+        if (data && data->isRendered && data->isContinuation) {
+            continue;
+        }
+        ++line;
+        while (range >= 0 && line >= changedLines[range].second) {
+            --range;
+        }
+        if (range < 0 || line < changedLines[range].first) {
+            continue;
+        }
+        block.setUserData(nullptr);
+        QTextCursor(block).setBlockFormat(QTextBlockFormat());
+        if (block != cursorBlock) {
+            renderBlock(block);
+        }
+    }
+    document()->blockSignals(oldState);
+    syncBlockTracking();
+    applyingLineChanges = false;
+
+    // The cursor may have landed in a rendered line; reveal it as after a move
+    activeBlockNumber = -1;
+    onCursorPositionChanged();
+    verticalScrollBar()->setValue(scrollValue);
+}
+
+bool EditorWidget::isContinuationMarker(const QTextCursor &marker) const
+{
+    QTextBlock block = marker.block();
+    MarkdownBlockData* data = static_cast<MarkdownBlockData*>(block.userData());
+    return data && data->isRendered && data->isContinuation && marker.position() == block.position();
+}
+
+void EditorWidget::syncBlockTracking()
+{
+    if (trackedBlockCount != document()->blockCount()) {
+        trackedBlockCount = document()->blockCount();
+        continuationBlocksStale = true;
+    }
+    // Revealing merges continuation blocks away; their markers collapse elsewhere
+    const auto removed = std::remove_if(continuationMarkers.begin(), continuationMarkers.end(),
+                                        [this](const QTextCursor &marker) {
+                                            return !isContinuationMarker(marker);
+                                        });
+    if (removed != continuationMarkers.end()) {
+        continuationMarkers.erase(removed, continuationMarkers.end());
+        continuationBlocksStale = true;
+    }
+}
+
+void EditorWidget::updateContinuationBlocks() const
+{
+    if (!continuationBlocksStale) {
+        return;
+    }
+    continuationBlocksStale = false;
+    continuationBlocks.clear();
+    continuationBlocks.reserve(continuationMarkers.size());
+    for (const QTextCursor &marker : continuationMarkers) {
+        continuationBlocks.append(marker.blockNumber());
+    }
+    std::sort(continuationBlocks.begin(), continuationBlocks.end());
+
+    // The i-th continuation block, minus the i before it, is the last raw line it pushes down
+    continuationLines.resize(continuationBlocks.size());
+    for (int i = 0; i < continuationBlocks.size(); ++i) {
+        continuationLines[i] = continuationBlocks[i] - i;
+    }
+}
+
+void EditorWidget::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved);
+    ++revisionCounter;
+
+    if (loading) {
+        syncBlockTracking();
+        return;
+    }
+
+    // The edited blocks are known after the fact; how many blocks they replaced
+    // follows from the change in block count since the last sync.
+    const QTextBlock firstBlock = document()->findBlock(position);
+    QTextBlock lastBlock = document()->findBlock(position + charsAdded);
+    if (!lastBlock.isValid()) {
+        lastBlock = document()->lastBlock();
+    }
+    const int blockCount = document()->blockCount();
+    const int addedBlocks = lastBlock.blockNumber() - firstBlock.blockNumber() + 1;
+    const int removedBlocks = addedBlocks + trackedBlockCount - blockCount;
+    if (trackedBlockCount != blockCount) {
+        trackedBlockCount = blockCount;
+        continuationBlocksStale = true;
+    }
+
+    // Continuation blocks have no raw line of their own. Markers that no
+    // longer sit on one belonged to blocks this edit removed.
+    int continuationsBefore = 0;
+    int continuationsRemoved = 0;
+    for (auto it = continuationMarkers.begin(); it != continuationMarkers.end();) {
+        if (!isContinuationMarker(*it)) {
+            ++continuationsRemoved;
+            continuationBlocksStale = true;
+            it = continuationMarkers.erase(it);
+            continue;
+        }
+        if (it->position() < firstBlock.position()) {
+            ++continuationsBefore;
+        }
+        ++it;
+    }
+
+    QStringList addedLines;
+    int continuationsKept = 0;
+    for (QTextBlock block = firstBlock; block.isValid(); block = block.next()) {
+        MarkdownBlockData* data = static_cast<MarkdownBlockData*>(block.userData());
+        if (data && data->isRendered && data->isContinuation) {
+            ++continuationsKept;
+        } else {
+            addedLines.append(rawTextOfBlock(block));
+        }
+        if (block == lastBlock) {
+            break;
+        }
+    }
+
+    emit rawLinesChanged(firstBlock.blockNumber() - continuationsBefore,
+                         removedBlocks - continuationsRemoved - continuationsKept,
+                         addedLines);
+}
+
 void EditorWidget::toggleTheme()
 {
     // Delegate to ThemeManager for global theme cycling
@@ -564,42 +1022,51 @@ void EditorWidget::contextMenuEvent(QContextMenuEvent *event) {
 
     // --- Spell Check Context Menu Integration ---
     if (spellCheckEnabled && spellChecker && spellChecker->isInitialized()) {
-        QTextCursor cursor = cursorForPosition(event->pos());
-        cursor.select(QTextCursor::WordUnderCursor);
+        QTextCursor cursor = misspelledWordAt(cursorForPosition(event->pos()).position());
         QString selectedWord = cursor.selectedText();
 
-        if (!selectedWord.isEmpty() &&
-            QRegularExpression(QStringLiteral("^\\w+$")).match(selectedWord).hasMatch() &&
-            spellChecker->isWordMisspelled(selectedWord)) {
+        if (!selectedWord.isEmpty() && spellChecker->isWordMisspelled(selectedWord)) {
 
             QList<QAction*> spellActions;
-            QStringList suggestions = spellChecker->getSuggestions(selectedWord);
-
-            if (!suggestions.isEmpty()) {
-                for (const QString &suggestion : suggestions) {
-                    QAction *suggestionAction = new QAction(suggestion, menu);
-                    connect(suggestionAction, &QAction::triggered, [this, suggestion, cursor]() {
-                        QTextCursor editCursor = cursor;
-                        editCursor.beginEditBlock();
-                        editCursor.insertText(suggestion);
-                        editCursor.endEditBlock();
-                        QTimer::singleShot(0, this, &EditorWidget::checkSpelling);
-                    });
-                    spellActions.append(suggestionAction);
-                }
+            QStringList suggestions;
+
+            if (spellChecker->cachedSuggestions(selectedWord, &suggestions)) {
+                spellActions = createSuggestionActions(suggestions, cursor, menu);
             } else {
-                QAction *noSuggestionsAction = new QAction(tr("No suggestions"), menu);
-                noSuggestionsAction->setEnabled(false);
-                spellActions.append(noSuggestionsAction);
+                // Hunspell suggestions can take hundreds of milliseconds, so the menu
+                // opens immediately and the placeholder is swapped out when they arrive.
+                QAction *loadingAction = new QAction(tr("Loading suggestions..."), menu);
+                loadingAction->setEnabled(false);
+                spellActions.append(loadingAction);
+
+                auto *watcher = new QFutureWatcher<QStringList>(menu);
+                connect(watcher, &QFutureWatcher<QStringList>::finished, menu,
+                        [this, watcher, loadingAction, cursor, menu]() {
+                    if (watcher->isCanceled() || watcher->resultCount() == 0) {
+                        return;
+                    }
+                    menu->insertActions(loadingAction, createSuggestionActions(watcher->result(), cursor, menu));
+                    menu->removeAction(loadingAction);
+                    loadingAction->deleteLater();
+                });
+                connect(menu, &QMenu::aboutToHide, watcher, [watcher]() { watcher->cancel(); });
+                watcher->setFuture(spellChecker->requestSuggestions(selectedWord));
             }
 
             QAction *addWordAction = new QAction(tr("Add to Dictionary"), menu);
             connect(addWordAction, &QAction::triggered, [this, selectedWord]() {
                 spellChecker->addWord(selectedWord);
-                QTimer::singleShot(0, this, &EditorWidget::checkSpelling);
             });
             spellActions.append(addWordAction);
 
+            if (spellChecker->hasWorkspaceDictionary()) {
+                QAction *addWorkspaceWordAction = new QAction(tr("Add to Workspace Dictionary"), menu);
+                connect(addWorkspaceWordAction, &QAction::triggered, [this, selectedWord]() {
+                    spellChecker->addWordToWorkspace(selectedWord);
+                });
+                spellActions.append(addWorkspaceWordAction);
+            }
+
             // --- Insert Actions and Separators ---
             // 1. Determine the insertion point: before the first original action
             QAction *originalFirstAction = nullptr;
@@ -775,7 +1242,9 @@ void EditorWidget::setSpellCheckEnabled(bool enabled)
         // If enabling, perform an immediate check
         checkSpelling();
     } else {
-        // If disabling, clear existing highlights
+        // If disabling, drop pending work and clear existing highlights
+        spellSliceTimer->stop();
+        spellPendingBlocks = 0;
         QTextCursor cursor(document());
         cursor.select(QTextCursor::Document);
         QTextCharFormat format;
@@ -796,6 +1265,13 @@ void EditorWidget::setSpellCheckLanguage(const QString &language)
     }
 }
 
+void EditorWidget::setWorkspacePath(const QString &rootPath)
+{
+    if (spellChecker) {
+        spellChecker->setWorkspacePath(rootPath);
+    }
+}
+
 bool EditorWidget::isSpellCheckEnabled() const
 {
     return spellCheckEnabled;
@@ -810,51 +1286,257 @@ void EditorWidget::checkSpelling()
     highlightMisspelledWords();
 }
 
+QList<QAction*> EditorWidget::createSuggestionActions(const QStringList &suggestions,
+                                                      const QTextCursor &cursor, QMenu *menu)
+{
+    QList<QAction*> actions;
+    for (const QString &suggestion : suggestions) {
+        QAction *suggestionAction = new QAction(suggestion, menu);
+        connect(suggestionAction, &QAction::triggered, [this, suggestion, cursor]() {
+            QTextCursor editCursor = cursor;
+            editCursor.beginEditBlock();
+            editCursor.insertText(suggestion);
+            editCursor.endEditBlock();
+            QTimer::singleShot(0, this, &EditorWidget::checkSpelling);
+        });
+        actions.append(suggestionAction);
+    }
+
+    if (actions.isEmpty()) {
+        QAction *noSuggestionsAction = new QAction(tr("No suggestions"), menu);
+        noSuggestionsAction->setEnabled(false);
+        actions.append(noSuggestionsAction);
+    }
+    return actions;
+}
+
 void EditorWidget::highlightMisspelledWords()
 {
-    bool wasModified = document()->isModified(); // Save state
+    // Starts a new pass. Fence state depends on every preceding line, so it is
+    // resolved up front from the raw text, which is cheap next to spell checks;
+    // blocks can then be checked in any order.
+    const int blockCount = document()->blockCount();
+    spellCheckedBlocks.fill(false, blockCount);
+    spellFencedBlocks.fill(false, blockCount);
+    spellPendingBlocks = blockCount;
+    spellScanBlock = 0;
+
+    SpellTokenizer::CodeFence fence;
+    int blockNumber = 0;
+    for (QTextBlock block = document()->begin(); block.isValid(); block = block.next(), ++blockNumber) {
+        MarkdownBlockData *data = static_cast<MarkdownBlockData*>(block.userData());
+        const QString raw = (data && data->isRendered) ? data->rawMarkdown : block.text();
+        if (SpellTokenizer::advanceCodeFence(raw, fence) || fence.length > 0) {
+            spellFencedBlocks.setBit(blockNumber);
+        }
+    }
 
-    // Block modificationChanged signal to prevent false "document modified" triggers
-    // This prevents the spell checker from triggering the asterisk after save
+    // Underlines on screen are correct before the next paint; the rest of the
+    // document follows in background slices.
+    checkVisibleBlocks();
+    if (spellPendingBlocks > 0) {
+        spellSliceTimer->start();
+    }
+}
+
+void EditorWidget::restartSpellPass()
+{
+    // Blocks were added or removed since the pass started. Edits schedule a
+    // fresh pass themselves, but rendering or revealing a horizontal rule
+    // splits and merges blocks with signals blocked, so nothing else would.
+    spellPendingBlocks = 0;
+    spellSliceTimer->stop();
+    spellCheckTimer->start();
+}
+
+void EditorWidget::checkVisibleBlocks()
+{
+    if (spellPendingBlocks <= 0) {
+        return;
+    }
+    if (spellCheckedBlocks.size() != document()->blockCount()) {
+        restartSpellPass();
+        return;
+    }
+
+    const int first = cursorForPosition(QPoint(0, 0)).blockNumber();
+    const int last = cursorForPosition(QPoint(viewport()->width() - 1, viewport()->height() - 1)).blockNumber();
+
+    // Misspelled words on screen are collected, nearest to the cursor first, so
+    // their suggestions can be precomputed while the editor is idle.
+    QVector<QPair<int, QString>> flagged;
+
+    bool wasModified = document()->isModified();
+    blockSignals(true);
+    document()->blockSignals(true);
+    for (QTextBlock block = document()->findBlockByNumber(first);
+         block.isValid() && block.blockNumber() <= last; block = block.next()) {
+        checkSpellingInBlock(block, &flagged);
+    }
+    document()->blockSignals(false);
+    blockSignals(false);
+    document()->setModified(wasModified);
+
+    if (flagged.isEmpty()) {
+        return;
+    }
+
+    const int cursorPosition = textCursor().position();
+    std::stable_sort(flagged.begin(), flagged.end(),
+                     [cursorPosition](const QPair<int, QString> &a, const QPair<int, QString> &b) {
+                         return std::abs(a.first - cursorPosition) < std::abs(b.first - cursorPosition);
+                     });
+    flaggedWords.clear();
+    QSet<QString> seen;
+    for (const QPair<int, QString> &entry : std::as_const(flagged)) {
+        if (!seen.contains(entry.second)) {
+            seen.insert(entry.second);
+            flaggedWords.append(entry.second);
+        }
+    }
+    suggestionPrecomputeTimer->start();
+}
+
+void EditorWidget::continueSpellPass()
+{
+    if (spellPendingBlocks <= 0 || !spellCheckEnabled || !spellChecker) {
+        return;
+    }
+    if (spellCheckedBlocks.size() != document()->blockCount()) {
+        restartSpellPass();
+        return;
+    }
+
+    // Each slice gets a few milliseconds so typing and scrolling stay responsive.
+    QElapsedTimer budget;
+    budget.start();
+
+    bool wasModified = document()->isModified();
     blockSignals(true);
     document()->blockSignals(true);
+    QTextBlock block = document()->findBlockByNumber(spellScanBlock);
+    while (block.isValid() && budget.elapsed() < SpellSliceBudgetMs) {
+        if (!spellCheckedBlocks.testBit(block.blockNumber())) {
+            checkSpellingInBlock(block, nullptr);
+        }
+        block = block.next();
+    }
+    document()->blockSignals(false);
+    blockSignals(false);
+    document()->setModified(wasModified);
+
+    spellScanBlock = block.isValid() ? block.blockNumber() : document()->blockCount();
+    if (spellPendingBlocks > 0 && spellScanBlock < document()->blockCount()) {
+        spellSliceTimer->start();
+    }
+}
+
+void EditorWidget::checkSpellingInBlock(const QTextBlock &block, QVector<QPair<int, QString>> *flagged)
+{
+    const int blockNumber = block.blockNumber();
+    if (spellCheckedBlocks.testBit(blockNumber)) {
+        return;
+    }
+    spellCheckedBlocks.setBit(blockNumber);
+    --spellPendingBlocks;
 
     // --- Clear Previous Highlights ---
-    QTextCursor clearCursor(document());
-    clearCursor.select(QTextCursor::Document);
+    QTextCursor blockCursor(block);
+    blockCursor.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
     QTextCharFormat clearFormat;
     clearFormat.setUnderlineStyle(QTextCharFormat::NoUnderline);
-    clearCursor.mergeCharFormat(clearFormat);
+    blockCursor.mergeCharFormat(clearFormat);
+
+    // Only prose is checked: fenced code blocks are skipped entirely and the
+    // tokenizer drops inline code, URLs, link targets, HTML and identifiers.
+    if (spellFencedBlocks.testBit(blockNumber)) {
+        return;
+    }
 
     // --- Define Highlight Format for Misspelled Words ---
     QTextCharFormat misspelledFormat;
     misspelledFormat.setUnderlineStyle(QTextCharFormat::SpellCheckUnderline);
     misspelledFormat.setUnderlineColor(QColor(Qt::red)); // Standard red wavy underline
 
-    // --- Find and Highlight Misspelled Words ---
-    QRegularExpression wordRegex(QStringLiteral("\\b(\\w+)\\b"));
-    QString documentText = document()->toPlainText();
-
-    QRegularExpressionMatchIterator matchIterator = wordRegex.globalMatch(documentText);
-
-    while (matchIterator.hasNext()) {
-        QRegularExpressionMatch match = matchIterator.next();
-        QString word = match.captured(1);
-
+    const QString text = block.text();
+    const QVector<SpellToken> tokens = spellTokensForBlock(block);
+    for (const SpellToken &token : tokens) {
+        const QString word = text.mid(token.start, token.length);
         if (spellChecker->isWordMisspelled(word)) {
             QTextCursor wordCursor(document());
-            int startPos = match.capturedStart(1);
-            int length = match.capturedLength(1);
-
+            int startPos = block.position() + token.start;
             wordCursor.setPosition(startPos);
-            wordCursor.setPosition(startPos + length, QTextCursor::KeepAnchor);
+            wordCursor.setPosition(startPos + token.length, QTextCursor::KeepAnchor);
             wordCursor.mergeCharFormat(misspelledFormat);
+            if (flagged) {
+                flagged->append(qMakePair(startPos, word));
+            }
         }
     }
+}
 
-    // Restore signal blocking state
-    document()->blockSignals(false);
-    blockSignals(false);
+QVector<SpellToken> EditorWidget::spellTokensForBlock(const QTextBlock &block) const
+{
+    MarkdownBlockData *data = static_cast<MarkdownBlockData*>(block.userData());
+    if (!data || !data->isRendered) {
+        return SpellTokenizer::tokenizeMarkdownLine(block.text());
+    }
 
-    document()->setModified(wasModified); // Restore state
+    // Rendered blocks no longer contain Markdown syntax; drop words that fall
+    // inside inline code or links, which the renderer marks in the char format.
+    QVector<SpellToken> tokens = SpellTokenizer::tokenizeProse(block.text());
+    QVector<QPair<int, int>> skipped;
+    for (QTextBlock::iterator it = block.begin(); !it.atEnd(); ++it) {
+        QTextFragment fragment = it.fragment();
+        if (!fragment.isValid()) continue;
+        QTextCharFormat format = fragment.charFormat();
+        if (format.isAnchor() || format.fontFixedPitch()) {
+            int start = fragment.position() - block.position();
+            skipped.append(qMakePair(start, start + fragment.length()));
+        }
+    }
+    if (skipped.isEmpty()) {
+        return tokens;
+    }
+
+    QVector<SpellToken> prose;
+    prose.reserve(tokens.size());
+    for (const SpellToken &token : std::as_const(tokens)) {
+        bool overlaps = false;
+        for (const QPair<int, int> &range : std::as_const(skipped)) {
+            if (token.start < range.second && token.end() > range.first) {
+                overlaps = true;
+                break;
+            }
+        }
+        if (!overlaps) {
+            prose.append(token);
+        }
+    }
+    return prose;
+}
+
+QTextCursor EditorWidget::misspelledWordAt(int position) const
+{
+    QTextBlock block = document()->findBlock(position);
+    if (!block.isValid()) {
+        return QTextCursor();
+    }
+
+    SpellToken token = SpellTokenizer::tokenAt(spellTokensForBlock(block), position - block.position());
+    if (!token.isValid()) {
+        return QTextCursor();
+    }
+
+    QTextCursor cursor(document());
+    cursor.setPosition(block.position() + token.start);
+    cursor.setPosition(block.position() + token.end(), QTextCursor::KeepAnchor);
+
+    // The spell pass is the source of truth: only underlined words are offered corrections.
+    QTextCursor probe(document());
+    probe.setPosition(block.position() + token.start + 1);
+    if (probe.charFormat().underlineStyle() != QTextCharFormat::SpellCheckUnderline) {
+        return QTextCursor();
+    }
+    return cursor;
 }
@@ -1,156 +1,171 @@
 // filemanager.cpp
 #include "filemanager.h"
 #include "editorwidget.h" // Need the full declaration for document()
+#include "documentloader.h"
+#include "textcodec.h"
+#include "htmlexporter.h"
+#include "pdfexporter.h"
+#include "thememanager.h"
 #include <QFile>
-#include <QTextStream>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtConcurrent/QtConcurrentRun>
 #include <QMessageBox>
-#include <QTextDocument>
-#include <QPrinter>
-#include <QPrintDialog> 
 #include <QFileDialog>
 #include <QDir>
 #include <QApplication>
-#include <cmark.h>
 
-FileManager::FileManager(QObject *parent) : QObject(parent)
-{
+namespace {
 
+// Pages take the colours of the current theme; ThemeManager is only read here, on the GUI thread
+PdfExporter::Style themePdfStyle()
+{
+    const ThemeManager *theme = ThemeManager::instance();
+    PdfExporter::Style style;
+    style.page = theme->backgroundColor();
+    style.text = theme->textColor();
+    style.heading = theme->headingColor();
+    style.link = theme->linkColor();
+    style.image = theme->imageColor();
+    style.codeText = theme->codeTextColor();
+    style.codeBackground = theme->codeBackgroundColor();
+    style.quoteText = theme->blockquoteTextColor();
+    style.tableHeaderBackground = theme->tableHeaderBackgroundColor();
+    style.border = theme->borderColor();
+    style.rule = theme->horizontalRuleColor();
+    return style;
 }
 
-QString FileManager::convertMarkdownToHtml(const QString &markdown)
+} // namespace
+
+FileManager::FileManager(QObject *parent)
+    : QObject(parent), pdfLayoutCache(std::make_shared<PdfExporter::LayoutCache>())
 {
-    QByteArray utf8 = markdown.toUtf8();
-    int options = CMARK_OPT_DEFAULT | CMARK_OPT_SMART | CMARK_OPT_VALIDATE_UTF8; // Enable smart quotes and UTF-8 validation
-    char *html = cmark_markdown_to_html(utf8.constData(), utf8.size(), options);
-    if (!html) {
-        return QString();
-    }
-    QString result = QString::fromUtf8(html);
-    free(html);
-    return result;
+
 }
 
-bool FileManager::loadFile(const QString &fileName, EditorWidget *editor)
+DocumentLoader *FileManager::loadFile(const QString &fileName, EditorWidget *editor)
 {
-    QFile file(fileName);
-    if (!file.open(QFile::ReadOnly | QFile::Text)) {
+    // The loader maps the file and fills the editor over several event-loop
+    // turns, so large files show their first screen immediately.
+    DocumentLoader *loader = new DocumentLoader(fileName, editor);
+    QString errorString;
+    if (!loader->start(&errorString)) {
+        delete loader;
         QMessageBox::warning(nullptr, tr("Scriber"),
                              tr("Cannot read file %1:\n%2.")
-                             .arg(QDir::toNativeSeparators(fileName), file.errorString()));
-        return false;
+                             .arg(QDir::toNativeSeparators(fileName), errorString));
+        return nullptr;
     }
 
-    QTextStream in(&file);
-#ifndef QT_NO_CURSOR
-    QApplication::setOverrideCursor(Qt::WaitCursor);
-#endif
-    editor->setPlainText(in.readAll());
-    editor->renderAllBlocks();
-#ifndef QT_NO_CURSOR
-    QApplication::restoreOverrideCursor();
-#endif
-
-    // editor->setCurrentFile(fileName); // If EditorWidget had this method
     // MainWindow should handle setting currentFile
-    return true;
+    return loader;
 }
 
-bool FileManager::saveFile(const QString &fileName, EditorWidget *editor)
+QFuture<FileManager::SaveResult> FileManager::saveFileAsync(const QString &fileName, EditorWidget *editor)
 {
-    QFile file(fileName);
-    if (!file.open(QFile::WriteOnly | QFile::Text)) {
-        QMessageBox::warning(nullptr, tr("Scriber"),
-                             tr("Cannot write file %1:\n%2.")
-                             .arg(QDir::toNativeSeparators(fileName), file.errorString()));
-        return false;
+    // Only the snapshot is taken on the GUI thread; encoding and disk I/O,
+    // which can stall for seconds on slow or full disks, run on the pool.
+    const QString markdown = editor->getRawMarkdown();
+    const TextCodec::FileFormat format = editor->fileFormat();
+    return QtConcurrent::run(&FileManager::writeFileAtomically, fileName, markdown, format);
+}
+
+FileManager::SaveResult FileManager::writeFileAtomically(const QString &fileName, const QString &markdown,
+                                                         const TextCodec::FileFormat &format)
+{
+    SaveResult result;
+
+    // QSaveFile writes a temporary file next to the target, fsyncs it on
+    // commit and renames it over the original, so a crash or a full disk
+    // leaves the previous version intact.
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        result.errorString = file.errorString();
+        return result;
     }
 
-    QTextStream out(&file);
-#ifndef QT_NO_CURSOR
-    QApplication::setOverrideCursor(Qt::WaitCursor);
-#endif
-    out << editor->getRawMarkdown(); // Save raw Markdown
-#ifndef QT_NO_CURSOR
-    QApplication::restoreOverrideCursor();
-#endif
+    // Save raw Markdown with the BOM and line endings the file was loaded with
+    const QByteArray bytes = TextCodec::encode(markdown, format);
+    if (file.write(bytes) != bytes.size()) {
+        result.errorString = file.errorString();
+        file.cancelWriting();
+        return result;
+    }
 
-    editor->document()->setModified(false);
-    // MainWindow should handle setting currentFile
-    return true;
+    if (!file.commit()) {
+        result.errorString = file.errorString();
+        return result;
+    }
+
+    // What our write looks like on disk, so later changes by others stand out
+    const QFileInfo info(fileName);
+    result.size = info.size();
+    result.modified = info.lastModified();
+    result.ok = true;
+    return result;
 }
 
-bool FileManager::exportToHtml(const QString &fileName, EditorWidget *editor)
+QFuture<FileManager::ReloadResult> FileManager::diffWithDiskAsync(const QString &fileName, EditorWidget *editor)
 {
-    QFile file(fileName);
-    if (!file.open(QFile::WriteOnly | QFile::Text)) {
-        QMessageBox::warning(nullptr, tr("Scriber"),
-                             tr("Cannot write file %1:\n%2.")
-                             .arg(QDir::toNativeSeparators(fileName), file.errorString()));
-        return false;
-    }
+    const QString markdown = editor->getRawMarkdown();
+    return QtConcurrent::run([fileName, markdown]() {
+        ReloadResult result;
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            result.errorString = file.errorString();
+            return result;
+        }
+
+        QByteArray buffer;
+        const char *data = nullptr;
+        if (file.size() > 0) {
+            data = reinterpret_cast<const char *>(file.map(0, file.size()));
+        }
+        if (!data) {
+            buffer = file.readAll();
+            data = buffer.constData();
+        }
+        const qint64 size = data == buffer.constData() ? buffer.size() : file.size();
 
-    QTextStream out(&file);
-#ifndef QT_NO_CURSOR
-    QApplication::setOverrideCursor(Qt::WaitCursor);
-#endif
-    
-    QString htmlContent = convertMarkdownToHtml(editor->getRawMarkdown());
-    
-    // Wrap in a basic HTML structure
-    out << "<!DOCTYPE html>\n";
-    out << "<html>\n<head>\n";
-    out << "<meta charset=\"utf-8\">\n";
-    out << "<title>" << QFileInfo(fileName).baseName() << "</title>\n";
-    out << "<style>\n";
-    out << "body { font-family: sans-serif; line-height: 1.6; max-width: 800px; margin: 0 auto; padding: 2rem; }\n";
-    out << "pre { background-color: #f4f4f4; padding: 1em; border-radius: 4px; overflow-x: auto; }\n";
-    out << "code { background-color: #f4f4f4; padding: 0.2em 0.4em; border-radius: 3px; }\n";
-    out << "blockquote { border-left: 4px solid #ddd; margin: 0; padding-left: 1em; color: #666; }\n";
-    out << "table { border-collapse: collapse; width: 100%; margin: 1em 0; }\n";
-    out << "th, td { border: 1px solid #ddd; padding: 8px; text-align: left; }\n";
-    out << "th { background-color: #f4f4f4; }\n";
-    out << "</style>\n";
-    out << "</head>\n<body>\n";
-    out << htmlContent;
-    out << "\n</body>\n</html>";
-
-#ifndef QT_NO_CURSOR
-    QApplication::restoreOverrideCursor();
-#endif
-     return true;
+        const QString text = TextCodec::decode(QByteArrayView(data, size), &result.format);
+        result.lines = text.split(QLatin1Char('\n'));
+        result.hunks = LineDiff::diff(markdown.split(QLatin1Char('\n')), result.lines);
+        result.ok = true;
+        return result;
+    });
+}
+
+QFuture<HtmlExporter::Result> FileManager::exportToHtmlAsync(const QString &fileName, EditorWidget *editor)
+{
+    // The AST is rendered straight into the file on the pool; the snapshot
+    // is the only copy of the document made on the GUI thread.
+    const QString markdown = editor->getRawMarkdown();
+    return QtConcurrent::run([fileName, markdown](QPromise<HtmlExporter::Result> &promise) {
+        promise.setProgressRange(0, 1000);
+        HtmlExporter::Result result = HtmlExporter::exportToFile(markdown, fileName,
+            [&promise](qint64 done, qint64 total) {
+                promise.setProgressValue(total > 0 ? int(done * 1000 / total) : 0);
+                return !promise.isCanceled();
+            });
+        promise.addResult(result);
+    });
 }
 
-bool FileManager::exportToPdf(const QString &fileName, EditorWidget *editor)
+QFuture<PdfExporter::Result> FileManager::exportToPdfAsync(const QString &fileName, EditorWidget *editor)
 {
-    QPrinter printer(QPrinter::HighResolution);
-    printer.setOutputFormat(QPrinter::PdfFormat);
-    printer.setOutputFileName(fileName);
-    // Set default PDF options if needed
-    // printer.setPageSize(QPageSize(QPageSize::A4));
-    // printer.setPageOrientation(QPageLayout::Portrait);
-
-#ifndef QT_NO_CURSOR
-    QApplication::setOverrideCursor(Qt::WaitCursor);
-#endif
-    
-    QString htmlContent = convertMarkdownToHtml(editor->getRawMarkdown());
-    
-    // Use a temporary QTextDocument to render the HTML for printing
-    QTextDocument doc;
-    // Add some basic styling for the PDF rendering
-    QString styledHtml = QString(
-        "<html><head><style>"
-        "body { font-family: sans-serif; }"
-        "pre { background-color: #f4f4f4; padding: 10px; }"
-        "code { background-color: #f4f4f4; }"
-        "blockquote { border-left: 4px solid #ddd; padding-left: 10px; color: #666; }"
-        "</style></head><body>%1</body></html>").arg(htmlContent);
-        
-    doc.setHtml(styledHtml);
-    doc.print(&printer);
-
-#ifndef QT_NO_CURSOR
-    QApplication::restoreOverrideCursor();
-#endif
-    return true;
+    // Blocks laid out by earlier exports are shared through the cache, so
+    // exporting an unchanged document again mostly replays recorded pages.
+    const QString markdown = editor->getRawMarkdown();
+    const PdfExporter::Style style = themePdfStyle();
+    std::shared_ptr<PdfExporter::LayoutCache> cache = pdfLayoutCache;
+    return QtConcurrent::run([fileName, markdown, style, cache](QPromise<PdfExporter::Result> &promise) {
+        promise.setProgressRange(0, 1000);
+        PdfExporter::Result result = PdfExporter::exportToFile(markdown, fileName, style, cache.get(),
+            [&promise](qint64 done, qint64 total) {
+                promise.setProgressValue(total > 0 ? int(done * 1000 / total) : 0);
+                return !promise.isCanceled();
+            });
+        promise.addResult(result);
+    });
 }
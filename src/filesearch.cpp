@@ -0,0 +1,227 @@
+#include "filesearch.h"
+#include "textcodec.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QMutex>
+#include <QPromise>
+#include <QRegularExpression>
+#include <QtConcurrent>
+
+namespace {
+
+// Matches reported per file; the rest are only counted as truncated
+const int MaxHitsPerFile = 1000;
+
+// Characters of a long line shown around a match, and before it
+const int PreviewLength = 160;
+const int PreviewContext = 40;
+
+// Globs without a slash match names; the others match paths relative to the root
+struct Glob {
+    QRegularExpression expression;
+    bool matchesPath = false;
+};
+
+QVector<Glob> compileGlobs(const QStringList &globs)
+{
+    QVector<Glob> compiled;
+    for (const QString &glob : globs) {
+        QString pattern = glob;
+        if (pattern.endsWith(QLatin1Char('/'))) {
+            pattern.chop(1); // "build/" names a folder
+        }
+        compiled.append({ QRegularExpression(QRegularExpression::wildcardToRegularExpression(pattern),
+                                             QRegularExpression::CaseInsensitiveOption),
+                          pattern.contains(QLatin1Char('/')) });
+    }
+    return compiled;
+}
+
+bool matchesAny(const QVector<Glob> &globs, const QString &name, const QString &relativePath)
+{
+    for (const Glob &glob : globs) {
+        if (glob.expression.match(glob.matchesPath ? relativePath : name).hasMatch()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Everything a search needs, prepared once and shared read-only by the workers
+struct Prepared {
+    QDir root;
+    QString pattern;
+    FindEngine::Options options;
+    QRegularExpression expression; // For regular expression queries
+    QByteArray utf8Pattern;        // For the byte prefilter; empty when it does not apply
+    QVector<Glob> nameFilters;
+    QVector<Glob> includes;
+    QVector<Glob> excludes;
+
+    explicit Prepared(const FileSearch::Query &query)
+        : root(query.rootPath), pattern(query.pattern), options(query.options),
+          nameFilters(compileGlobs(query.nameFilters)), includes(compileGlobs(query.includeGlobs)),
+          excludes(compileGlobs(query.excludeGlobs))
+    {
+        if (options.regularExpression) {
+            expression = FindEngine::regularExpression(pattern, options);
+        } else if (options.caseSensitive) {
+            utf8Pattern = pattern.toUtf8();
+        }
+    }
+
+    bool isValid() const
+    {
+        return !pattern.isEmpty() && (!options.regularExpression || expression.isValid());
+    }
+};
+
+struct Listing {
+    QStringList folders;
+    QStringList files;
+};
+
+Listing listFolder(const QString &folder, const Prepared &prepared)
+{
+    Listing listing;
+    // Without QDir::Hidden, dot folders such as .git are skipped
+    QDirIterator it(folder, QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        const QString name = info.fileName();
+        const QString relativePath = prepared.root.relativeFilePath(info.filePath());
+        if (matchesAny(prepared.excludes, name, relativePath)) {
+            continue;
+        }
+        if (info.isDir()) {
+            if (!info.isSymLink()) { // Links could lead back up the tree
+                listing.folders.append(info.filePath());
+            }
+        } else if (matchesAny(prepared.nameFilters, name, relativePath)
+                   && (prepared.includes.isEmpty() || matchesAny(prepared.includes, name, relativePath))) {
+            listing.files.append(info.filePath());
+        }
+    }
+    return listing;
+}
+
+FileSearch::Hit makeHit(QStringView text, int line, qsizetype lineStart, const FindEngine::Match &match)
+{
+    qsizetype lineEnd = text.indexOf(QLatin1Char('\n'), match.start);
+    if (lineEnd < 0) {
+        lineEnd = text.size();
+    }
+    qsizetype from = lineStart;
+    if (lineEnd - lineStart > PreviewLength) {
+        from = qMax(lineStart, qsizetype(match.start) - PreviewContext);
+    }
+    const qsizetype to = qMin(lineEnd, from + PreviewLength);
+
+    FileSearch::Hit hit;
+    hit.line = line;
+    hit.column = int(match.start - lineStart);
+    hit.length = match.length;
+    hit.preview = text.sliced(from, to - from).toString();
+    hit.previewColumn = int(match.start - from);
+    return hit;
+}
+
+FileSearch::FileResult searchFile(const QString &filePath, const Prepared &prepared)
+{
+    FileSearch::FileResult result;
+    result.filePath = filePath;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        return result;
+    }
+    QByteArray contents;
+    QByteArrayView bytes;
+    if (const uchar *mapped = file.map(0, file.size())) {
+        bytes = QByteArrayView(mapped, file.size());
+    } else {
+        contents = file.readAll(); // Not mappable, e.g. on some network file systems
+        bytes = contents;
+    }
+
+    // Most files do not contain the query at all; finding that out needs no decoding
+    if (!prepared.utf8Pattern.isEmpty() && bytes.indexOf(prepared.utf8Pattern) < 0) {
+        return result;
+    }
+
+    TextCodec::FileFormat format;
+    const QString text = TextCodec::decode(bytes, &format);
+    const FindEngine::Matches matches = prepared.options.regularExpression
+        ? FindEngine::findIn(text, prepared.expression)
+        : FindEngine::findIn(text, prepared.pattern, prepared.options);
+
+    int line = 0;
+    qsizetype lineStart = 0;
+    for (const FindEngine::Match &match : matches) {
+        if (result.hits.size() == MaxHitsPerFile) {
+            result.truncated = true;
+            break;
+        }
+        for (qsizetype newline = text.indexOf(QLatin1Char('\n'), lineStart);
+             newline >= 0 && newline < match.start; newline = text.indexOf(QLatin1Char('\n'), lineStart)) {
+            ++line;
+            lineStart = newline + 1;
+        }
+        result.hits.append(makeHit(text, line, lineStart, match));
+    }
+    return result;
+}
+
+void run(QPromise<FileSearch::FileResult> &promise, const FileSearch::Query &query)
+{
+    const Prepared prepared(query);
+    if (!prepared.isValid() || !prepared.root.exists()) {
+        return;
+    }
+
+    QMutex resultMutex;
+    QStringList folders{ prepared.root.absolutePath() };
+    while (!folders.isEmpty() && !promise.isCanceled()) {
+        const QList<Listing> listings = QtConcurrent::blockingMapped<QList<Listing>>(
+            folders, [&prepared](const QString &folder) { return listFolder(folder, prepared); });
+        folders.clear();
+        QStringList files;
+        for (const Listing &listing : listings) {
+            folders += listing.folders;
+            files += listing.files;
+        }
+
+        QtConcurrent::blockingMap(files, [&](const QString &filePath) {
+            if (promise.isCanceled()) {
+                return;
+            }
+            FileSearch::FileResult result = searchFile(filePath, prepared);
+            if (!result.hits.isEmpty()) {
+                QMutexLocker locker(&resultMutex);
+                promise.addResult(std::move(result));
+            }
+        });
+    }
+}
+
+} // namespace
+
+namespace FileSearch
+{
+
+QFuture<FileResult> search(const Query &query)
+{
+    return QtConcurrent::run([query](QPromise<FileResult> &promise) {
+        run(promise, query);
+    });
+}
+
+QStringList parseGlobs(const QString &text)
+{
+    static const QRegularExpression separators(QStringLiteral("[,\\s]+"));
+    return text.split(separators, Qt::SkipEmptyParts);
+}
+
+}
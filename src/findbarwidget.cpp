@@ -4,22 +4,55 @@
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QKeyEvent>
-#include <QRegularExpression>
+#include <QScrollBar>
+#include <QTextBlock>
+#include <algorithm>
+
+namespace {
+
+// Quiet time after an edit before the open find bar searches the document again
+const int ResearchDelayMs = 300;
+
+} // namespace
 
 FindBarWidget::FindBarWidget(QWidget *parent)
     : QWidget(parent)
     , currentEditor(nullptr)
     , m_isFindBarVisible(false)
+    , searchRevision(0)
+    , searchComplete(true)
+    , currentMatch(-1)
+    , pendingStep(PendingStep::None)
+    , cursorBlockNumber(-1)
+    , invalidExpression(false)
+    , replacedCount(-1)
 {
     setObjectName("findBarWidget");
     createLayout();
 
+    searchWatcher = new QFutureWatcher<FindEngine::Matches>(this);
+    connect(searchWatcher, &QFutureWatcher<FindEngine::Matches>::resultsReadyAt,
+            this, &FindBarWidget::onSearchResultsReady);
+    connect(searchWatcher, &QFutureWatcher<FindEngine::Matches>::finished,
+            this, &FindBarWidget::onSearchFinished);
+
+    researchTimer = new QTimer(this);
+    researchTimer->setSingleShot(true);
+    researchTimer->setInterval(ResearchDelayMs);
+    connect(researchTimer, &QTimer::timeout, this, &FindBarWidget::startSearch);
+
     // Connect signals
     connect(findLineEdit, &QLineEdit::returnPressed, this, &FindBarWidget::onFindNext);
     connect(findNextButton, &QPushButton::clicked, this, &FindBarWidget::onFindNext);
     connect(findPreviousButton, &QPushButton::clicked, this, &FindBarWidget::onFindPrevious);
     connect(closeButton, &QPushButton::clicked, this, &FindBarWidget::onClose);
     connect(findLineEdit, &QLineEdit::textEdited, this, &FindBarWidget::onFindTextEdited);
+    connect(caseSensitiveCheckBox, &QCheckBox::toggled, this, &FindBarWidget::onFindTextEdited);
+    connect(wholeWordsCheckBox, &QCheckBox::toggled, this, &FindBarWidget::onFindTextEdited);
+    connect(regularExpressionCheckBox, &QCheckBox::toggled, this, &FindBarWidget::onFindTextEdited);
+    connect(replaceLineEdit, &QLineEdit::returnPressed, this, &FindBarWidget::onReplace);
+    connect(replaceButton, &QPushButton::clicked, this, &FindBarWidget::onReplace);
+    connect(replaceAllButton, &QPushButton::clicked, this, &FindBarWidget::onReplaceAll);
 
     // Apply theme colors
     applyThemeColors();
@@ -32,11 +65,37 @@ void FindBarWidget::applyThemeColors()
 
     // Update status label color using theme colors instead of hardcoded gray
     findStatusLabel->setStyleSheet(QString("QLabel { color: %1; }").arg(themeManager->textColor().name()));
+    refreshHighlights();
 }
 
 void FindBarWidget::setEditor(EditorWidget *editor)
 {
+    if (currentEditor == editor) {
+        return;
+    }
+
+    if (currentEditor) {
+        clearHighlights();
+        disconnect(currentEditor, nullptr, this, nullptr);
+        disconnect(currentEditor->verticalScrollBar(), nullptr, this, nullptr);
+        disconnect(currentEditor->horizontalScrollBar(), nullptr, this, nullptr);
+    }
     currentEditor = editor;
+    cursorBlockNumber = -1;
+    if (currentEditor) {
+        connect(currentEditor, &QTextEdit::textChanged, this, &FindBarWidget::onDocumentChanged);
+        connect(currentEditor, &QTextEdit::cursorPositionChanged, this, &FindBarWidget::onCursorMoved);
+        // Scrolling and resizing change the visible region
+        connect(currentEditor->verticalScrollBar(), &QScrollBar::valueChanged, this, &FindBarWidget::refreshHighlights);
+        connect(currentEditor->verticalScrollBar(), &QScrollBar::rangeChanged, this, &FindBarWidget::refreshHighlights);
+        connect(currentEditor->horizontalScrollBar(), &QScrollBar::valueChanged, this, &FindBarWidget::refreshHighlights);
+    }
+
+    if (m_isFindBarVisible) {
+        startSearch();
+    } else {
+        cancelSearch();
+    }
 }
 
 void FindBarWidget::showFindBar()
@@ -45,13 +104,25 @@ void FindBarWidget::showFindBar()
     m_isFindBarVisible = true;
     findLineEdit->setFocus();
     findLineEdit->selectAll();
+    startSearch();
     emit findBarHidden(); // Signal that focus changed
 }
 
+void FindBarWidget::showReplaceBar()
+{
+    showFindBar();
+    if (!findLineEdit->text().isEmpty()) {
+        replaceLineEdit->setFocus();
+        replaceLineEdit->selectAll();
+    }
+}
+
 void FindBarWidget::hideFindBar()
 {
     hide();
     m_isFindBarVisible = false;
+    cancelSearch();
+    clearHighlights();
     emit findBarHidden();
 }
 
@@ -67,99 +138,379 @@ void FindBarWidget::keyPressEvent(QKeyEvent *event)
 
 void FindBarWidget::onFindNext()
 {
-    if (!currentEditor) return;
-    
-    QString searchText = findLineEdit->text();
-    if (searchText.isEmpty()) {
-        updateFindStatus(false);
+    step(PendingStep::Next);
+}
+
+void FindBarWidget::onFindPrevious()
+{
+    step(PendingStep::Previous);
+}
+
+void FindBarWidget::onFindTextEdited()
+{
+    startSearch();
+    step(PendingStep::Nearest);
+}
+
+void FindBarWidget::onClose()
+{
+    hideFindBar();
+}
+
+void FindBarWidget::startSearch()
+{
+    const QString pattern = findLineEdit->text();
+    FindEngine::Options options;
+    options.caseSensitive = caseSensitiveCheckBox->isChecked();
+    options.wholeWords = wholeWordsCheckBox->isChecked();
+    options.regularExpression = regularExpressionCheckBox->isChecked();
+
+    // While the document is unchanged the snapshot is reused, and a query
+    // extending the previous one only checks the previous matches
+    const bool sameText = matchesAreCurrent();
+    const QString snapshot = sameText ? searchedSnapshot : QString();
+    const QVector<int> lineStarts = sameText ? searchedLineStarts : QVector<int>();
+    const bool sameOptions = options.caseSensitive == searchedOptions.caseSensitive
+                             && options.wholeWords == searchedOptions.wholeWords
+                             && options.regularExpression == searchedOptions.regularExpression;
+    const int offset = sameText && searchComplete && sameOptions
+                       ? FindEngine::narrowingOffset(searchedPattern, pattern, options) : -1;
+    const FindEngine::Matches candidates = offset >= 0 ? matches : FindEngine::Matches();
+
+    cancelSearch();
+    invalidExpression = options.regularExpression && !FindEngine::regularExpression(pattern, options).isValid();
+    if (!currentEditor || pattern.isEmpty() || invalidExpression) {
+        refreshHighlights();
+        updateFindStatus();
         return;
     }
-    
-    Qt::CaseSensitivity caseSensitivity = caseSensitiveCheckBox->isChecked() 
-        ? Qt::CaseSensitive : Qt::CaseInsensitive;
-    bool wholeWords = wholeWordsCheckBox->isChecked();
-    
-    QTextDocument::FindFlags flags;
-    if (caseSensitivity == Qt::CaseSensitive)
-        flags |= QTextDocument::FindCaseSensitively;
-    
-    bool found = false;
-    QTextCursor cursor;
-    
-    if (wholeWords) {
-        QRegularExpression regex("\\b" + QRegularExpression::escape(searchText) + "\\b",
-            caseSensitivity == Qt::CaseSensitive 
-                ? QRegularExpression::NoPatternOption 
-                : QRegularExpression::CaseInsensitiveOption);
-        cursor = currentEditor->document()->find(regex, currentEditor->textCursor());
-        found = !cursor.isNull();
+
+    searchedEditor = currentEditor;
+    if (sameText) {
+        searchedSnapshot = snapshot;
+        searchedLineStarts = lineStarts;
     } else {
-        found = currentEditor->find(searchText, flags);
-        cursor = currentEditor->textCursor();
+        // The Markdown source, so matches do not depend on which blocks are rendered
+        searchRevision = currentEditor->contentRevision();
+        searchedSnapshot = currentEditor->getRawMarkdown();
+        searchedLineStarts = FindEngine::lineStarts(searchedSnapshot);
     }
-    
-    if (found) {
-        currentEditor->setTextCursor(cursor);
-        currentEditor->ensureCursorVisible();
+    searchedPattern = pattern;
+    searchedOptions = options;
+    searchComplete = false;
+    searchWatcher->setFuture(offset >= 0
+        ? FindEngine::narrow(searchedSnapshot, candidates, offset, pattern, options)
+        : FindEngine::findAll(searchedSnapshot, pattern, options));
+    updateFindStatus();
+}
+
+void FindBarWidget::cancelSearch()
+{
+    researchTimer->stop();
+    searchWatcher->cancel();
+    // A new future, even an empty one, drops the results still queued from the old search
+    searchWatcher->setFuture(QFuture<FindEngine::Matches>());
+    matches.clear();
+    searchedEditor = nullptr;
+    searchedSnapshot.clear();
+    searchedLineStarts.clear();
+    searchComplete = true;
+    currentMatch = -1;
+    pendingStep = PendingStep::None;
+}
+
+bool FindBarWidget::matchesAreCurrent() const
+{
+    return currentEditor && searchedEditor == currentEditor && searchRevision == currentEditor->contentRevision();
+}
+
+void FindBarWidget::onSearchResultsReady(int begin, int end)
+{
+    for (int i = begin; i < end; ++i) {
+        matches += searchWatcher->resultAt(i);
     }
-    
-    updateFindStatus(found);
+    resolvePendingStep();
+    refreshHighlights();
+    updateFindStatus();
 }
 
-void FindBarWidget::onFindPrevious()
+void FindBarWidget::onSearchFinished()
 {
-    if (!currentEditor) return;
-    
-    QString searchText = findLineEdit->text();
-    if (searchText.isEmpty()) {
-        updateFindStatus(false);
+    if (searchWatcher->isCanceled()) {
         return;
     }
-    
-    Qt::CaseSensitivity caseSensitivity = caseSensitiveCheckBox->isChecked() 
-        ? Qt::CaseSensitive : Qt::CaseInsensitive;
-    bool wholeWords = wholeWordsCheckBox->isChecked();
-    
-    QTextDocument::FindFlags flags = QTextDocument::FindBackward;
-    if (caseSensitivity == Qt::CaseSensitive)
-        flags |= QTextDocument::FindCaseSensitively;
-    
-    bool found = false;
-    
-    if (wholeWords) {
-        QRegularExpression regex("\\b" + QRegularExpression::escape(searchText) + "\\b",
-            caseSensitivity == Qt::CaseSensitive 
-                ? QRegularExpression::NoPatternOption 
-                : QRegularExpression::CaseInsensitiveOption);
-        QTextCursor cursor = currentEditor->textCursor();
-        cursor = currentEditor->document()->find(regex, cursor, flags);
-        found = !cursor.isNull();
-        if (found) {
-            currentEditor->setTextCursor(cursor);
+    searchComplete = true;
+    resolvePendingStep();
+    refreshHighlights();
+    updateFindStatus();
+}
+
+void FindBarWidget::onDocumentChanged()
+{
+    // Changes that keep the content revision are formatting or rendering, which move no match
+    if (m_isFindBarVisible && !findLineEdit->text().isEmpty() && !matchesAreCurrent()) {
+        researchTimer->start();
+    }
+}
+
+void FindBarWidget::onCursorMoved()
+{
+    // Moving to another block renders the one left and reveals the one entered
+    const int blockNumber = currentEditor->textCursor().blockNumber();
+    if (blockNumber != cursorBlockNumber) {
+        cursorBlockNumber = blockNumber;
+        refreshHighlights();
+    }
+}
+
+void FindBarWidget::onReplace()
+{
+    if (!currentEditor || !matchesAreCurrent() || currentMatch < 0 || currentMatch >= matches.size()) {
+        onFindNext(); // Select a match to replace first
+        return;
+    }
+
+    // Only the match the last step selected is replaced, and only while it is still selected
+    const FindEngine::Match match = matches[currentMatch];
+    QTextCursor cursor = currentEditor->textCursor();
+    if (rawOffsetOf(cursor.selectionStart()) != match.start
+        || rawOffsetOf(cursor.selectionEnd()) != match.start + match.length) {
+        onFindNext();
+        return;
+    }
+    const FindEngine::Replacer replacer(searchedPattern, replaceLineEdit->text(), searchedOptions);
+    cursor.insertText(replacer.replacementFor(searchedSnapshot, match));
+    currentEditor->setTextCursor(cursor);
+
+    // The edit outdated the matches; the next one is found in the new text
+    step(PendingStep::Next);
+}
+
+void FindBarWidget::onReplaceAll()
+{
+    step(PendingStep::ReplaceAll);
+}
+
+void FindBarWidget::replaceAll()
+{
+    if (searchedLineStarts.isEmpty()) {
+        return; // No snapshot to map the matches to lines
+    }
+
+    // Every edit is made on the snapshot's lines; the editor applies them as one undo step
+    const FindEngine::Replacer replacer(searchedPattern, replaceLineEdit->text(), searchedOptions);
+    const QStringView snapshot(searchedSnapshot);
+    QVector<int> lines;
+    QStringList texts;
+    int line = 0;
+    for (int i = 0; i < matches.size();) {
+        while (line + 1 < searchedLineStarts.size() && searchedLineStarts[line + 1] <= matches[i].start) {
+            ++line;
         }
-    } else {
-        found = currentEditor->find(searchText, flags);
+        const int lineStart = searchedLineStarts[line];
+        const int lineEnd = line + 1 < searchedLineStarts.size() ? searchedLineStarts[line + 1] - 1
+                                                                  : int(searchedSnapshot.size());
+        QString text;
+        int copied = lineStart;
+        for (; i < matches.size() && matches[i].start <= lineEnd; ++i) {
+            text += snapshot.sliced(copied, matches[i].start - copied);
+            text += replacer.replacementFor(searchedSnapshot, matches[i]);
+            copied = matches[i].start + matches[i].length;
+        }
+        text += snapshot.sliced(copied, lineEnd - copied);
+        lines.append(line);
+        texts.append(text);
     }
-    
-    updateFindStatus(found);
+
+    const int count = int(matches.size());
+    currentEditor->replaceRawLines(lines, texts);
+    startSearch();
+    replacedCount = count;
+    updateFindStatus();
 }
 
-void FindBarWidget::onFindTextEdited()
+void FindBarWidget::step(PendingStep direction)
 {
-    onFindNext();
+    replacedCount = -1;
+    if (!currentEditor || findLineEdit->text().isEmpty() || invalidExpression) {
+        updateFindStatus();
+        return;
+    }
+    if (!matchesAreCurrent()) {
+        startSearch();
+    }
+    pendingStep = direction;
+    resolvePendingStep();
 }
 
-void FindBarWidget::onClose()
+void FindBarWidget::resolvePendingStep()
 {
-    hideFindBar();
+    if (pendingStep == PendingStep::None || !matchesAreCurrent()) {
+        return;
+    }
+
+    if (pendingStep == PendingStep::ReplaceAll) {
+        if (searchComplete) {
+            pendingStep = PendingStep::None;
+            replaceAll();
+        }
+        return;
+    }
+
+    const QTextCursor cursor = currentEditor->textCursor();
+    int match = -1;
+    switch (pendingStep) {
+    case PendingStep::Next:
+    case PendingStep::Nearest: {
+        const int from = rawOffsetOf(pendingStep == PendingStep::Next ? cursor.selectionEnd() : cursor.selectionStart());
+        match = FindEngine::firstMatchFrom(matches, from);
+        if (match == matches.size()) {
+            if (!searchComplete) {
+                return; // The next match may still be found
+            }
+            match = matches.isEmpty() ? -1 : 0; // Wrap around
+        }
+        break;
+    }
+    case PendingStep::Previous: {
+        match = FindEngine::firstMatchFrom(matches, rawOffsetOf(cursor.selectionStart())) - 1;
+        if (match == int(matches.size()) - 1 && !searchComplete) {
+            return; // Matches closer to the cursor may still be found
+        }
+        if (match < 0) {
+            if (!searchComplete) {
+                return; // Wrapping around needs the last match
+            }
+            match = int(matches.size()) - 1;
+        }
+        break;
+    }
+    case PendingStep::None:
+    case PendingStep::ReplaceAll:
+        break;
+    }
+
+    pendingStep = PendingStep::None;
+    if (match >= 0) {
+        selectMatch(match);
+    }
+}
+
+int FindBarWidget::lineOfOffset(int offset) const
+{
+    return int(std::upper_bound(searchedLineStarts.cbegin(), searchedLineStarts.cend(), offset)
+               - searchedLineStarts.cbegin()) - 1;
+}
+
+int FindBarWidget::rawOffsetOf(int position) const
+{
+    const QTextBlock block = currentEditor->document()->findBlock(position);
+    const int line = currentEditor->rawLineOfBlock(block);
+    if (line < 0 || line >= searchedLineStarts.size()) {
+        return int(searchedSnapshot.size());
+    }
+    // A rendered block has no Markdown columns; it stands for the start of its line
+    const MarkdownBlockData *data = static_cast<MarkdownBlockData *>(block.userData());
+    if (data && data->isRendered) {
+        return searchedLineStarts[line];
+    }
+    const int lineEnd = line + 1 < searchedLineStarts.size() ? searchedLineStarts[line + 1] - 1
+                                                              : int(searchedSnapshot.size());
+    return qMin(searchedLineStarts[line] + position - block.position(), lineEnd);
 }
 
-void FindBarWidget::updateFindStatus(bool found)
+void FindBarWidget::selectMatch(int match)
+{
+    const FindEngine::Match found = matches[match];
+    const int line = lineOfOffset(found.start);
+    if (line < 0) {
+        return; // No snapshot to map the match to a line
+    }
+    currentMatch = match;
+    currentEditor->selectRawText(line, found.start - searchedLineStarts[line], found.length);
+}
+
+void FindBarWidget::refreshHighlights()
+{
+    if (!currentEditor) {
+        return;
+    }
+    if (!m_isFindBarVisible || !matchesAreCurrent() || matches.isEmpty()) {
+        clearHighlights();
+        return;
+    }
+
+    QTextCharFormat format;
+    QColor color = ThemeManager::instance() ? ThemeManager::instance()->highlightColor()
+                                            : currentEditor->palette().color(QPalette::Highlight);
+    color.setAlpha(80);
+    format.setBackground(color);
+
+    QList<QTextEdit::ExtraSelection> selections;
+    QTextDocument *document = currentEditor->document();
+    auto highlight = [&](int start, int length) {
+        QTextEdit::ExtraSelection selection;
+        selection.cursor = QTextCursor(document);
+        selection.cursor.setPosition(start);
+        selection.cursor.setPosition(start + length, QTextCursor::KeepAnchor);
+        selection.format = format;
+        selections.append(selection);
+    };
+
+    // Only the blocks on screen get selections
+    const QWidget *viewport = currentEditor->viewport();
+    const QTextBlock firstBlock = currentEditor->cursorForPosition(QPoint(0, 0)).block();
+    const QTextBlock lastBlock = currentEditor->cursorForPosition(
+        QPoint(viewport->width() - 1, viewport->height() - 1)).block();
+    int line = currentEditor->rawLineOfBlock(firstBlock);
+    for (QTextBlock block = firstBlock; block.isValid(); block = block.next()) {
+        const MarkdownBlockData *data = static_cast<MarkdownBlockData *>(block.userData());
+        if (block != firstBlock && !(data && data->isRendered && data->isContinuation)) {
+            ++line;
+        }
+        if (data && data->isRendered) {
+            // Rendered text has no Markdown columns; what shows of the query is marked instead
+            const FindEngine::Matches shown = FindEngine::findIn(block.text(), searchedPattern, searchedOptions);
+            for (const FindEngine::Match &match : shown) {
+                highlight(block.position() + match.start, match.length);
+            }
+        } else if (line >= 0 && line < searchedLineStarts.size()) {
+            const int lineStart = searchedLineStarts[line];
+            const int lineEnd = lineStart + block.length() - 1;
+            for (int i = FindEngine::firstMatchFrom(matches, lineStart);
+                 i < matches.size() && matches[i].start < lineEnd; ++i) {
+                highlight(block.position() + matches[i].start - lineStart, matches[i].length);
+            }
+        }
+        if (block == lastBlock) {
+            break;
+        }
+    }
+    currentEditor->setExtraSelections(selections);
+}
+
+void FindBarWidget::clearHighlights()
+{
+    if (currentEditor && !currentEditor->extraSelections().isEmpty()) {
+        currentEditor->setExtraSelections({});
+    }
+}
+
+void FindBarWidget::updateFindStatus()
 {
     if (findLineEdit->text().isEmpty()) {
         findStatusLabel->setText("");
+    } else if (invalidExpression) {
+        findStatusLabel->setText(tr("Invalid expression"));
+    } else if (replacedCount >= 0) {
+        findStatusLabel->setText(tr("Replaced %1").arg(replacedCount));
+    } else if (matches.isEmpty()) {
+        findStatusLabel->setText(searchComplete ? tr("Not found") : tr("Searching..."));
     } else {
-        findStatusLabel->setText(found ? tr("Found") : tr("Not found"));
+        // A running search may still add matches
+        const QString total = searchComplete ? QString::number(matches.size()) : tr("%1+").arg(matches.size());
+        findStatusLabel->setText(currentMatch >= 0 ? tr("%1 of %2").arg(currentMatch + 1).arg(total)
+                                                   : tr("%1 matches").arg(total));
     }
 }
 
@@ -173,6 +524,13 @@ void FindBarWidget::createLayout()
     
     caseSensitiveCheckBox = new QCheckBox(tr("Case sensitive"));
     wholeWordsCheckBox = new QCheckBox(tr("Whole words"));
+    regularExpressionCheckBox = new QCheckBox(tr("Regular expression"));
+    regularExpressionCheckBox->setToolTip(tr("\\1, \\2, ... in the replacement insert the captured groups"));
+
+    QLabel *replaceLabel = new QLabel(tr("Replace:"));
+    replaceLineEdit = new QLineEdit();
+    replaceButton = new QPushButton(tr("Replace"));
+    replaceAllButton = new QPushButton(tr("Replace All"));
     
     findNextButton = new QPushButton(tr("Next"));
     findPreviousButton = new QPushButton(tr("Previous"));
@@ -189,6 +547,7 @@ void FindBarWidget::createLayout()
     QHBoxLayout *optionsLayout = new QHBoxLayout;
     optionsLayout->addWidget(caseSensitiveCheckBox);
     optionsLayout->addWidget(wholeWordsCheckBox);
+    optionsLayout->addWidget(regularExpressionCheckBox);
     optionsLayout->addStretch();
     
     QHBoxLayout *buttonsLayout = new QHBoxLayout;
@@ -206,6 +565,13 @@ void FindBarWidget::createLayout()
     topLayout->addWidget(findLineEdit);
     topLayout->addLayout(optionsLayout);
     
+    QHBoxLayout *replaceLayout = new QHBoxLayout;
+    replaceLayout->addWidget(replaceLabel);
+    replaceLayout->addWidget(replaceLineEdit);
+    replaceLayout->addWidget(replaceButton);
+    replaceLayout->addWidget(replaceAllButton);
+
     mainLayout->addLayout(topLayout);
+    mainLayout->addLayout(replaceLayout);
     mainLayout->addLayout(buttonsLayout);
 }
@@ -0,0 +1,446 @@
+#include "findengine.h"
+#include <QPromise>
+#include <QtConcurrent>
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FINDENGINE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(FINDENGINE_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define FINDENGINE_AVX2 1
+#define FINDENGINE_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(FINDENGINE_SSE2) && defined(_MSC_VER)
+#define FINDENGINE_AVX2 1
+#define FINDENGINE_TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Text scanned between checks for cancellation; the matches found in it form one batch
+const qsizetype ChunkSize = 1 << 20;
+
+// Candidates verified between checks for cancellation when narrowing
+const qsizetype CandidateChunkSize = 1 << 16;
+
+// Regular expression matches reported together
+const qsizetype ExpressionBatchSize = 4096;
+
+// Word characters as `\b` in QRegularExpression sees them
+bool isWordCharacter(QChar c)
+{
+    return c.isLetterOrNumber() || c.isMark() || c == QLatin1Char('_');
+}
+
+bool isWordBoundary(QStringView text, qsizetype position)
+{
+    const bool before = position > 0 && isWordCharacter(text[position - 1]);
+    const bool after = position < text.size() && isWordCharacter(text[position]);
+    return before != after;
+}
+
+bool matchesAt(QStringView text, qsizetype position, QStringView pattern, Qt::CaseSensitivity caseSensitivity)
+{
+    return position >= 0 && position + pattern.size() <= text.size()
+        && text.sliced(position, pattern.size()).compare(pattern, caseSensitivity) == 0;
+}
+
+// The pattern with the code units a candidate position must have at its
+// first and last unit, in both cases when the search ignores case
+struct Needle {
+    QStringView pattern;
+    Qt::CaseSensitivity caseSensitivity;
+    char16_t first[2];
+    char16_t last[2];
+    bool vectorised; // False when case folding pairs the filter units with others than these
+
+    Needle(QStringView text, Qt::CaseSensitivity sensitivity)
+        : pattern(text), caseSensitivity(sensitivity)
+    {
+        vectorised = addCases(first, text.front().unicode()) && addCases(last, text.back().unicode());
+    }
+
+    bool addCases(char16_t (&units)[2], char16_t unit) const
+    {
+        units[0] = units[1] = unit;
+        if (caseSensitivity == Qt::CaseSensitive) {
+            return true;
+        }
+        // Outside ASCII, and for the letters the Kelvin sign and the long s
+        // fold to, case folding is not a matter of two code units
+        if (unit >= 0x80 || unit == u'k' || unit == u'K' || unit == u's' || unit == u'S') {
+            return false;
+        }
+        if ((unit | 0x20) >= u'a' && (unit | 0x20) <= u'z') {
+            units[0] = unit | 0x20;
+            units[1] = unit & ~0x20;
+        }
+        return true;
+    }
+};
+
+// --- Scalar kernel --------------------------------------------------------
+
+qsizetype findScalar(QStringView text, qsizetype from, const Needle &needle)
+{
+    return text.indexOf(needle.pattern, from, needle.caseSensitivity);
+}
+
+// --- SSE2 kernel ----------------------------------------------------------
+
+// Positions whose first and last unit match the needle are verified in full;
+// comparing two units far apart rejects almost every other position at once.
+
+#ifdef FINDENGINE_SSE2
+qsizetype findSse2(QStringView text, qsizetype from, const Needle &needle)
+{
+    const char16_t *data = text.utf16();
+    const qsizetype lastOffset = needle.pattern.size() - 1;
+    const __m128i firstLower = _mm_set1_epi16(short(needle.first[0]));
+    const __m128i firstUpper = _mm_set1_epi16(short(needle.first[1]));
+    const __m128i lastLower = _mm_set1_epi16(short(needle.last[0]));
+    const __m128i lastUpper = _mm_set1_epi16(short(needle.last[1]));
+    qsizetype i = from;
+    for (; i + lastOffset + 8 <= text.size(); i += 8) {
+        const __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + lastOffset));
+        const __m128i hits = _mm_and_si128(
+            _mm_or_si128(_mm_cmpeq_epi16(head, firstLower), _mm_cmpeq_epi16(head, firstUpper)),
+            _mm_or_si128(_mm_cmpeq_epi16(tail, lastLower), _mm_cmpeq_epi16(tail, lastUpper)));
+        // Two mask bits per code unit
+        quint32 mask = quint32(_mm_movemask_epi8(hits));
+        while (mask) {
+            const int bit = qCountTrailingZeroBits(mask);
+            if (matchesAt(text, i + bit / 2, needle.pattern, needle.caseSensitivity)) {
+                return i + bit / 2;
+            }
+            mask &= ~(3u << bit);
+        }
+    }
+    return findScalar(text, i, needle);
+}
+#endif
+
+// --- AVX2 kernel ----------------------------------------------------------
+
+#ifdef FINDENGINE_AVX2
+FINDENGINE_TARGET_AVX2
+qsizetype findAvx2(QStringView text, qsizetype from, const Needle &needle)
+{
+    const char16_t *data = text.utf16();
+    const qsizetype lastOffset = needle.pattern.size() - 1;
+    const __m256i firstLower = _mm256_set1_epi16(short(needle.first[0]));
+    const __m256i firstUpper = _mm256_set1_epi16(short(needle.first[1]));
+    const __m256i lastLower = _mm256_set1_epi16(short(needle.last[0]));
+    const __m256i lastUpper = _mm256_set1_epi16(short(needle.last[1]));
+    qsizetype i = from;
+    for (; i + lastOffset + 16 <= text.size(); i += 16) {
+        const __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        const __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + lastOffset));
+        const __m256i hits = _mm256_and_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi16(head, firstLower), _mm256_cmpeq_epi16(head, firstUpper)),
+            _mm256_or_si256(_mm256_cmpeq_epi16(tail, lastLower), _mm256_cmpeq_epi16(tail, lastUpper)));
+        quint32 mask = quint32(_mm256_movemask_epi8(hits));
+        while (mask) {
+            const int bit = qCountTrailingZeroBits(mask);
+            if (matchesAt(text, i + bit / 2, needle.pattern, needle.caseSensitivity)) {
+                return i + bit / 2;
+            }
+            mask &= ~(3u << bit);
+        }
+    }
+    return findSse2(text, i, needle);
+}
+
+bool cpuHasAvx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+        return false; // The OS does not save YMM registers
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+// --- Dispatch -------------------------------------------------------------
+
+using FindKernel = qsizetype (*)(QStringView, qsizetype, const Needle &);
+
+FindKernel selectKernel()
+{
+#ifdef FINDENGINE_AVX2
+    if (cpuHasAvx2()) {
+        return findAvx2;
+    }
+#endif
+#ifdef FINDENGINE_SSE2
+    return findSse2;
+#else
+    return findScalar;
+#endif
+}
+
+// --- Searches -------------------------------------------------------------
+
+// Appends the matches in @p window, a prefix of @p text, found from @p from
+// on to @p matches and returns the position after the last one
+qsizetype scanWindow(QStringView text, QStringView window, qsizetype from, const Needle &needle, bool wholeWords,
+                     FindEngine::Matches &matches)
+{
+    static const FindKernel vectorKernel = selectKernel();
+    const FindKernel kernel = needle.vectorised ? vectorKernel : findScalar;
+    const qsizetype length = needle.pattern.size();
+    qsizetype position;
+    while ((position = kernel(window, from, needle)) >= 0) {
+        if (wholeWords && (!isWordBoundary(text, position) || !isWordBoundary(text, position + length))) {
+            from = position + 1;
+            continue;
+        }
+        matches.append({ int(position), int(length) });
+        from = position + length;
+    }
+    return from;
+}
+
+void scan(QPromise<FindEngine::Matches> &promise, QStringView text, QStringView pattern,
+          const FindEngine::Options &options)
+{
+    const Needle needle(pattern, options.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+    const qsizetype length = pattern.size();
+    qsizetype from = 0;
+    while (from + length <= text.size()) {
+        if (promise.isCanceled()) {
+            return;
+        }
+        // Matches may start anywhere in the chunk and run past its end
+        const qsizetype windowEnd = qMin(text.size(), from + ChunkSize + length - 1);
+        FindEngine::Matches batch;
+        from = scanWindow(text, text.first(windowEnd), from, needle, options.wholeWords, batch);
+        from = qMax(from, windowEnd - length + 1);
+        if (!batch.isEmpty()) {
+            promise.addResult(batch);
+        }
+    }
+}
+
+// Appends the next matches of @p iterator, over @p text, to @p matches until
+// @p batchSize of them are found; returns false once there are no more
+bool matchExpression(QRegularExpressionMatchIterator &iterator, QStringView text, qsizetype batchSize,
+                     FindEngine::Matches &matches)
+{
+    while (iterator.hasNext()) {
+        const QRegularExpressionMatch match = iterator.next();
+        const QStringView matched = text.sliced(match.capturedStart(), match.capturedLength());
+        if (matched.contains(QLatin1Char('\n'))) {
+            continue; // Matches map to the editor line by line
+        }
+        matches.append({ int(match.capturedStart()), int(match.capturedLength()) });
+        if (matches.size() >= batchSize) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void scanExpression(QPromise<FindEngine::Matches> &promise, const QString &text, const QRegularExpression &expression)
+{
+    // Cancellation is checked between matches; PCRE2 scans the text in between
+    QRegularExpressionMatchIterator iterator = expression.globalMatch(text);
+    bool more = true;
+    while (more && !promise.isCanceled()) {
+        FindEngine::Matches batch;
+        more = matchExpression(iterator, text, ExpressionBatchSize, batch);
+        if (!batch.isEmpty()) {
+            promise.addResult(batch);
+        }
+    }
+}
+
+void narrowMatches(QPromise<FindEngine::Matches> &promise, QStringView text, const FindEngine::Matches &candidates,
+                   int offset, QStringView pattern, const FindEngine::Options &options)
+{
+    const Qt::CaseSensitivity caseSensitivity = options.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    const qsizetype length = pattern.size();
+    qsizetype end = 0; // Matches do not overlap, as a full scan finds them
+    for (qsizetype chunk = 0; chunk < candidates.size(); chunk += CandidateChunkSize) {
+        if (promise.isCanceled()) {
+            return;
+        }
+        FindEngine::Matches batch;
+        const qsizetype chunkEnd = qMin(candidates.size(), chunk + CandidateChunkSize);
+        for (qsizetype i = chunk; i < chunkEnd; ++i) {
+            const qsizetype position = qsizetype(candidates[i].start) - offset;
+            if (position >= end && matchesAt(text, position, pattern, caseSensitivity)) {
+                batch.append({ int(position), int(length) });
+                end = position + length;
+            }
+        }
+        if (!batch.isEmpty()) {
+            promise.addResult(batch);
+        }
+    }
+}
+
+} // namespace
+
+namespace FindEngine
+{
+
+QRegularExpression regularExpression(const QString &pattern, const Options &options)
+{
+    QRegularExpression::PatternOptions patternOptions = QRegularExpression::MultilineOption;
+    if (!options.caseSensitive) {
+        patternOptions |= QRegularExpression::CaseInsensitiveOption;
+    }
+    const QString expression = options.wholeWords ? "\\b(?:" + pattern + ")\\b" : pattern;
+    return QRegularExpression(expression, patternOptions);
+}
+
+Replacer::Replacer(const QString &pattern, const QString &replacement, const Options &options)
+{
+    if (!options.regularExpression) {
+        m_pieces.append({ replacement, -1 });
+        return;
+    }
+
+    m_expression = regularExpression(pattern, options);
+    Piece piece;
+    for (qsizetype i = 0; i < replacement.size(); ++i) {
+        const QChar c = replacement[i];
+        if (c != QLatin1Char('\\') || i + 1 == replacement.size()) {
+            piece.text += c;
+        } else if (replacement[i + 1] == QLatin1Char('\\')) {
+            piece.text += c;
+            ++i;
+        } else if (replacement[i + 1].isDigit()) {
+            int group = replacement[++i].digitValue();
+            if (i + 1 < replacement.size() && replacement[i + 1].isDigit()
+                && group * 10 + replacement[i + 1].digitValue() <= m_expression.captureCount()) {
+                group = group * 10 + replacement[++i].digitValue();
+            }
+            piece.group = group;
+            m_pieces.append(piece);
+            piece = Piece();
+        } else {
+            piece.text += c;
+        }
+    }
+    m_pieces.append(piece);
+}
+
+QString Replacer::replacementFor(const QString &text, const Match &match) const
+{
+    if (m_pieces.size() == 1 && m_pieces.first().group < 0) {
+        return m_pieces.first().text; // Nothing to capture
+    }
+
+    // Matching again at the same offset finds the same match, now with its groups
+    const QRegularExpressionMatch found = m_expression.match(text, match.start, QRegularExpression::NormalMatch,
+                                                             QRegularExpression::AnchorAtOffsetMatchOption);
+    QString replacement;
+    for (const Piece &piece : m_pieces) {
+        replacement += piece.text;
+        if (piece.group >= 0) {
+            replacement += found.captured(piece.group);
+        }
+    }
+    return replacement;
+}
+
+QFuture<Matches> findAll(const QString &text, const QString &pattern, const Options &options)
+{
+    return QtConcurrent::run([text, pattern, options](QPromise<Matches> &promise) {
+        if (options.regularExpression) {
+            scanExpression(promise, text, regularExpression(pattern, options));
+        } else if (!pattern.isEmpty()) {
+            scan(promise, text, pattern, options);
+        }
+    });
+}
+
+Matches findIn(const QString &text, const QString &pattern, const Options &options)
+{
+    if (options.regularExpression) {
+        return findIn(text, regularExpression(pattern, options));
+    }
+    Matches matches;
+    if (!pattern.isEmpty()) {
+        const Needle needle(pattern, options.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+        scanWindow(text, text, 0, needle, options.wholeWords, matches);
+    }
+    return matches;
+}
+
+Matches findIn(const QString &text, const QRegularExpression &expression)
+{
+    Matches matches;
+    if (expression.isValid()) {
+        QRegularExpressionMatchIterator iterator = expression.globalMatch(text);
+        matchExpression(iterator, text, std::numeric_limits<qsizetype>::max(), matches);
+    }
+    return matches;
+}
+
+QVector<int> lineStarts(QStringView text)
+{
+    QVector<int> starts{ 0 };
+    for (qsizetype newline = text.indexOf(QLatin1Char('\n')); newline >= 0;
+         newline = text.indexOf(QLatin1Char('\n'), newline + 1)) {
+        starts.append(int(newline + 1));
+    }
+    return starts;
+}
+
+int narrowingOffset(const QString &previous, const QString &pattern, const Options &options)
+{
+    if (options.regularExpression || options.wholeWords || previous.isEmpty() || pattern.size() <= previous.size()) {
+        return -1; // A word may end inside a longer query
+    }
+    const Qt::CaseSensitivity caseSensitivity = options.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    const int offset = int(pattern.indexOf(previous, 0, caseSensitivity));
+    if (offset < 0) {
+        return -1;
+    }
+    // With a border (a prefix that is also a suffix) occurrences of the
+    // previous query can overlap, and the full scan skipped some of them
+    const QStringView view(previous);
+    for (qsizetype border = 1; border < view.size(); ++border) {
+        if (view.first(border).compare(view.last(border), caseSensitivity) == 0) {
+            return -1;
+        }
+    }
+    return offset;
+}
+
+QFuture<Matches> narrow(const QString &text, const Matches &candidates, int offset, const QString &pattern,
+                        const Options &options)
+{
+    return QtConcurrent::run([text, candidates, offset, pattern, options](QPromise<Matches> &promise) {
+        narrowMatches(promise, text, candidates, offset, pattern, options);
+    });
+}
+
+int firstMatchFrom(const Matches &matches, int position)
+{
+    auto match = std::lower_bound(matches.cbegin(), matches.cend(), position,
+                                  [](const Match &match, int position) { return match.start < position; });
+    return int(match - matches.cbegin());
+}
+
+}
@@ -0,0 +1,115 @@
+#include "findinfilesmodel.h"
+
+FindInFilesModel::FindInFilesModel(QObject *parent)
+    : QAbstractItemModel(parent)
+{
+}
+
+void FindInFilesModel::clear(const QString &rootPath)
+{
+    beginResetModel();
+    m_root.setPath(rootPath);
+    m_files.clear();
+    m_hitCount = 0;
+    endResetModel();
+}
+
+void FindInFilesModel::appendResults(const QVector<FileSearch::FileResult> &results)
+{
+    if (results.isEmpty()) {
+        return;
+    }
+    const int first = int(m_files.size());
+    beginInsertRows(QModelIndex(), first, first + int(results.size()) - 1);
+    for (const FileSearch::FileResult &result : results) {
+        m_files.append(result);
+        m_hitCount += int(result.hits.size());
+    }
+    endInsertRows();
+}
+
+const FileSearch::FileResult *FindInFilesModel::fileAt(const QModelIndex &index) const
+{
+    if (!index.isValid() || index.model() != this) {
+        return nullptr;
+    }
+    const int file = index.internalId() == 0 ? index.row() : int(index.internalId()) - 1;
+    return &m_files[file];
+}
+
+const FileSearch::Hit *FindInFilesModel::hitAt(const QModelIndex &index) const
+{
+    if (!index.isValid() || index.model() != this || index.internalId() == 0) {
+        return nullptr;
+    }
+    return &m_files[int(index.internalId()) - 1].hits[index.row()];
+}
+
+QModelIndex FindInFilesModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (column != 0 || row < 0) {
+        return QModelIndex();
+    }
+    if (!parent.isValid()) {
+        return row < m_files.size() ? createIndex(row, 0, quintptr(0)) : QModelIndex();
+    }
+    if (parent.internalId() != 0) {
+        return QModelIndex(); // Matches have no children
+    }
+    return row < m_files[parent.row()].hits.size() ? createIndex(row, 0, quintptr(parent.row() + 1)) : QModelIndex();
+}
+
+QModelIndex FindInFilesModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid() || child.internalId() == 0) {
+        return QModelIndex();
+    }
+    return createIndex(int(child.internalId()) - 1, 0, quintptr(0));
+}
+
+int FindInFilesModel::rowCount(const QModelIndex &parent) const
+{
+    if (!parent.isValid()) {
+        return int(m_files.size());
+    }
+    return parent.column() == 0 && parent.internalId() == 0 ? int(m_files[parent.row()].hits.size()) : 0;
+}
+
+int FindInFilesModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return 1;
+}
+
+bool FindInFilesModel::hasChildren(const QModelIndex &parent) const
+{
+    return rowCount(parent) > 0;
+}
+
+QVariant FindInFilesModel::data(const QModelIndex &index, int role) const
+{
+    const FileSearch::FileResult *file = fileAt(index);
+    if (!file) {
+        return QVariant();
+    }
+
+    if (const FileSearch::Hit *hit = hitAt(index)) {
+        if (role == Qt::DisplayRole) {
+            return QStringLiteral("%1: %2").arg(hit->line + 1).arg(hit->preview.trimmed());
+        }
+        if (role == Qt::ToolTipRole) {
+            return hit->preview;
+        }
+        return QVariant();
+    }
+
+    if (role == Qt::DisplayRole) {
+        const QString path = m_root.relativeFilePath(file->filePath);
+        const QString count = file->truncated ? tr("%1+").arg(file->hits.size()) : QString::number(file->hits.size());
+        return QStringLiteral("%1 (%2)").arg(path, count);
+    }
+    if (role == Qt::ToolTipRole) {
+        return file->filePath;
+    }
+    return QVariant();
+}
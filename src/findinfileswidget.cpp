@@ -0,0 +1,216 @@
+#include "findinfileswidget.h"
+#include "findinfilesmodel.h"
+#include <QCheckBox>
+#include <QHBoxLayout>
+#include <QKeyEvent>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QTreeView>
+#include <QVBoxLayout>
+
+namespace {
+
+// Files are shown expanded until this many matches are on display
+const int ExpandedHitsLimit = 500;
+
+} // namespace
+
+FindInFilesWidget::FindInFilesWidget(QWidget *parent)
+    : QWidget(parent)
+    , nameFilters({ "*.md", "*.markdown", "*.txt" })
+{
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    mainLayout->setContentsMargins(0, 0, 0, 0);
+    mainLayout->setSpacing(2);
+
+    queryEdit = new QLineEdit();
+    queryEdit->setPlaceholderText(tr("Search in files"));
+    queryEdit->setClearButtonEnabled(true);
+    mainLayout->addWidget(queryEdit);
+
+    QHBoxLayout *optionsLayout = new QHBoxLayout();
+    caseSensitiveCheckBox = new QCheckBox(tr("Aa"));
+    caseSensitiveCheckBox->setToolTip(tr("Case sensitive"));
+    wholeWordsCheckBox = new QCheckBox(tr("W"));
+    wholeWordsCheckBox->setToolTip(tr("Whole words"));
+    regularExpressionCheckBox = new QCheckBox(tr(".*"));
+    regularExpressionCheckBox->setToolTip(tr("Regular expression"));
+    stopButton = new QPushButton(tr("Stop"));
+    stopButton->setEnabled(false);
+    optionsLayout->addWidget(caseSensitiveCheckBox);
+    optionsLayout->addWidget(wholeWordsCheckBox);
+    optionsLayout->addWidget(regularExpressionCheckBox);
+    optionsLayout->addStretch();
+    optionsLayout->addWidget(stopButton);
+    mainLayout->addLayout(optionsLayout);
+
+    includeEdit = new QLineEdit();
+    includeEdit->setPlaceholderText(tr("Files to include, e.g. notes/*, *.md"));
+    includeEdit->setClearButtonEnabled(true);
+    mainLayout->addWidget(includeEdit);
+
+    excludeEdit = new QLineEdit();
+    excludeEdit->setPlaceholderText(tr("Files to exclude, e.g. archive/, *.txt"));
+    excludeEdit->setClearButtonEnabled(true);
+    mainLayout->addWidget(excludeEdit);
+
+    statusLabel = new QLabel();
+    mainLayout->addWidget(statusLabel);
+
+    resultsModel = new FindInFilesModel(this);
+    resultsView = new QTreeView();
+    resultsView->setHeaderHidden(true);
+    resultsView->setUniformRowHeights(true);
+    resultsView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    resultsView->setModel(resultsModel);
+    mainLayout->addWidget(resultsView);
+
+    searchWatcher = new QFutureWatcher<FileSearch::FileResult>(this);
+    connect(searchWatcher, &QFutureWatcher<FileSearch::FileResult>::resultsReadyAt,
+            this, &FindInFilesWidget::onResultsReady);
+    connect(searchWatcher, &QFutureWatcher<FileSearch::FileResult>::finished,
+            this, &FindInFilesWidget::onSearchFinished);
+
+    connect(queryEdit, &QLineEdit::returnPressed, this, &FindInFilesWidget::startSearch);
+    connect(includeEdit, &QLineEdit::returnPressed, this, &FindInFilesWidget::startSearch);
+    connect(excludeEdit, &QLineEdit::returnPressed, this, &FindInFilesWidget::startSearch);
+    connect(stopButton, &QPushButton::clicked, this, &FindInFilesWidget::stopSearch);
+    connect(resultsView, &QTreeView::clicked, this, &FindInFilesWidget::onItemActivated);
+    connect(resultsView, &QTreeView::activated, this, &FindInFilesWidget::onItemActivated);
+}
+
+FindInFilesWidget::~FindInFilesWidget()
+{
+    // Nobody is left to show the results
+    searchWatcher->cancel();
+}
+
+void FindInFilesWidget::setRootPath(const QString &path)
+{
+    if (rootPath == path) {
+        return;
+    }
+    rootPath = path;
+    if (searched) {
+        startSearch();
+    }
+}
+
+void FindInFilesWidget::setNameFilters(const QStringList &filters)
+{
+    nameFilters = filters;
+}
+
+void FindInFilesWidget::focusQuery()
+{
+    queryEdit->setFocus();
+    queryEdit->selectAll();
+}
+
+void FindInFilesWidget::keyPressEvent(QKeyEvent *event)
+{
+    if (event->key() == Qt::Key_Escape && searchWatcher->isRunning()) {
+        stopSearch();
+        event->accept();
+        return;
+    }
+    QWidget::keyPressEvent(event);
+}
+
+void FindInFilesWidget::startSearch()
+{
+    searchWatcher->cancel();
+    resultsModel->clear(rootPath);
+
+    FileSearch::Query query;
+    query.rootPath = rootPath;
+    query.pattern = queryEdit->text();
+    query.options.caseSensitive = caseSensitiveCheckBox->isChecked();
+    query.options.wholeWords = wholeWordsCheckBox->isChecked();
+    query.options.regularExpression = regularExpressionCheckBox->isChecked();
+    query.nameFilters = nameFilters;
+    query.includeGlobs = FileSearch::parseGlobs(includeEdit->text());
+    query.excludeGlobs = FileSearch::parseGlobs(excludeEdit->text());
+
+    searched = !query.pattern.isEmpty();
+    invalidExpression = query.options.regularExpression
+        && !FindEngine::regularExpression(query.pattern, query.options).isValid();
+    if (!searched || invalidExpression || rootPath.isEmpty()) {
+        searchWatcher->setFuture(QFuture<FileSearch::FileResult>());
+        stopButton->setEnabled(false);
+        updateStatus();
+        return;
+    }
+
+    searchWatcher->setFuture(FileSearch::search(query));
+    stopButton->setEnabled(true);
+    updateStatus();
+}
+
+void FindInFilesWidget::stopSearch()
+{
+    searchWatcher->cancel();
+}
+
+void FindInFilesWidget::onResultsReady(int begin, int end)
+{
+    QVector<FileSearch::FileResult> results;
+    results.reserve(end - begin);
+    for (int i = begin; i < end; ++i) {
+        results.append(searchWatcher->resultAt(i));
+    }
+
+    const int shownHits = resultsModel->hitCount();
+    const int firstRow = resultsModel->fileCount();
+    resultsModel->appendResults(results);
+    if (shownHits < ExpandedHitsLimit) {
+        int expandedHits = shownHits;
+        for (int row = firstRow; row < resultsModel->fileCount() && expandedHits < ExpandedHitsLimit; ++row) {
+            resultsView->expand(resultsModel->index(row, 0));
+            expandedHits += int(results[row - firstRow].hits.size());
+        }
+    }
+    updateStatus();
+}
+
+void FindInFilesWidget::onSearchFinished()
+{
+    stopButton->setEnabled(false);
+    updateStatus();
+}
+
+void FindInFilesWidget::onItemActivated(const QModelIndex &index)
+{
+    const FileSearch::FileResult *file = resultsModel->fileAt(index);
+    const FileSearch::Hit *hit = resultsModel->hitAt(index);
+    if (file && hit) {
+        emit hitActivated(file->filePath, hit->line, hit->column, hit->length);
+    }
+}
+
+void FindInFilesWidget::updateStatus()
+{
+    if (invalidExpression) {
+        statusLabel->setText(tr("Invalid expression"));
+        return;
+    }
+    if (!searched) {
+        statusLabel->clear();
+        return;
+    }
+
+    const bool running = searchWatcher->isRunning();
+    if (resultsModel->fileCount() == 0) {
+        statusLabel->setText(running ? tr("Searching...")
+                             : searchWatcher->isCanceled() ? tr("Stopped") : tr("Not found"));
+        return;
+    }
+    QString text = tr("%1 matches in %2 files").arg(resultsModel->hitCount()).arg(resultsModel->fileCount());
+    if (running) {
+        text += tr(", searching...");
+    } else if (searchWatcher->isCanceled()) {
+        text += tr(", stopped");
+    }
+    statusLabel->setText(text);
+}
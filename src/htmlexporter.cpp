@@ -0,0 +1,468 @@
+#include "htmlexporter.h"
+#include "textcodec.h"
+#include <QByteArray>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QSaveFile>
+#include <cmark.h>
+#include <cstring>
+
+namespace {
+
+const int ParseOptions = CMARK_OPT_DEFAULT | CMARK_OPT_SMART;
+
+// UTF-16 code units converted and fed to the parser at a time
+const qsizetype ParseChunkSize = 256 * 1024;
+
+// Output is handed to the device in blocks of this size
+const qsizetype WriteBufferSize = 64 * 1024;
+
+// Progress is reported, and cancellation checked, every this many top-level blocks
+const int ProgressInterval = 64;
+
+const char PageStyle[] =
+    "body { font-family: sans-serif; line-height: 1.6; max-width: 800px; margin: 0 auto; padding: 2rem; }\n"
+    "pre { background-color: #f4f4f4; padding: 1em; border-radius: 4px; overflow-x: auto; }\n"
+    "code { background-color: #f4f4f4; padding: 0.2em 0.4em; border-radius: 3px; }\n"
+    "blockquote { border-left: 4px solid #ddd; margin: 0; padding-left: 1em; color: #666; }\n"
+    "table { border-collapse: collapse; width: 100%; margin: 1em 0; }\n"
+    "th, td { border: 1px solid #ddd; padding: 8px; text-align: left; }\n"
+    "th { background-color: #f4f4f4; }\n";
+
+const char RawHtmlOmitted[] = "<!-- raw HTML omitted -->";
+
+class Utf8Writer
+{
+public:
+    explicit Utf8Writer(QIODevice *device) : m_device(device)
+    {
+        m_buffer.reserve(WriteBufferSize);
+    }
+
+    void write(const char *data, qsizetype size)
+    {
+        if (size <= 0) {
+            return;
+        }
+        if (m_buffer.size() + size > WriteBufferSize) {
+            flush();
+        }
+        if (size >= WriteBufferSize) {
+            writeToDevice(data, size);
+        } else {
+            m_buffer.append(data, size);
+        }
+        m_lastChar = data[size - 1];
+    }
+
+    void write(const char *text)
+    {
+        if (text) {
+            write(text, qsizetype(std::strlen(text)));
+        }
+    }
+    void write(char c) { write(&c, 1); }
+    void write(const QByteArray &bytes) { write(bytes.constData(), bytes.size()); }
+
+    /// Starts a new line unless the output already ends with one
+    void cr()
+    {
+        if (m_lastChar != '\n') {
+            write('\n');
+        }
+    }
+
+    /// Writes text with &, <, > and " escaped
+    void writeEscaped(const char *data, qsizetype size)
+    {
+        qsizetype run = 0;
+        for (qsizetype i = 0; i < size; ++i) {
+            const char *entity = nullptr;
+            switch (data[i]) {
+            case '&': entity = "&amp;"; break;
+            case '<': entity = "&lt;"; break;
+            case '>': entity = "&gt;"; break;
+            case '"': entity = "&quot;"; break;
+            default: continue;
+            }
+            write(data + run, i - run);
+            write(entity);
+            run = i + 1;
+        }
+        write(data + run, size - run);
+    }
+
+    void writeEscaped(const char *text)
+    {
+        if (text) {
+            writeEscaped(text, qsizetype(std::strlen(text)));
+        }
+    }
+
+    /// Writes a URL percent-encoded for an attribute value, as cmark does
+    void writeHref(const char *url)
+    {
+        static const char hex[] = "0123456789ABCDEF";
+        for (const unsigned char *p = reinterpret_cast<const unsigned char *>(url); *p; ++p) {
+            const unsigned char c = *p;
+            if (c == '&') {
+                write("&amp;");
+            } else if (c == '\'') {
+                write("&#x27;");
+            } else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+                       || std::strchr("-_.+!*(),%#@?=;:/$~", c)) {
+                write(char(c));
+            } else {
+                const char encoded[3] = { '%', hex[c >> 4], hex[c & 0xf] };
+                write(encoded, 3);
+            }
+        }
+    }
+
+    bool flush()
+    {
+        if (!m_buffer.isEmpty()) {
+            writeToDevice(m_buffer.constData(), m_buffer.size());
+            m_buffer.clear();
+        }
+        return !m_failed;
+    }
+
+    bool failed() const { return m_failed; }
+
+private:
+    void writeToDevice(const char *data, qsizetype size)
+    {
+        if (!m_failed && m_device->write(data, size) != size) {
+            m_failed = true;
+        }
+    }
+
+    QIODevice *m_device;
+    QByteArray m_buffer;
+    char m_lastChar = '\n';
+    bool m_failed = false;
+};
+
+bool startsWithIgnoringCase(const char *text, const char *prefix)
+{
+    for (; *prefix; ++text, ++prefix) {
+        char c = *text;
+        if (c >= 'A' && c <= 'Z') {
+            c = char(c - 'A' + 'a');
+        }
+        if (c != *prefix) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Same rule as cmark's safe mode: script and file URLs are dropped, and data
+// URLs only survive for common image types.
+bool isDangerousUrl(const char *url)
+{
+    if (startsWithIgnoringCase(url, "javascript:") || startsWithIgnoringCase(url, "vbscript:")
+        || startsWithIgnoringCase(url, "file:")) {
+        return true;
+    }
+    if (startsWithIgnoringCase(url, "data:")) {
+        return !(startsWithIgnoringCase(url, "data:image/png") || startsWithIgnoringCase(url, "data:image/gif")
+                 || startsWithIgnoringCase(url, "data:image/jpeg") || startsWithIgnoringCase(url, "data:image/webp"));
+    }
+    return false;
+}
+
+void writeUrl(Utf8Writer &out, const char *url)
+{
+    if (url && !isDangerousUrl(url)) {
+        out.writeHref(url);
+    }
+}
+
+void writeTitleAttribute(Utf8Writer &out, const char *title)
+{
+    if (title && *title) {
+        out.write(" title=\"");
+        out.writeEscaped(title);
+        out.write('"');
+    }
+}
+
+bool isInTightList(cmark_node *paragraph)
+{
+    cmark_node *parent = cmark_node_parent(paragraph);
+    cmark_node *grandparent = parent ? cmark_node_parent(parent) : nullptr;
+    return grandparent && cmark_node_get_type(grandparent) == CMARK_NODE_LIST
+        && cmark_node_get_list_tight(grandparent);
+}
+
+// Returns false if @p progress asked to stop
+bool writeBody(cmark_node *document, Utf8Writer &out, const HtmlExporter::ProgressCallback &progress)
+{
+    cmark_node *lastBlock = cmark_node_last_child(document);
+    const qint64 totalLines = lastBlock ? cmark_node_get_end_line(lastBlock) : 0;
+    int topLevelBlocks = 0;
+    cmark_node *plainTextOf = nullptr; // Image whose description is written as alt text
+
+    cmark_iter *iter = cmark_iter_new(document);
+    cmark_event_type event;
+    bool canceled = false;
+    while (!canceled && (event = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
+        cmark_node *node = cmark_iter_get_node(iter);
+        const bool entering = event == CMARK_EVENT_ENTER;
+        const cmark_node_type type = cmark_node_get_type(node);
+
+        if (entering && progress && cmark_node_parent(node) == document
+            && ++topLevelBlocks % ProgressInterval == 0) {
+            canceled = !progress(cmark_node_get_start_line(node) - 1, totalLines);
+        }
+
+        if (plainTextOf && node != plainTextOf) {
+            switch (type) {
+            case CMARK_NODE_TEXT:
+            case CMARK_NODE_CODE:
+            case CMARK_NODE_HTML_INLINE:
+                out.writeEscaped(cmark_node_get_literal(node));
+                break;
+            case CMARK_NODE_LINEBREAK:
+            case CMARK_NODE_SOFTBREAK:
+                out.write(' ');
+                break;
+            default:
+                break;
+            }
+            continue;
+        }
+
+        switch (type) {
+        case CMARK_NODE_DOCUMENT:
+            break;
+        case CMARK_NODE_BLOCK_QUOTE:
+            out.cr();
+            out.write(entering ? "<blockquote>\n" : "</blockquote>\n");
+            break;
+        case CMARK_NODE_LIST: {
+            const bool ordered = cmark_node_get_list_type(node) == CMARK_ORDERED_LIST;
+            out.cr();
+            if (!entering) {
+                out.write(ordered ? "</ol>\n" : "</ul>\n");
+            } else if (!ordered) {
+                out.write("<ul>\n");
+            } else if (cmark_node_get_list_start(node) == 1) {
+                out.write("<ol>\n");
+            } else {
+                out.write(QByteArray("<ol start=\"") + QByteArray::number(cmark_node_get_list_start(node)) + "\">\n");
+            }
+            break;
+        }
+        case CMARK_NODE_ITEM:
+            if (entering) {
+                out.cr();
+                out.write("<li>");
+            } else {
+                out.write("</li>\n");
+            }
+            break;
+        case CMARK_NODE_HEADING: {
+            const QByteArray level = QByteArray::number(cmark_node_get_heading_level(node));
+            if (entering) {
+                out.cr();
+                out.write("<h" + level + ">");
+            } else {
+                out.write("</h" + level + ">\n");
+            }
+            break;
+        }
+        case CMARK_NODE_CODE_BLOCK: {
+            out.cr();
+            const char *info = cmark_node_get_fence_info(node);
+            if (!info || !*info) {
+                out.write("<pre><code>");
+            } else {
+                qsizetype languageLength = 0;
+                while (info[languageLength] && info[languageLength] != ' ') {
+                    ++languageLength;
+                }
+                out.write("<pre><code class=\"language-");
+                out.writeEscaped(info, languageLength);
+                out.write("\">");
+            }
+            out.writeEscaped(cmark_node_get_literal(node));
+            out.write("</code></pre>\n");
+            break;
+        }
+        case CMARK_NODE_HTML_BLOCK:
+            out.cr();
+            out.write(RawHtmlOmitted);
+            out.cr();
+            break;
+        case CMARK_NODE_CUSTOM_BLOCK:
+            out.cr();
+            out.write(entering ? cmark_node_get_on_enter(node) : cmark_node_get_on_exit(node));
+            out.cr();
+            break;
+        case CMARK_NODE_THEMATIC_BREAK:
+            out.cr();
+            out.write("<hr />\n");
+            break;
+        case CMARK_NODE_PARAGRAPH:
+            if (isInTightList(node)) {
+                break;
+            }
+            if (entering) {
+                out.cr();
+                out.write("<p>");
+            } else {
+                out.write("</p>\n");
+            }
+            break;
+        case CMARK_NODE_TEXT:
+            out.writeEscaped(cmark_node_get_literal(node));
+            break;
+        case CMARK_NODE_LINEBREAK:
+            out.write("<br />\n");
+            break;
+        case CMARK_NODE_SOFTBREAK:
+            out.write('\n');
+            break;
+        case CMARK_NODE_CODE:
+            out.write("<code>");
+            out.writeEscaped(cmark_node_get_literal(node));
+            out.write("</code>");
+            break;
+        case CMARK_NODE_HTML_INLINE:
+            out.write(RawHtmlOmitted);
+            break;
+        case CMARK_NODE_CUSTOM_INLINE:
+            out.write(entering ? cmark_node_get_on_enter(node) : cmark_node_get_on_exit(node));
+            break;
+        case CMARK_NODE_STRONG:
+            out.write(entering ? "<strong>" : "</strong>");
+            break;
+        case CMARK_NODE_EMPH:
+            out.write(entering ? "<em>" : "</em>");
+            break;
+        case CMARK_NODE_LINK:
+            if (entering) {
+                out.write("<a href=\"");
+                writeUrl(out, cmark_node_get_url(node));
+                out.write('"');
+                writeTitleAttribute(out, cmark_node_get_title(node));
+                out.write('>');
+            } else {
+                out.write("</a>");
+            }
+            break;
+        case CMARK_NODE_IMAGE:
+            if (entering) {
+                out.write("<img src=\"");
+                writeUrl(out, cmark_node_get_url(node));
+                out.write("\" alt=\"");
+                plainTextOf = node;
+            } else {
+                out.write('"');
+                writeTitleAttribute(out, cmark_node_get_title(node));
+                out.write(" />");
+                plainTextOf = nullptr;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    cmark_iter_free(iter);
+    return !canceled;
+}
+
+} // namespace
+
+namespace HtmlExporter
+{
+
+cmark_node *parse(QStringView markdown)
+{
+    cmark_parser *parser = cmark_parser_new(ParseOptions);
+    QByteArray chunk(ParseChunkSize * 3, Qt::Uninitialized);
+    const char16_t *data = reinterpret_cast<const char16_t *>(markdown.utf16());
+    const qsizetype size = markdown.size();
+    for (qsizetype offset = 0; offset < size;) {
+        qsizetype count = qMin(ParseChunkSize, size - offset);
+        if (offset + count < size && QChar::isHighSurrogate(data[offset + count - 1])) {
+            --count; // Keep surrogate pairs in one chunk
+        }
+        // QString is always valid UTF-16 up to lone surrogates, which become U+FFFD
+        const qsizetype bytes = TextCodec::utf16ToUtf8(data + offset, count, chunk.data());
+        cmark_parser_feed(parser, chunk.constData(), size_t(bytes));
+        offset += count;
+    }
+    cmark_node *document = cmark_parser_finish(parser);
+    cmark_parser_free(parser);
+    return document;
+}
+
+cmark_node *parseUtf8(const char *data, qsizetype size)
+{
+    cmark_parser *parser = cmark_parser_new(ParseOptions | CMARK_OPT_VALIDATE_UTF8);
+    cmark_parser_feed(parser, data, size_t(size));
+    cmark_node *document = cmark_parser_finish(parser);
+    cmark_parser_free(parser);
+    return document;
+}
+
+Result writePage(cmark_node *document, const QString &title, QIODevice *device, const ProgressCallback &progress)
+{
+    Result result;
+    Utf8Writer out(device);
+
+    const QByteArray utf8Title = title.toUtf8();
+    out.write("<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n<title>");
+    out.writeEscaped(utf8Title.constData(), utf8Title.size());
+    out.write("</title>\n<style>\n");
+    out.write(PageStyle);
+    out.write("</style>\n</head>\n<body>\n");
+
+    if (!writeBody(document, out, progress)) {
+        result.canceled = true;
+        return result;
+    }
+
+    out.write("\n</body>\n</html>");
+    if (!out.flush()) {
+        result.errorString = device->errorString();
+        return result;
+    }
+    result.ok = true;
+    return result;
+}
+
+Result exportDocument(cmark_node *document, const QString &fileName, const ProgressCallback &progress)
+{
+    Result result;
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        result.errorString = file.errorString();
+        return result;
+    }
+
+    result = writePage(document, QFileInfo(fileName).baseName(), &file, progress);
+    if (!result.ok) {
+        file.cancelWriting(); // Leaves any previous export in place
+        return result;
+    }
+    if (!file.commit()) {
+        result.ok = false;
+        result.errorString = file.errorString();
+    }
+    return result;
+}
+
+Result exportToFile(QStringView markdown, const QString &fileName, const ProgressCallback &progress)
+{
+    cmark_node *document = parse(markdown);
+    Result result = exportDocument(document, fileName, progress);
+    cmark_node_free(document);
+    return result;
+}
+
+}
@@ -0,0 +1,164 @@
+#include "linediff.h"
+#include <QHash>
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// Myers keeps one snapshot of its frontier per edit, which is quadratic in
+// the edit distance; beyond this the middle is replaced as one hunk.
+const int MaxEditDistance = 2048;
+
+enum class Op : char { Equal, Delete, Insert };
+
+// Shortest edit script from a to b, or an empty vector if it exceeds MaxEditDistance
+std::vector<Op> shortestEditScript(const std::vector<int> &a, const std::vector<int> &b, bool *tooLarge)
+{
+    const int n = int(a.size());
+    const int m = int(b.size());
+    const int maxD = std::min(n + m, MaxEditDistance);
+    const int offset = maxD + 1;
+    std::vector<int> v(2 * offset + 1, 0);
+    std::vector<std::vector<int>> trace; // trace[d] holds v[-d..d] before step d
+
+    int finalD = -1;
+    for (int d = 0; d <= maxD && finalD < 0; ++d) {
+        trace.emplace_back(v.begin() + offset - d, v.begin() + offset + d + 1);
+        for (int k = -d; k <= d; k += 2) {
+            int x;
+            if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) {
+                x = v[offset + k + 1]; // Down: insertion
+            } else {
+                x = v[offset + k - 1] + 1; // Right: deletion
+            }
+            int y = x - k;
+            while (x < n && y < m && a[x] == b[y]) {
+                ++x;
+                ++y;
+            }
+            v[offset + k] = x;
+            if (x >= n && y >= m) {
+                finalD = d;
+                break;
+            }
+        }
+    }
+
+    *tooLarge = finalD < 0;
+    if (*tooLarge) {
+        return {};
+    }
+
+    // Walk the snapshots backwards from (n, m) to recover the path
+    std::vector<Op> script;
+    int x = n;
+    int y = m;
+    for (int d = finalD; d > 0; --d) {
+        const std::vector<int> &previous = trace[d];
+        auto at = [&previous, d](int k) { return previous[k + d]; };
+        const int k = x - y;
+        const bool down = k == -d || (k != d && at(k - 1) < at(k + 1));
+        const int previousK = down ? k + 1 : k - 1;
+        const int previousX = at(previousK);
+        const int previousY = previousX - previousK;
+        while (x > previousX && y > previousY) {
+            script.push_back(Op::Equal);
+            --x;
+            --y;
+        }
+        script.push_back(down ? Op::Insert : Op::Delete);
+        x = previousX;
+        y = previousY;
+    }
+    while (x > 0 && y > 0) {
+        script.push_back(Op::Equal);
+        --x;
+        --y;
+    }
+    std::reverse(script.begin(), script.end());
+    return script;
+}
+
+} // namespace
+
+namespace LineDiff
+{
+
+QVector<Hunk> diff(const QStringList &oldLines, const QStringList &newLines)
+{
+    const int oldSize = int(oldLines.size());
+    const int newSize = int(newLines.size());
+
+    int prefix = 0;
+    while (prefix < oldSize && prefix < newSize && oldLines[prefix] == newLines[prefix]) {
+        ++prefix;
+    }
+    int suffix = 0;
+    while (suffix < oldSize - prefix && suffix < newSize - prefix
+           && oldLines[oldSize - 1 - suffix] == newLines[newSize - 1 - suffix]) {
+        ++suffix;
+    }
+
+    QVector<Hunk> hunks;
+    const int oldMiddle = oldSize - prefix - suffix;
+    const int newMiddle = newSize - prefix - suffix;
+    if (oldMiddle == 0 && newMiddle == 0) {
+        return hunks;
+    }
+
+    // Compare integers instead of strings in the inner loop
+    QHash<QString, int> ids;
+    std::vector<int> a(oldMiddle);
+    std::vector<int> b(newMiddle);
+    for (int i = 0; i < oldMiddle; ++i) {
+        auto it = ids.find(oldLines[prefix + i]);
+        if (it == ids.end()) {
+            it = ids.insert(oldLines[prefix + i], int(ids.size()));
+        }
+        a[i] = it.value();
+    }
+    for (int i = 0; i < newMiddle; ++i) {
+        auto it = ids.constFind(newLines[prefix + i]);
+        b[i] = it != ids.constEnd() ? it.value() : -1 - i; // Lines only in the new text never match
+    }
+
+    bool tooLarge = false;
+    const std::vector<Op> script = shortestEditScript(a, b, &tooLarge);
+    if (tooLarge) {
+        hunks.append({ prefix, oldMiddle, prefix, newMiddle });
+        return hunks;
+    }
+
+    int x = prefix;
+    int y = prefix;
+    Hunk current;
+    bool open = false;
+    for (Op op : script) {
+        if (op == Op::Equal) {
+            if (open) {
+                hunks.append(current);
+                open = false;
+            }
+            ++x;
+            ++y;
+            continue;
+        }
+        if (!open) {
+            current = { x, 0, y, 0 };
+            open = true;
+        }
+        if (op == Op::Delete) {
+            ++current.oldCount;
+            ++x;
+        } else {
+            ++current.newCount;
+            ++y;
+        }
+    }
+    if (open) {
+        hunks.append(current);
+    }
+    return hunks;
+}
+
+}
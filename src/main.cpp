@@ -1,5 +1,6 @@
 #include <QApplication>
 #include "mainwindow.h"
+#include "batchexporter.h"
 #include <QIcon>
 #include <QCommandLineParser>
 #include <QFile>
@@ -8,6 +9,11 @@
 
 int main(int argc, char *argv[])
 {
+    // `scriber --export` converts files headlessly and never opens a window
+    if (BatchExporter::isExportCommand(argc, argv)) {
+        return BatchExporter::run(argc, argv);
+    }
+
     QApplication app(argc, argv);
 
     app.setApplicationName("Scriber");
@@ -17,6 +23,9 @@ int main(int argc, char *argv[])
 
     MainWindow window;
 
+    // Documents left unsaved by a crash come back before anything else opens
+    const bool recovered = window.recoverUnsavedDocuments();
+
     // Process command line arguments
     QCommandLineParser parser;
     parser.setApplicationDescription("Distraction-free Markdown Editor");
@@ -52,7 +61,7 @@ int main(int argc, char *argv[])
         } else {
             qWarning() << "File does not exist:" << filePath;
         }
-    } else {
+    } else if (!recovered) {
         // No file specified, create an empty untitled document
         window.newFile();
     }
@@ -4,11 +4,16 @@
 #include "filemanager.h"
 #include "findbarwidget.h"
 #include "documentoutlinewidget.h"
+#include "findinfileswidget.h"
 #include "sidebarfileexplorer.h"
 #include "toastnotification.h"
 #include "thememanager.h"
 #include "themedialog.h"
-#include "outlinedelegate.h"
+#include "documentloader.h"
+#include "taskprogresswidget.h"
+#include "editjournal.h"
+#include "outlineindex.h"
+#include "documentstats.h"
 #include <QMenuBar>
 #include <QMenu>
 #include <QAction>
@@ -24,11 +29,15 @@
 #include <QActionGroup>
 #include <QKeyEvent>
 #include <QTimer>
+#include <QEventLoop>
+#include <QFileSystemWatcher>
+#include <QPointer>
 #include <QDockWidget>
 #include <QTreeWidget>
 #include <QTreeWidgetItem>
 #include <QVBoxLayout>
 #include <cmark.h>
+#include <utility>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -36,10 +45,12 @@ MainWindow::MainWindow(QWidget *parent)
     , fileManager(nullptr)
     , fileExplorer(nullptr)
     , outlineWidget(nullptr)
+    , findInFilesWidget(nullptr)
     , findBarWidget(nullptr)
     , toast(nullptr)
-    , outlineDelegate(nullptr)
-    , outlineTimer(nullptr)
+    , taskProgress(nullptr)
+    , fileWatcher(nullptr)
+    , reloadTimer(nullptr)
     , wordCountTimer(nullptr)
 {
     fileManager = new FileManager(this);
@@ -75,16 +86,20 @@ MainWindow::MainWindow(QWidget *parent)
     loadSettings();
 
     // Initialize timers
-    outlineTimer = new QTimer(this);
-    outlineTimer->setSingleShot(true);
-    outlineTimer->setInterval(1000);
-    connect(outlineTimer, &QTimer::timeout, this, &MainWindow::updateOutline);
-
     wordCountTimer = new QTimer(this);
     wordCountTimer->setSingleShot(true);
-    wordCountTimer->setInterval(1000);
+    wordCountTimer->setInterval(150);
     connect(wordCountTimer, &QTimer::timeout, this, &MainWindow::updateWordCount);
 
+    // Watch open files for changes made by other programs
+    fileWatcher = new QFileSystemWatcher(this);
+    connect(fileWatcher, &QFileSystemWatcher::fileChanged, this, &MainWindow::onFileChangedOnDisk);
+
+    reloadTimer = new QTimer(this);
+    reloadTimer->setSingleShot(true);
+    reloadTimer->setInterval(300);
+    connect(reloadTimer, &QTimer::timeout, this, &MainWindow::reloadChangedFiles);
+
     // Connect tab signals
     connect(tabWidget, &QTabWidget::currentChanged, this, &MainWindow::onTabChanged);
     connect(tabWidget, &QTabWidget::tabCloseRequested, this, &MainWindow::closeTab);
@@ -123,6 +138,11 @@ MainWindow::~MainWindow()
 
 void MainWindow::closeEvent(QCloseEvent *event)
 {
+    // Let saves already in flight finish before deciding what is unsaved
+    for (const EditorTab &tab : std::as_const(editorTabs)) {
+        waitForSave(tab.editor);
+    }
+
     for (int i = editorTabs.size() - 1; i >= 0; --i) {
         const EditorTab &tab = editorTabs[i];
         // Only warn if document is modified AND has content (not empty)
@@ -135,7 +155,7 @@ void MainWindow::closeEvent(QCloseEvent *event)
                                    QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);
             switch (ret) {
             case QMessageBox::Save:
-                if (!save()) {
+                if (!save() || !waitForSave(tab.editor)) {
                     event->ignore();
                     return;
                 }
@@ -162,6 +182,10 @@ void MainWindow::newFile()
     tab.editor = newEditor;
     tab.filePath = QString();
     tab.isModified = false;
+    tab.journal = new EditJournal(newEditor);
+    tab.outline = new OutlineIndex(newEditor);
+    tab.stats = new DocumentStats(newEditor);
+    connect(tab.stats, &DocumentStats::changed, this, &MainWindow::updateWordCount);
     editorTabs.append(tab);
 
     int tabIndex = tabWidget->addTab(newEditor, tr("Untitled"));
@@ -170,6 +194,60 @@ void MainWindow::newFile()
     updateWindowTitle();
 }
 
+bool MainWindow::recoverUnsavedDocuments()
+{
+    const QList<EditJournal::Recovery> recoveries = EditJournal::findOrphans();
+    if (recoveries.isEmpty()) {
+        return false;
+    }
+
+    QStringList names;
+    for (const EditJournal::Recovery &recovery : recoveries) {
+        names << (recovery.filePath.isEmpty() ? tr("Untitled")
+                                              : QDir::toNativeSeparators(recovery.filePath));
+    }
+    const QMessageBox::StandardButton ret = QMessageBox::question(this, tr("Scriber"),
+                               tr("Scriber did not shut down properly. Unsaved changes were found for:\n\n"
+                                  "%1\n\nDo you want to recover them?").arg(names.join('\n')),
+                               QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes);
+
+    for (const EditJournal::Recovery &recovery : recoveries) {
+        if (ret == QMessageBox::Yes) {
+            EditorWidget *newEditor = new EditorWidget(tabWidget);
+            setupEditorConnections(newEditor);
+
+            EditorTab tab;
+            tab.editor = newEditor;
+            tab.filePath = recovery.filePath;
+            tab.isModified = true;
+            tab.journal = new EditJournal(newEditor);
+            tab.journal->setFilePath(recovery.filePath);
+            tab.outline = new OutlineIndex(newEditor);
+            tab.stats = new DocumentStats(newEditor);
+            connect(tab.stats, &DocumentStats::changed, this, &MainWindow::updateWordCount);
+            editorTabs.append(tab);
+
+            QString title = recovery.filePath.isEmpty() ? tr("Untitled") : QFileInfo(recovery.filePath).fileName();
+            int tabIndex = tabWidget->addTab(newEditor, title);
+            tabWidget->setCurrentIndex(tabIndex);
+
+            newEditor->beginIncrementalLoad();
+            newEditor->appendMarkdownChunk(recovery.text);
+            newEditor->endIncrementalLoad();
+            newEditor->document()->setModified(true);
+
+            // The recovered text exists nowhere else until it is saved
+            tab.journal->recordSnapshot();
+            watchFile(recovery.filePath);
+            updateTabTitle(tabIndex);
+        }
+        EditJournal::discard(recovery.journalPath);
+    }
+
+    updateWindowTitle();
+    return ret == QMessageBox::Yes;
+}
+
 void MainWindow::open()
 {
     if (maybeSaveCurrentTab()) {
@@ -197,7 +275,8 @@ void MainWindow::openFileInNewTab(const QString &fileName)
 
     EditorWidget *newEditor = new EditorWidget(tabWidget);
 
-    if (!fileManager->loadFile(fileName, newEditor)) {
+    DocumentLoader *loader = fileManager->loadFile(fileName, newEditor);
+    if (!loader) {
         delete newEditor;
         return;
     }
@@ -208,6 +287,11 @@ void MainWindow::openFileInNewTab(const QString &fileName)
     tab.editor = newEditor;
     tab.filePath = fileName;
     tab.isModified = false;
+    tab.journal = new EditJournal(newEditor);
+    tab.journal->setFilePath(fileName);
+    tab.outline = new OutlineIndex(newEditor);
+    tab.stats = new DocumentStats(newEditor);
+    connect(tab.stats, &DocumentStats::changed, this, &MainWindow::updateWordCount);
     editorTabs.append(tab);
 
     int tabIndex = tabWidget->addTab(newEditor, QFileInfo(fileName).fileName());
@@ -215,21 +299,65 @@ void MainWindow::openFileInNewTab(const QString &fileName)
 
     updateWindowTitle();
 
+    // Large files keep loading in the background; cancelling closes the tab
+    int taskId = taskProgress->startTask(tr("Opening %1").arg(QFileInfo(fileName).fileName()),
+                                         [loader]() { loader->cancel(); });
+    connect(loader, &DocumentLoader::progress, taskProgress, [this, taskId](qint64 done, qint64 total) {
+        taskProgress->setTaskProgress(taskId, done, total);
+    });
+    connect(loader, &QObject::destroyed, taskProgress, [this, taskId]() {
+        taskProgress->finishTask(taskId);
+    });
+    connect(loader, &DocumentLoader::finished, this, [this, fileName]() {
+        watchFile(fileName);
+    });
+    connect(loader, &DocumentLoader::canceled, this, [this, newEditor]() {
+        for (int i = 0; i < editorTabs.size(); ++i) {
+            if (editorTabs[i].editor == newEditor) {
+                closeTab(i);
+                break;
+            }
+        }
+    });
+
     // Make sure sidebar is visible when opening a file
     if (sidebarDock && !sidebarDock->isVisible()) {
         sidebarDock->show();
     }
 }
 
+void MainWindow::openSearchHit(const QString &fileName, int line, int column, int length)
+{
+    openFileInNewTab(fileName);
+    const int index = tabWidget->currentIndex();
+    if (index < 0 || index >= editorTabs.size() || editorTabs[index].filePath != fileName) {
+        return; // The file could not be opened
+    }
+
+    // A file still loading is selected in once it is complete
+    EditorWidget *editor = editorTabs[index].editor;
+    if (editor->isLoading()) {
+        connect(editor, &EditorWidget::loadFinished, editor, [editor, line, column, length]() {
+            editor->selectRawText(line, column, length);
+        }, Qt::SingleShotConnection);
+    } else {
+        editor->selectRawText(line, column, length);
+    }
+    editor->setFocus();
+}
+
 void MainWindow::setupEditorConnections(EditorWidget *editor)
 {
     connect(editor->document(), &QTextDocument::modificationChanged,
             this, &MainWindow::documentWasModified);
 
-    connect(editor, &QTextEdit::textChanged, [this]() {
-        outlineTimer->start();
-        wordCountTimer->start();
-    });
+    // Totals update with every edit; selections are counted once they settle
+    connect(editor, &QTextEdit::selectionChanged, wordCountTimer, QOverload<>::of(&QTimer::start));
+
+    // Words added for the open folder are shared by every tab in it
+    if (fileExplorer) {
+        editor->setWorkspacePath(fileExplorer->currentPath());
+    }
 
     // Connect find bar to editor
     connect(findBarWidget, &FindBarWidget::findNextRequested, [this, editor]() {
@@ -248,13 +376,7 @@ bool MainWindow::save()
         return saveAs();
     }
 
-    if (fileManager->saveFile(tab.filePath, tab.editor)) {
-        tab.isModified = false;
-        updateTabTitle(currentIndex);
-        updateWindowTitle();
-        return true;
-    }
-    return false;
+    return startSave(currentIndex, tab.filePath);
 }
 
 bool MainWindow::saveAs()
@@ -262,8 +384,6 @@ bool MainWindow::saveAs()
     int currentIndex = tabWidget->currentIndex();
     if (currentIndex < 0) return false;
 
-    EditorTab &tab = editorTabs[currentIndex];
-
     QString fileName = QFileDialog::getSaveFileName(this,
                                                     tr("Save As"), "",
                                                     tr("Markdown Files (*.md);;Text Files (*.txt);;All Files (*)"));
@@ -275,14 +395,255 @@ bool MainWindow::saveAs()
          fileName += ".md";
     }
 
-    if (fileManager->saveFile(fileName, tab.editor)) {
-        tab.filePath = fileName;
-        tab.isModified = false;
-        updateTabTitle(currentIndex);
-        updateWindowTitle();
+    return startSave(currentIndex, fileName);
+}
+
+void MainWindow::saveAll()
+{
+    // Saves of different tabs run concurrently on the thread pool
+    for (int i = 0; i < editorTabs.size(); ++i) {
+        const EditorTab &tab = editorTabs[i];
+        if (!tab.editor || !tab.editor->document()->isModified()) {
+            continue;
+        }
+        if (tab.filePath.isEmpty()) {
+            tabWidget->setCurrentIndex(i);
+            saveAs();
+        } else {
+            startSave(i, tab.filePath);
+        }
+    }
+}
+
+bool MainWindow::startSave(int index, const QString &fileName)
+{
+    if (index < 0 || index >= editorTabs.size()) return false;
+
+    EditorWidget *editor = editorTabs[index].editor;
+    if (!editor) return false;
+
+    // A save already in flight for this tab is followed by another one, so
+    // the file ends up with the latest content and writes never overlap.
+    auto it = pendingSaves.find(editor);
+    if (it != pendingSaves.end()) {
+        it->saveAgain = true;
+        it->nextFileName = fileName;
         return true;
     }
-    return false;
+
+    PendingSave pending;
+    pending.fileName = fileName;
+    pending.revision = editor->contentRevision();
+    pending.watcher = new QFutureWatcher<FileManager::SaveResult>(this);
+    connect(pending.watcher, &QFutureWatcherBase::finished, this, [this, editor]() {
+        onSaveFinished(editor);
+    });
+    pendingSaves.insert(editor, pending);
+    pending.watcher->setFuture(fileManager->saveFileAsync(fileName, editor));
+
+    updateTabTitle(index);
+    return true;
+}
+
+void MainWindow::onSaveFinished(EditorWidget *editor)
+{
+    auto it = pendingSaves.find(editor);
+    if (it == pendingSaves.end()) return;
+
+    const PendingSave pending = it.value();
+    pendingSaves.erase(it);
+    const FileManager::SaveResult result = pending.watcher->result();
+    pending.watcher->deleteLater();
+
+    // The tab may have been closed while the save was running
+    int index = indexOfEditor(editor);
+    if (index >= 0) {
+        EditorTab &tab = editorTabs[index];
+        if (result.ok) {
+            const QString previousPath = tab.filePath;
+            tab.filePath = pending.fileName;
+            tab.journal->setFilePath(pending.fileName);
+            if (previousPath != pending.fileName) {
+                unwatchFile(previousPath);
+            }
+            watchFile(pending.fileName);
+            // Our version is the one just written; a change since then is someone else's
+            DiskState written;
+            written.size = result.size;
+            written.modified = result.modified;
+            knownDiskStates.insert(pending.fileName, written);
+            // Edits made during the save keep the document modified
+            if (editor->contentRevision() == pending.revision) {
+                editor->document()->setModified(false);
+                tab.isModified = false;
+            }
+            tab.journal->documentSaved();
+            statusBar()->showMessage(tr("Saved %1").arg(QFileInfo(pending.fileName).fileName()), 2000);
+        } else {
+            QMessageBox::warning(this, tr("Scriber"),
+                                 tr("Cannot write file %1:\n%2.")
+                                 .arg(QDir::toNativeSeparators(pending.fileName), result.errorString));
+        }
+
+        if (pending.saveAgain) {
+            startSave(index, pending.nextFileName);
+        }
+
+        updateTabTitle(index);
+        updateWindowTitle();
+    }
+
+    emit saveFinished(editor);
+}
+
+bool MainWindow::waitForSave(EditorWidget *editor)
+{
+    if (pendingSaves.contains(editor)) {
+        // Keep repainting while the disk catches up, but take no input
+        QEventLoop loop;
+        connect(this, &MainWindow::saveFinished, &loop, [this, &loop, editor]() {
+            if (!pendingSaves.contains(editor)) {
+                loop.quit();
+            }
+        });
+        loop.exec(QEventLoop::ExcludeUserInputEvents);
+    }
+    return editor && !editor->document()->isModified();
+}
+
+void MainWindow::watchFile(const QString &path)
+{
+    if (path.isEmpty() || !QFileInfo::exists(path)) return;
+
+    if (!fileWatcher->files().contains(path)) {
+        fileWatcher->addPath(path);
+    }
+    rememberDiskState(path);
+}
+
+void MainWindow::unwatchFile(const QString &path)
+{
+    if (path.isEmpty()) return;
+
+    for (const EditorTab &tab : std::as_const(editorTabs)) {
+        if (tab.filePath == path) {
+            return; // Still open in another tab
+        }
+    }
+    fileWatcher->removePath(path);
+    knownDiskStates.remove(path);
+    changedFiles.remove(path);
+}
+
+void MainWindow::rememberDiskState(const QString &path)
+{
+    QFileInfo info(path);
+    DiskState state;
+    state.size = info.size();
+    state.modified = info.lastModified();
+    knownDiskStates.insert(path, state);
+}
+
+void MainWindow::onFileChangedOnDisk(const QString &path)
+{
+    // A write often arrives as several notifications; handle the burst once
+    changedFiles.insert(path);
+    reloadTimer->start();
+}
+
+void MainWindow::reloadChangedFiles()
+{
+    const QSet<QString> paths = std::exchange(changedFiles, QSet<QString>());
+    bool deferred = false;
+    for (const QString &path : paths) {
+        int index = -1;
+        for (int i = 0; i < editorTabs.size(); ++i) {
+            if (editorTabs[i].filePath == path) {
+                index = i;
+                break;
+            }
+        }
+        if (index < 0) continue;
+
+        const QFileInfo info(path);
+        if (!info.exists()) {
+            statusBar()->showMessage(tr("%1 was removed from disk").arg(info.fileName()), 5000);
+            continue;
+        }
+        // Replacing the file by renaming another over it ends the watch
+        if (!fileWatcher->files().contains(path)) {
+            fileWatcher->addPath(path);
+        }
+
+        EditorWidget *editor = editorTabs[index].editor;
+        if (!editor) continue;
+        if (editor->isLoading() || pendingSaves.contains(editor)) {
+            // Looked at again once the load or save is done, so a change
+            // made meanwhile by another program is not lost
+            changedFiles.insert(path);
+            deferred = true;
+            continue;
+        }
+
+        // Our own saves, and versions the user declined, are not reloaded
+        const DiskState known = knownDiskStates.value(path);
+        if (known.size == info.size() && known.modified == info.lastModified()) continue;
+        rememberDiskState(path);
+
+        if (editor->document()->isModified()) {
+            tabWidget->setCurrentIndex(index);
+            const QMessageBox::StandardButton ret = QMessageBox::question(this, tr("Scriber"),
+                                   tr("%1 has changed on disk.\n"
+                                      "Do you want to reload it and discard your unsaved changes?").arg(info.fileName()),
+                                   QMessageBox::Yes | QMessageBox::No, QMessageBox::No);
+            if (ret != QMessageBox::Yes) continue;
+        }
+
+        startReload(editor, path);
+    }
+
+    if (deferred) {
+        reloadTimer->start();
+    }
+}
+
+void MainWindow::startReload(EditorWidget *editor, const QString &path)
+{
+    // Reading and diffing run on the pool; only the changed lines are
+    // applied to the document, so render state and undo history survive.
+    QPointer<EditorWidget> target(editor);
+    const quint64 revision = editor->contentRevision();
+    auto *watcher = new QFutureWatcher<FileManager::ReloadResult>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, target, revision, path]() {
+        watcher->deleteLater();
+        const FileManager::ReloadResult result = watcher->result();
+        if (!target || indexOfEditor(target) < 0) return;
+
+        if (!result.ok) {
+            statusBar()->showMessage(tr("Cannot reload %1: %2").arg(QFileInfo(path).fileName(), result.errorString), 5000);
+            return;
+        }
+        if (target->contentRevision() != revision) {
+            startReload(target, path); // Edited while the diff ran
+            return;
+        }
+
+        target->applyLineChanges(result.hunks, result.lines);
+        target->setFileFormat(result.format);
+        target->document()->setModified(false);
+        statusBar()->showMessage(tr("Reloaded %1").arg(QFileInfo(path).fileName()), 2000);
+    });
+    watcher->setFuture(fileManager->diffWithDiskAsync(path, editor));
+}
+
+int MainWindow::indexOfEditor(EditorWidget *editor) const
+{
+    for (int i = 0; i < editorTabs.size(); ++i) {
+        if (editorTabs[i].editor == editor) {
+            return i;
+        }
+    }
+    return -1;
 }
 
 void MainWindow::exportToHtml() {
@@ -295,7 +656,31 @@ void MainWindow::exportToHtml() {
     if (!fileName.isEmpty()) {
         if (!fileName.endsWith(".html", Qt::CaseInsensitive))
             fileName += ".html";
-        fileManager->exportToHtml(fileName, tab.editor);
+
+        const QString name = QFileInfo(fileName).fileName();
+        auto *watcher = new QFutureWatcher<HtmlExporter::Result>(this);
+        int taskId = taskProgress->startTask(tr("Exporting %1").arg(name), [watcher]() { watcher->cancel(); });
+        connect(watcher, &QFutureWatcherBase::progressValueChanged, taskProgress, [this, taskId](int value) {
+            taskProgress->setTaskProgress(taskId, value, 1000);
+        });
+        connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, taskId, fileName, name]() {
+            taskProgress->finishTask(taskId);
+            watcher->deleteLater();
+            // A cancelled export leaves any previous file untouched
+            if (watcher->isCanceled() || watcher->future().resultCount() == 0) {
+                statusBar()->showMessage(tr("Export of %1 canceled").arg(name), 2000);
+                return;
+            }
+            const HtmlExporter::Result result = watcher->result();
+            if (result.ok) {
+                statusBar()->showMessage(tr("Exported %1").arg(name), 2000);
+            } else if (!result.canceled) {
+                QMessageBox::warning(this, tr("Scriber"),
+                                     tr("Cannot write file %1:\n%2.")
+                                     .arg(QDir::toNativeSeparators(fileName), result.errorString));
+            }
+        });
+        watcher->setFuture(fileManager->exportToHtmlAsync(fileName, tab.editor));
     }
 }
 
@@ -309,7 +694,31 @@ void MainWindow::exportToPdf() {
     if (!fileName.isEmpty()) {
         if (!fileName.endsWith(".pdf", Qt::CaseInsensitive))
             fileName += ".pdf";
-        fileManager->exportToPdf(fileName, tab.editor);
+
+        const QString name = QFileInfo(fileName).fileName();
+        auto *watcher = new QFutureWatcher<PdfExporter::Result>(this);
+        int taskId = taskProgress->startTask(tr("Exporting %1").arg(name), [watcher]() { watcher->cancel(); });
+        connect(watcher, &QFutureWatcherBase::progressValueChanged, taskProgress, [this, taskId](int value) {
+            taskProgress->setTaskProgress(taskId, value, 1000);
+        });
+        connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, taskId, fileName, name]() {
+            taskProgress->finishTask(taskId);
+            watcher->deleteLater();
+            // A cancelled export leaves any previous file untouched
+            if (watcher->isCanceled() || watcher->future().resultCount() == 0) {
+                statusBar()->showMessage(tr("Export of %1 canceled").arg(name), 2000);
+                return;
+            }
+            const PdfExporter::Result result = watcher->result();
+            if (result.ok) {
+                statusBar()->showMessage(tr("Exported %1 (%n page(s))", nullptr, result.pageCount).arg(name), 2000);
+            } else if (!result.canceled) {
+                QMessageBox::warning(this, tr("Scriber"),
+                                     tr("Cannot write file %1:\n%2.")
+                                     .arg(QDir::toNativeSeparators(fileName), result.errorString));
+            }
+        });
+        watcher->setFuture(fileManager->exportToPdfAsync(fileName, tab.editor));
     }
 }
 
@@ -337,6 +746,18 @@ void MainWindow::find()
     }
 }
 
+void MainWindow::replace()
+{
+    findBarWidget->showReplaceBar();
+}
+
+void MainWindow::findInFiles()
+{
+    sidebarDock->show();
+    sidebarTabs->setCurrentWidget(findInFilesWidget);
+    findInFilesWidget->focusQuery();
+}
+
 bool MainWindow::isFindBarVisible() const
 {
     return findBarWidget && findBarWidget->isFindBarVisible();
@@ -346,6 +767,7 @@ void MainWindow::onTabChanged(int index)
 {
     updateActionsState();
     if (index >= 0 && index < editorTabs.size()) {
+        refreshAnalysis(editorTabs[index]);
         updateWindowTitle();
         updateWordCount();
         updateOutline();
@@ -371,7 +793,7 @@ void MainWindow::closeTab(int index)
                                QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);
         switch (ret) {
         case QMessageBox::Save:
-            if (!save()) return;
+            if (!save() || !waitForSave(tab.editor)) return;
             break;
         case QMessageBox::Cancel:
             return;
@@ -380,12 +802,24 @@ void MainWindow::closeTab(int index)
         }
     }
 
+    // A save still in flight reports back by editor; let it land before the
+    // editor goes, or a tab opened later at the same address would take it
+    if (tab.editor && pendingSaves.contains(tab.editor)) {
+        waitForSave(tab.editor);
+    }
+    // Saves may have moved the tab or given it a new path
+    index = indexOfEditor(tab.editor);
+    if (index < 0) return;
+    tab = editorTabs[index];
+
     tabWidget->blockSignals(true);
     QWidget *widget = tabWidget->widget(index);
     tabWidget->removeTab(index);
     editorTabs.removeAt(index);
     tabWidget->blockSignals(false);
 
+    unwatchFile(tab.filePath);
+
     delete widget;
 
     updateActionsState();
@@ -418,7 +852,7 @@ bool MainWindow::maybeSaveCurrentTab()
                                QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);
     switch (ret) {
     case QMessageBox::Save:
-        return save();
+        return save() && waitForSave(tab.editor);
     case QMessageBox::Cancel:
         return false;
     default:
@@ -446,7 +880,7 @@ bool MainWindow::maybeSave()
                                QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);
     switch (ret) {
     case QMessageBox::Save:
-        return save();
+        return save() && waitForSave(tab.editor);
     case QMessageBox::Cancel:
         return false;
     default:
@@ -481,6 +915,9 @@ void MainWindow::updateTabTitle(int index)
     if (tab.editor && tab.editor->document()->isModified()) {
         fileName = "*" + fileName;
     }
+    if (tab.editor && pendingSaves.contains(tab.editor)) {
+        fileName = tr("%1 (saving...)").arg(fileName);
+    }
 
     tabWidget->setTabText(index, fileName);
 }
@@ -504,10 +941,12 @@ void MainWindow::updateActionsState()
     bool hasTabs = editorTabs.size() > 0;
     saveAct.setEnabled(hasTabs);
     saveAsAct.setEnabled(hasTabs);
+    saveAllAct.setEnabled(hasTabs);
     exportHtmlAct.setEnabled(hasTabs);
     exportPdfAct.setEnabled(hasTabs);
     closeTabAct.setEnabled(hasTabs);
     findAct.setEnabled(hasTabs);
+    replaceAct.setEnabled(hasTabs);
 }
 
 void MainWindow::createStatusBar() {
@@ -534,6 +973,9 @@ void MainWindow::createStatusBar() {
     wordCountLabel = new QLabel(tr("Words: 0"));
     charCountLabel = new QLabel(tr("Chars: 0"));
 
+    taskProgress = new TaskProgressWidget(this);
+    statusBar()->addPermanentWidget(taskProgress);
+
     statusBar()->addPermanentWidget(wordCountLabel);
     statusBar()->addPermanentWidget(charCountLabel);
 
@@ -544,22 +986,23 @@ void MainWindow::updateWordCount() {
     int currentIndex = tabWidget->currentIndex();
     if (currentIndex < 0 || currentIndex >= editorTabs.size()) return;
 
-    EditorWidget *currentEditor = editorTabs[currentIndex].editor;
-    if (!currentEditor) return;
-
-    int charCount = currentEditor->document()->characterCount() - 1;
-    if (charCount < 0) charCount = 0;
+    const EditorTab &tab = editorTabs[currentIndex];
+    if (!tab.editor || !tab.stats) return;
 
-    charCountLabel->setText(tr("Chars: %1").arg(charCount));
+    // Kept current by DocumentStats, so exact for documents of any size
+    const TextStats::Counts totals = tab.stats->totals();
 
-    if (charCount > 500000) {
-        wordCountLabel->setText(tr("Words: ..."));
+    const QTextCursor cursor = tab.editor->textCursor();
+    if (cursor.hasSelection()) {
+        // The selection is counted as shown, rendered blocks included
+        const TextStats::Counts selected = TextStats::count(cursor.selectedText());
+        wordCountLabel->setText(tr("Words: %1 of %2").arg(selected.words).arg(totals.words));
+        charCountLabel->setText(tr("Chars: %1 of %2").arg(selected.characters).arg(totals.characters));
         return;
     }
 
-    QString text = currentEditor->getRawMarkdown();
-    int wordCount = text.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts).size();
-    wordCountLabel->setText(tr("Words: %1").arg(wordCount));
+    wordCountLabel->setText(tr("Words: %1").arg(totals.words));
+    charCountLabel->setText(tr("Chars: %1").arg(totals.characters));
 }
 
 void MainWindow::openFile(const QString &path)
@@ -589,26 +1032,24 @@ void MainWindow::createSidebar()
     fileExplorer = new SidebarFileExplorer(sidebarTabs);
     connect(fileExplorer, &SidebarFileExplorer::fileActivated, this, &MainWindow::openFileInNewTab);
     connect(fileExplorer, &SidebarFileExplorer::directoryChanged, [this](const QString &path) {
-        // Handle directory change if needed
+        for (const EditorTab &tab : std::as_const(editorTabs)) {
+            tab.editor->setWorkspacePath(path);
+        }
+        findInFilesWidget->setRootPath(path);
     });
     sidebarTabs->addTab(fileExplorer, tr("Files"));
 
     // Outline tab
     outlineWidget = new DocumentOutlineWidget(sidebarTabs);
-    
-    // Set up custom delegate for theme-aware arrow icons
-    outlineDelegate = new OutlineDelegate(outlineWidget);
-    outlineWidget->setItemDelegate(outlineDelegate);
-    
-    // Connect to theme changes
-    connect(ThemeManager::instance(), &ThemeManager::themeChanged, this, [this]() {
-        outlineDelegate->setArrowColor(ThemeManager::instance()->textColor());
-        outlineWidget->viewport()->update();
-    });
-    outlineDelegate->setArrowColor(ThemeManager::instance()->textColor());
-    
     sidebarTabs->addTab(outlineWidget, tr("Outline"));
 
+    // Search tab: the notes shown in the file explorer
+    findInFilesWidget = new FindInFilesWidget(sidebarTabs);
+    findInFilesWidget->setNameFilters(fileExplorer->nameFilters());
+    findInFilesWidget->setRootPath(fileExplorer->currentPath());
+    connect(findInFilesWidget, &FindInFilesWidget::hitActivated, this, &MainWindow::openSearchHit);
+    sidebarTabs->addTab(findInFilesWidget, tr("Search"));
+
     sidebarDock->setWidget(sidebarTabs);
     addDockWidget(Qt::LeftDockWidgetArea, sidebarDock);
     sidebarDock->show(); // Show sidebar by default
@@ -618,6 +1059,22 @@ void MainWindow::createSidebar()
     toggleSidebarAct->setStatusTip(tr("Show or hide the sidebar"));
 }
 
+void MainWindow::refreshAnalysis(const EditorTab &tab)
+{
+    // Outline and statistics follow every edit of their tab, in the background
+    // too, so switching tabs only rebinds them. They are recomputed only if
+    // the document changed in a way they did not see.
+    if (!tab.editor || tab.editor->isLoading()) return;
+
+    const quint64 revision = tab.editor->contentRevision();
+    if (tab.outline && tab.outline->revision() != revision) {
+        tab.outline->reset();
+    }
+    if (tab.stats && tab.stats->revision() != revision) {
+        tab.stats->reset();
+    }
+}
+
 void MainWindow::updateOutline()
 {
     if (!outlineWidget) return;
@@ -625,11 +1082,8 @@ void MainWindow::updateOutline()
     int currentIndex = tabWidget->currentIndex();
     if (currentIndex < 0 || currentIndex >= editorTabs.size()) return;
 
-    EditorWidget *currentEditor = editorTabs[currentIndex].editor;
-    if (!currentEditor) return;
-
-    outlineWidget->setEditor(currentEditor);
-    outlineWidget->updateOutline();
+    // The index follows its editor's edits; the widget only switches indexes
+    outlineWidget->setIndex(editorTabs[currentIndex].outline);
 }
 
 void MainWindow::documentWasModified()
@@ -669,6 +1123,11 @@ void MainWindow::createActions()
     saveAsAct.setStatusTip(tr("Save the document under a new name"));
     connect(&saveAsAct, &QAction::triggered, this, &MainWindow::saveAs);
 
+    saveAllAct.setText(tr("Save A&ll"));
+    saveAllAct.setShortcut(QKeySequence(Qt::CTRL | Qt::ALT | Qt::Key_S));
+    saveAllAct.setStatusTip(tr("Save all modified documents"));
+    connect(&saveAllAct, &QAction::triggered, this, &MainWindow::saveAll);
+
     exportHtmlAct.setText(tr("Export to &HTML..."));
     exportHtmlAct.setStatusTip(tr("Export the document to HTML"));
     connect(&exportHtmlAct, &QAction::triggered, this, &MainWindow::exportToHtml);
@@ -696,6 +1155,18 @@ void MainWindow::createActions()
     connect(&findAct, &QAction::triggered, this, &MainWindow::find);
     addAction(&findAct);
 
+    replaceAct.setText(tr("&Replace"));
+    replaceAct.setShortcuts(QKeySequence::Replace);
+    replaceAct.setStatusTip(tr("Replace text in the document"));
+    connect(&replaceAct, &QAction::triggered, this, &MainWindow::replace);
+    addAction(&replaceAct);
+
+    findInFilesAct.setText(tr("Find in &Files"));
+    findInFilesAct.setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_F));
+    findInFilesAct.setStatusTip(tr("Find text in the notes of the open folder"));
+    connect(&findInFilesAct, &QAction::triggered, this, &MainWindow::findInFiles);
+    addAction(&findInFilesAct);
+
     closeTabAct.setText(tr("&Close Tab"));
     closeTabAct.setShortcut(QKeySequence(Qt::CTRL | Qt::Key_W));
     closeTabAct.setStatusTip(tr("Close the current tab"));
@@ -712,6 +1183,7 @@ void MainWindow::createMenus()
     fileMenu->addAction(&openAct);
     fileMenu->addAction(&saveAct);
     fileMenu->addAction(&saveAsAct);
+    fileMenu->addAction(&saveAllAct);
     fileMenu->addSeparator();
     fileMenu->addAction(&exportHtmlAct);
     fileMenu->addAction(&exportPdfAct);
@@ -720,6 +1192,8 @@ void MainWindow::createMenus()
 
     QMenu *editMenu = menuBar()->addMenu(tr("&Edit"));
     editMenu->addAction(&findAct);
+    editMenu->addAction(&replaceAct);
+    editMenu->addAction(&findInFilesAct);
     editMenu->addAction(&closeTabAct);
 
     QMenu *viewMenu = menuBar()->addMenu(tr("&View"));
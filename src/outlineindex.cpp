@@ -0,0 +1,381 @@
+#include "outlineindex.h"
+#include "editorwidget.h"
+#include <QTextBlock>
+#include <algorithm>
+#include <cmark.h>
+
+namespace {
+
+// CommonMark allows up to three spaces before a heading, fence or underline
+const int MaxIndent = 3;
+
+const int MaxHeadingLevel = 6;
+const int MinFenceLength = 3;
+
+int leadingSpaces(QStringView line)
+{
+    int indent = 0;
+    while (indent < line.size() && line[indent] == QLatin1Char(' ')) {
+        ++indent;
+    }
+    return indent;
+}
+
+int runLength(QStringView text, QChar c)
+{
+    int length = 0;
+    while (length < text.size() && text[length] == c) {
+        ++length;
+    }
+    return length;
+}
+
+bool isBlank(QStringView text)
+{
+    return std::all_of(text.begin(), text.end(), [](QChar c) { return c.isSpace(); });
+}
+
+// "- item", "* item", "+ item", "1. item" and "1) item"
+bool isListItem(QStringView text)
+{
+    int marker = 0;
+    if (!text.isEmpty() && (text[0] == QLatin1Char('-') || text[0] == QLatin1Char('*') || text[0] == QLatin1Char('+'))) {
+        marker = 1;
+    } else {
+        while (marker < text.size() && marker < 9 && text[marker].isDigit()) {
+            ++marker;
+        }
+        if (marker == 0 || marker >= text.size()
+            || (text[marker] != QLatin1Char('.') && text[marker] != QLatin1Char(')'))) {
+            return false;
+        }
+        ++marker;
+    }
+    return marker == text.size() || text[marker] == QLatin1Char(' ') || text[marker] == QLatin1Char('\t');
+}
+
+// Text and code spans of the first heading in @p markdown, as the outline always showed them
+QString inlineText(const QByteArray &markdown)
+{
+    QString text;
+    cmark_node *document = cmark_parse_document(markdown.constData(), markdown.size(), CMARK_OPT_DEFAULT);
+    if (!document) {
+        return text;
+    }
+    cmark_node *heading = cmark_node_first_child(document);
+    if (heading && cmark_node_get_type(heading) == CMARK_NODE_HEADING) {
+        cmark_iter *iter = cmark_iter_new(heading);
+        while (cmark_iter_next(iter) != CMARK_EVENT_DONE) {
+            cmark_node *node = cmark_iter_get_node(iter);
+            if (cmark_node_get_type(node) == CMARK_NODE_TEXT || cmark_node_get_type(node) == CMARK_NODE_CODE) {
+                text += QString::fromUtf8(cmark_node_get_literal(node));
+            }
+        }
+        cmark_iter_free(iter);
+    }
+    cmark_node_free(document);
+    return text;
+}
+
+} // namespace
+
+OutlineIndex::OutlineIndex(EditorWidget *editor)
+    : QObject(editor), m_editor(editor)
+{
+    connect(editor, &EditorWidget::rawLinesChanged, this, &OutlineIndex::onRawLinesChanged);
+    connect(editor, &EditorWidget::loadFinished, this, &OutlineIndex::reset);
+    reset();
+}
+
+void OutlineIndex::reset()
+{
+    m_lines.clear();
+    m_headings.clear();
+    m_revision = m_editor->contentRevision();
+
+    if (!m_editor->isLoading()) {
+        const QStringList lines = m_editor->getRawMarkdown().split(QLatin1Char('\n'));
+        m_lines.reserve(lines.size());
+        LineState previous;
+        for (const QString &line : lines) {
+            previous = scanLine(line, previous);
+            m_lines.append(previous);
+        }
+        m_headings = collectHeadings(0, int(m_lines.size()), lines, 0);
+
+        // One pass over the blocks finds every heading's block
+        int line = 0;
+        auto heading = m_headings.begin();
+        for (QTextBlock block = m_editor->document()->begin(); block.isValid() && heading != m_headings.end();
+             block = block.next()) {
+            const MarkdownBlockData *data = static_cast<MarkdownBlockData *>(block.userData());
+            if (data && data->isRendered && data->isContinuation) {
+                continue;
+            }
+            if (heading->line == line) {
+                heading->block = block;
+                ++heading;
+            }
+            ++line;
+        }
+    }
+
+    emit headingsReset();
+}
+
+OutlineIndex::LineState OutlineIndex::scanLine(QStringView line, const LineState &previous)
+{
+    LineState state;
+    state.fenceChar = previous.fenceChar;
+    state.fenceLength = previous.fenceLength;
+
+    const int indent = leadingSpaces(line);
+    const QStringView text = line.mid(indent);
+
+    if (previous.fenceLength > 0) {
+        // Only a run of the same character, at least as long, closes the fence
+        const int run = runLength(text, QLatin1Char(previous.fenceChar));
+        if (indent <= MaxIndent && run >= previous.fenceLength && isBlank(text.mid(run))) {
+            state.kind = LineKind::Fence;
+            state.fenceChar = 0;
+            state.fenceLength = 0;
+        } else {
+            state.kind = LineKind::Code;
+        }
+        return state;
+    }
+
+    if (isBlank(text)) {
+        state.kind = LineKind::Blank;
+        return state;
+    }
+    if (indent > MaxIndent) {
+        state.kind = LineKind::Other; // Indented code, or a continuation the outline can ignore
+        return state;
+    }
+
+    const QChar first = text[0];
+    if (first == QLatin1Char('`') || first == QLatin1Char('~')) {
+        const int run = runLength(text, first);
+        // A backtick fence's info string may not contain backticks
+        if (run >= MinFenceLength && (first == QLatin1Char('~') || !text.mid(run).contains(QLatin1Char('`')))) {
+            state.kind = LineKind::Fence;
+            state.fenceChar = char(first.unicode());
+            state.fenceLength = quint16(qMin(run, 0xFFFF));
+            return state;
+        }
+    }
+
+    if (first == QLatin1Char('#')) {
+        const int run = runLength(text, first);
+        if (run <= MaxHeadingLevel
+            && (run == text.size() || text[run] == QLatin1Char(' ') || text[run] == QLatin1Char('\t'))) {
+            state.kind = LineKind::Atx;
+            state.level = quint8(run);
+            return state;
+        }
+    }
+
+    if (first == QLatin1Char('=') || first == QLatin1Char('-')) {
+        const int run = runLength(text, first);
+        if (isBlank(text.mid(run))) {
+            state.kind = first == QLatin1Char('=') ? LineKind::EqualsUnderline : LineKind::DashUnderline;
+            return state;
+        }
+    }
+
+    if (first == QLatin1Char('>') || first == QLatin1Char('|') || isListItem(text)) {
+        state.kind = LineKind::Other;
+        return state;
+    }
+
+    state.kind = LineKind::Paragraph;
+    return state;
+}
+
+QString OutlineIndex::headingText(QStringView line, LineKind kind)
+{
+    // cmark parses the line as a heading of its own, so inline markup is
+    // resolved exactly as in the rendered document
+    if (kind == LineKind::Atx) {
+        return inlineText(line.toUtf8());
+    }
+    return inlineText("# " + line.trimmed().toUtf8());
+}
+
+int OutlineIndex::headingLevel(int line) const
+{
+    const LineState &state = m_lines[line];
+    if (state.kind == LineKind::Atx) {
+        return state.level;
+    }
+    if (state.kind == LineKind::Paragraph && line + 1 < m_lines.size()) {
+        switch (m_lines[line + 1].kind) {
+        case LineKind::EqualsUnderline:
+            return 1;
+        case LineKind::DashUnderline:
+            return 2;
+        default:
+            break;
+        }
+    }
+    return 0;
+}
+
+QTextBlock OutlineIndex::blockOfHeading(int heading)
+{
+    if (heading < 0 || heading >= m_headings.size()) {
+        return QTextBlock();
+    }
+    Heading &entry = m_headings[heading];
+    if (m_editor->rawLineOfBlock(entry.block) != entry.line) {
+        entry.block = m_editor->blockOfRawLine(entry.line);
+    }
+    return entry.block;
+}
+
+int OutlineIndex::headingAtLine(int line) const
+{
+    auto after = std::upper_bound(m_headings.cbegin(), m_headings.cend(), line,
+                                  [](int line, const Heading &heading) { return line < heading.line; });
+    return int(after - m_headings.cbegin()) - 1;
+}
+
+QString OutlineIndex::rawLine(int line) const
+{
+    return m_editor->rawTextOfBlock(m_editor->blockOfRawLine(line));
+}
+
+QVector<OutlineIndex::Heading> OutlineIndex::collectHeadings(int first, int end, const QStringList &texts,
+                                                             int textsFirst) const
+{
+    QVector<Heading> headings;
+    for (int line = first; line < end; ++line) {
+        const int level = headingLevel(line);
+        if (level == 0) {
+            continue;
+        }
+        auto textOf = [&](int line) {
+            const int textIndex = line - textsFirst;
+            return textIndex >= 0 && textIndex < texts.size() ? texts[textIndex] : rawLine(line);
+        };
+        if (m_lines[line].kind != LineKind::Paragraph) {
+            headings.append({ line, level, headingText(textOf(line), m_lines[line].kind) });
+            continue;
+        }
+        // A Setext heading is the whole paragraph above its underline, its lines joined
+        int top = line;
+        while (top > 0 && m_lines[top - 1].kind == LineKind::Paragraph) {
+            --top;
+        }
+        QStringList paragraph;
+        for (int i = top; i <= line; ++i) {
+            paragraph.append(textOf(i).trimmed());
+        }
+        headings.append({ top, level, headingText(paragraph.join(QLatin1Char(' ')), LineKind::Paragraph) });
+    }
+    return headings;
+}
+
+void OutlineIndex::onRawLinesChanged(int firstLine, int removedLines, const QStringList &addedLines)
+{
+    if (firstLine < 0 || removedLines < 0 || firstLine + removedLines > m_lines.size()) {
+        reset(); // Out of step with the editor
+        return;
+    }
+    m_revision = m_editor->contentRevision();
+
+    const int addedCount = int(addedLines.size());
+    const int delta = addedCount - removedLines;
+    const LineState oldBoundary = firstLine + removedLines > 0 ? m_lines[firstLine + removedLines - 1] : LineState();
+
+    m_lines.remove(firstLine, removedLines);
+    m_lines.insert(firstLine, addedCount, LineState());
+
+    LineState previous = firstLine > 0 ? m_lines[firstLine - 1] : LineState();
+    int line = firstLine;
+    for (; line < firstLine + addedCount; ++line) {
+        previous = m_lines[line] = scanLine(addedLines[line - firstLine], previous);
+    }
+
+    // A fence opened or closed by the edit changes the lines below it until
+    // their state is the same as before
+    QStringList texts = addedLines;
+    if (!previous.sameFence(oldBoundary)) {
+        QTextBlock block = m_editor->blockOfRawLine(line);
+        while (block.isValid() && line < m_lines.size()) {
+            const MarkdownBlockData *data = static_cast<MarkdownBlockData *>(block.userData());
+            if (data && data->isRendered && data->isContinuation) {
+                block = block.next();
+                continue;
+            }
+            const QString text = m_editor->rawTextOfBlock(block);
+            const LineState state = scanLine(text, previous);
+            const bool converged = state.sameFence(m_lines[line]) && state.kind == m_lines[line].kind;
+            previous = m_lines[line] = state;
+            texts.append(text);
+            ++line;
+            if (converged) {
+                break;
+            }
+            block = block.next();
+        }
+    }
+
+    // The line above the edit may have gained or lost a Setext underline, and
+    // a Setext heading takes in its whole paragraph, so the paragraphs the
+    // edit touches are collected again in full
+    int start = qMax(0, firstLine - 1);
+    while (start > 0 && m_lines[start].kind == LineKind::Paragraph && m_lines[start - 1].kind == LineKind::Paragraph) {
+        --start;
+    }
+    int newEnd = line;
+    while (newEnd > 0 && newEnd < m_lines.size() && m_lines[newEnd - 1].kind == LineKind::Paragraph
+           && m_lines[newEnd].kind == LineKind::Paragraph) {
+        ++newEnd;
+    }
+    const int oldEnd = newEnd > firstLine + addedCount ? newEnd - delta : firstLine + removedLines;
+
+    auto headingBefore = [](const Heading &heading, int line) { return heading.line < line; };
+    int low = int(std::lower_bound(m_headings.cbegin(), m_headings.cend(), start, headingBefore) - m_headings.cbegin());
+    int high = int(std::lower_bound(m_headings.cbegin(), m_headings.cend(), oldEnd, headingBefore) - m_headings.cbegin());
+    for (int i = high; i < m_headings.size(); ++i) {
+        m_headings[i].line += delta;
+    }
+
+    QVector<Heading> fresh = collectHeadings(start, newEnd, texts, firstLine);
+
+    // Headings the rescan merely found again are not reported
+    auto newLine = [&](const Heading &heading) {
+        return heading.line >= firstLine + removedLines ? heading.line + delta : heading.line;
+    };
+    auto same = [&](const Heading &old, const Heading &found) {
+        return newLine(old) == found.line && old.level == found.level && old.text == found.text;
+    };
+    int prefix = 0;
+    while (prefix < fresh.size() && low + prefix < high && same(m_headings[low + prefix], fresh[prefix])) {
+        ++prefix;
+    }
+    int suffix = 0;
+    while (suffix < fresh.size() - prefix && high - suffix > low + prefix
+           && same(m_headings[high - suffix - 1], fresh[fresh.size() - suffix - 1])) {
+        ++suffix;
+    }
+    for (int i = low; i < high; ++i) {
+        m_headings[i].line = newLine(m_headings[i]);
+    }
+
+    low += prefix;
+    high -= suffix;
+    const int addedHeadings = int(fresh.size()) - prefix - suffix;
+    if (high == low && addedHeadings == 0) {
+        return;
+    }
+    m_headings.remove(low, high - low);
+    m_headings.insert(low, addedHeadings, Heading());
+    std::copy(fresh.cbegin() + prefix, fresh.cend() - suffix, m_headings.begin() + low);
+    for (int i = low; i < low + addedHeadings; ++i) {
+        m_headings[i].block = m_editor->blockOfRawLine(m_headings[i].line);
+    }
+    emit headingsChanged(low, high - low, addedHeadings);
+}
@@ -0,0 +1,278 @@
+#include "outlinemodel.h"
+#include "outlineindex.h"
+
+OutlineModel::OutlineModel(QObject *parent)
+    : QAbstractItemModel(parent)
+{
+}
+
+void OutlineModel::setIndex(OutlineIndex *index)
+{
+    if (m_index == index) {
+        return;
+    }
+
+    beginResetModel();
+    if (m_index) {
+        disconnect(m_index, nullptr, this, nullptr);
+    }
+    m_index = index;
+    if (m_index) {
+        connect(m_index, &OutlineIndex::headingsReset, this, &OutlineModel::onHeadingsReset);
+        connect(m_index, &OutlineIndex::headingsChanged, this, &OutlineModel::onHeadingsChanged);
+        // The index goes away with its editor
+        connect(m_index, &QObject::destroyed, this, &OutlineModel::onHeadingsReset);
+    }
+    buildTree();
+    endResetModel();
+}
+
+void OutlineModel::buildTree()
+{
+    const int count = m_index ? int(m_index->headings().size()) : 0;
+    m_nodes.clear();
+    m_nodes.resize(count);
+    m_nodeOfHeading.resize(count);
+    m_topLevel.clear();
+    m_freeNodes.clear();
+
+    // Parents follow from the levels: the closest earlier heading of a lower level
+    QVector<int> open;
+    for (int i = 0; i < count; ++i) {
+        const OutlineIndex::Heading &heading = m_index->headings()[i];
+        const int level = heading.level;
+        while (!open.isEmpty() && m_nodes[open.last()].level >= level) {
+            open.removeLast();
+        }
+        const int parent = open.isEmpty() ? -1 : open.last();
+        QVector<int> &siblings = childrenOf(parent);
+        m_nodes[i] = { parent, level, int(siblings.size()), i, heading.text, {} };
+        siblings.append(i);
+        m_nodeOfHeading[i] = i;
+        open.append(i);
+    }
+}
+
+void OutlineModel::onHeadingsReset()
+{
+    beginResetModel();
+    buildTree();
+    endResetModel();
+}
+
+void OutlineModel::onHeadingsChanged(int first, int removed, int added)
+{
+    const QVector<OutlineIndex::Heading> &headings = m_index->headings();
+    if (first + removed > m_nodeOfHeading.size()) {
+        onHeadingsReset();
+        return;
+    }
+
+    // Headings edited in place that keep their level stay where they are
+    const int editedFirst = first;
+    const int editedEnd = first + added;
+    while (removed > 0 && added > 0 && m_nodes[m_nodeOfHeading[first]].level == headings[first].level) {
+        ++first;
+        --removed;
+        --added;
+    }
+    while (removed > 0 && added > 0
+           && m_nodes[m_nodeOfHeading[first + removed - 1]].level == headings[first + added - 1].level) {
+        --removed;
+        --added;
+    }
+
+    for (int i = first + removed - 1; i >= first; --i) {
+        removeHeading(i);
+    }
+    for (int i = first; i < first + added; ++i) {
+        insertHeading(i, headings[i].level, headings[i].text);
+    }
+
+    for (int i = editedFirst; i < editedEnd; ++i) {
+        if (i >= first && i < first + added) {
+            continue;
+        }
+        m_nodes[m_nodeOfHeading[i]].text = headings[i].text;
+        const QModelIndex changed = indexOfHeading(i);
+        emit dataChanged(changed, changed, { Qt::DisplayRole });
+    }
+}
+
+void OutlineModel::removeHeading(int heading)
+{
+    const int node = m_nodeOfHeading[heading];
+    const int parent = m_nodes[node].parent;
+
+    // Children move out first, each to the closest earlier heading of a lower level:
+    // the heading just before or one of its ancestors, up to the parent. Their
+    // levels never rise, so later children land no deeper than earlier ones.
+    int target = heading > 0 ? m_nodeOfHeading[heading - 1] : -1;
+    while (!m_nodes[node].children.isEmpty()) {
+        const QVector<int> &children = m_nodes[node].children;
+        while (target != parent && m_nodes[target].level >= m_nodes[children.first()].level) {
+            target = m_nodes[target].parent;
+        }
+        if (target == parent) {
+            moveChildren(node, 0, int(children.size()), parent, m_nodes[node].row + 1);
+            break;
+        }
+        int count = 1;
+        while (count < children.size() && m_nodes[children[count]].level > m_nodes[target].level) {
+            ++count;
+        }
+        moveChildren(node, 0, count, target, int(m_nodes[target].children.size()));
+    }
+
+    const int row = m_nodes[node].row;
+    beginRemoveRows(indexOfNode(parent), row, row);
+    childrenOf(parent).remove(row);
+    renumber(parent, row);
+    m_nodeOfHeading.remove(heading);
+    for (int i = heading; i < m_nodeOfHeading.size(); ++i) {
+        --m_nodes[m_nodeOfHeading[i]].heading;
+    }
+    m_nodes[node].text.clear();
+    m_freeNodes.append(node);
+    endRemoveRows();
+}
+
+void OutlineModel::insertHeading(int heading, int level, const QString &text)
+{
+    // The parent is the heading just before or one of its ancestors; the ones
+    // passed on the way up are deeper than the new heading
+    QVector<int> deeper;
+    int parent = heading > 0 ? m_nodeOfHeading[heading - 1] : -1;
+    while (parent >= 0 && m_nodes[parent].level >= level) {
+        deeper.append(parent);
+        parent = m_nodes[parent].parent;
+    }
+    const int row = deeper.isEmpty() ? 0 : m_nodes[deeper.last()].row + 1;
+
+    int node;
+    if (!m_freeNodes.isEmpty()) {
+        node = m_freeNodes.takeLast();
+    } else {
+        node = int(m_nodes.size());
+        m_nodes.append(Node());
+    }
+
+    beginInsertRows(indexOfNode(parent), row, row);
+    m_nodes[node] = { parent, level, row, heading, text, {} };
+    childrenOf(parent).insert(row, node);
+    renumber(parent, row + 1);
+    m_nodeOfHeading.insert(heading, node);
+    for (int i = heading + 1; i < m_nodeOfHeading.size(); ++i) {
+        ++m_nodes[m_nodeOfHeading[i]].heading;
+    }
+    endInsertRows();
+
+    // Later headings under the deeper ones, then later siblings of a higher level,
+    // now have the new heading closest above them; they come in document order
+    for (int ancestor : std::as_const(deeper)) {
+        const QVector<int> &children = m_nodes[ancestor].children;
+        int firstLater = int(children.size());
+        while (firstLater > 0 && m_nodes[children[firstLater - 1]].heading > heading) {
+            --firstLater;
+        }
+        if (firstLater < children.size()) {
+            moveChildren(ancestor, firstLater, int(children.size()) - firstLater,
+                         node, int(m_nodes[node].children.size()));
+        }
+    }
+    const QVector<int> &siblings = childrenOf(parent);
+    int count = 0;
+    while (row + 1 + count < siblings.size() && m_nodes[siblings[row + 1 + count]].level > level) {
+        ++count;
+    }
+    if (count > 0) {
+        moveChildren(parent, row + 1, count, node, int(m_nodes[node].children.size()));
+    }
+}
+
+void OutlineModel::moveChildren(int from, int first, int count, int to, int row)
+{
+    beginMoveRows(indexOfNode(from), first, first + count - 1, indexOfNode(to), row);
+    QVector<int> &source = childrenOf(from);
+    const QVector<int> moved = source.mid(first, count);
+    source.remove(first, count);
+    renumber(from, first);
+    QVector<int> &destination = childrenOf(to);
+    for (int i = 0; i < count; ++i) {
+        destination.insert(row + i, moved[i]);
+        m_nodes[moved[i]].parent = to;
+    }
+    renumber(to, row);
+    endMoveRows();
+}
+
+void OutlineModel::renumber(int node, int fromRow)
+{
+    const QVector<int> &children = childrenOf(node);
+    for (int row = fromRow; row < children.size(); ++row) {
+        m_nodes[children[row]].row = row;
+    }
+}
+
+int OutlineModel::headingAt(const QModelIndex &index) const
+{
+    return index.isValid() && index.model() == this ? m_nodes[int(index.internalId())].heading : -1;
+}
+
+QModelIndex OutlineModel::indexOfHeading(int heading) const
+{
+    if (heading < 0 || heading >= m_nodeOfHeading.size()) {
+        return QModelIndex();
+    }
+    return indexOfNode(m_nodeOfHeading[heading]);
+}
+
+QModelIndex OutlineModel::indexOfNode(int node) const
+{
+    return node < 0 ? QModelIndex() : createIndex(m_nodes[node].row, 0, quintptr(node));
+}
+
+QModelIndex OutlineModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (column != 0 || row < 0) {
+        return QModelIndex();
+    }
+    const QVector<int> &children = parent.isValid() ? m_nodes[int(parent.internalId())].children : m_topLevel;
+    return row < children.size() ? createIndex(row, 0, quintptr(children[row])) : QModelIndex();
+}
+
+QModelIndex OutlineModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid()) {
+        return QModelIndex();
+    }
+    return indexOfNode(m_nodes[int(child.internalId())].parent);
+}
+
+int OutlineModel::rowCount(const QModelIndex &parent) const
+{
+    if (!parent.isValid()) {
+        return int(m_topLevel.size());
+    }
+    return parent.column() == 0 ? int(m_nodes[int(parent.internalId())].children.size()) : 0;
+}
+
+int OutlineModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return 1;
+}
+
+bool OutlineModel::hasChildren(const QModelIndex &parent) const
+{
+    return rowCount(parent) > 0;
+}
+
+QVariant OutlineModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.model() != this || (role != Qt::DisplayRole && role != Qt::ToolTipRole)) {
+        return QVariant();
+    }
+    const QString &text = m_nodes[int(index.internalId())].text;
+    return text.isEmpty() ? tr("(Empty Heading)") : text;
+}
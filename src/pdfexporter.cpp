@@ -0,0 +1,217 @@
+#include "pdfexporter.h"
+#include "pdfpaginator.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QSaveFile>
+#include <cmark.h>
+#include <cstring>
+
+namespace {
+
+// Cancellation is also checked every this many blocks, for very long pages
+const int CancelCheckInterval = 64;
+
+// Bumped whenever the paginator draws differently, so stale cache entries miss
+const char LayoutVersion = 2;
+
+void addString(QCryptographicHash &hash, const char *text)
+{
+    if (text) {
+        hash.addData(QByteArrayView(text, qsizetype(std::strlen(text)) + 1)); // With the terminator as separator
+    } else {
+        hash.addData(QByteArrayView("", 1));
+    }
+}
+
+void addInt(QCryptographicHash &hash, int value)
+{
+    hash.addData(QByteArrayView(reinterpret_cast<const char *>(&value), sizeof(value)));
+}
+
+// Identifies a top-level block by everything the paginator draws from it
+QByteArray cacheKey(cmark_node *node, const QByteArray &styleFingerprint, qreal width)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArrayView(&LayoutVersion, 1));
+    hash.addData(styleFingerprint);
+    hash.addData(QByteArrayView(reinterpret_cast<const char *>(&width), sizeof(width)));
+
+    cmark_iter *iter = cmark_iter_new(node);
+    for (cmark_event_type event = cmark_iter_next(iter); event != CMARK_EVENT_DONE; event = cmark_iter_next(iter)) {
+        cmark_node *current = cmark_iter_get_node(iter);
+        addInt(hash, event == CMARK_EVENT_ENTER ? cmark_node_get_type(current) : -1);
+        if (event != CMARK_EVENT_ENTER) {
+            continue;
+        }
+        switch (cmark_node_get_type(current)) {
+        case CMARK_NODE_TEXT:
+        case CMARK_NODE_CODE:
+        case CMARK_NODE_CODE_BLOCK:
+        case CMARK_NODE_HTML_INLINE:
+        case CMARK_NODE_HTML_BLOCK:
+            addString(hash, cmark_node_get_literal(current));
+            break;
+        case CMARK_NODE_HEADING:
+            addInt(hash, cmark_node_get_heading_level(current));
+            break;
+        case CMARK_NODE_LIST:
+            addInt(hash, cmark_node_get_list_type(current));
+            addInt(hash, cmark_node_get_list_delim(current));
+            addInt(hash, cmark_node_get_list_start(current));
+            addInt(hash, cmark_node_get_list_tight(current));
+            break;
+        default:
+            break;
+        }
+    }
+    cmark_iter_free(iter);
+    return hash.result();
+}
+
+// Lays out every top-level block in turn and pages it; false if canceled
+bool paginate(cmark_node *document, PdfPaginator &pages, const PdfExporter::Style &style,
+              PdfExporter::LayoutCache *cache, const PdfExporter::ProgressCallback &progress)
+{
+    qint64 total = 0;
+    for (cmark_node *node = cmark_node_first_child(document); node; node = cmark_node_next(node)) {
+        ++total;
+    }
+
+    const QByteArray styleFingerprint = cache ? style.fingerprint() : QByteArray();
+    qint64 placed = 0;
+    for (cmark_node *node = cmark_node_first_child(document); node; node = cmark_node_next(node)) {
+        PdfExporter::LaidOutBlock block;
+        const QByteArray key = cache ? cacheKey(node, styleFingerprint, pages.width()) : QByteArray();
+        if (!cache || !cache->find(key, &block)) {
+            block = pages.layOut(node);
+            if (cache) {
+                cache->insert(key, block);
+            }
+        }
+
+        if (!pages.place(block, placed, total)) {
+            return false;
+        }
+        ++placed;
+        if (progress && placed % CancelCheckInterval == 0 && !progress(placed, total)) {
+            return false;
+        }
+    }
+    return pages.finish(total);
+}
+
+} // namespace
+
+namespace PdfExporter
+{
+
+Style::Style()
+{
+    bodyFont.setFamilies({ QStringLiteral("Segoe UI"), QStringLiteral("Arial") });
+    bodyFont.setStyleHint(QFont::SansSerif);
+    bodyFont.setPointSizeF(11);
+    codeFont.setFamilies({ QStringLiteral("Monospace") });
+    codeFont.setStyleHint(QFont::TypeWriter);
+    codeFont.setFixedPitch(true);
+    codeFont.setPointSizeF(9.5);
+}
+
+QByteArray Style::fingerprint() const
+{
+    QByteArray bytes;
+    QDataStream out(&bytes, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << bodyFont.toString() << codeFont.toString() << lineSpacing << pageMarginMillimeters;
+    for (const QColor &color : { page, text, heading, link, image, codeText, codeBackground,
+                                 quoteText, tableHeaderBackground, border, rule }) {
+        out << color.rgba();
+    }
+    return bytes;
+}
+
+LayoutCache::LayoutCache(qsizetype maxBytes)
+    : m_blocks(maxBytes)
+{
+}
+
+bool LayoutCache::find(const QByteArray &key, LaidOutBlock *block)
+{
+    QMutexLocker locker(&m_mutex);
+    const LaidOutBlock *cached = m_blocks.object(key);
+    if (!cached) {
+        return false;
+    }
+    // Replaying a QPicture seeks in its shared buffer, so every export gets its own copy
+    *block = *cached;
+    block->picture.setData(cached->picture.data(), cached->picture.size());
+    return true;
+}
+
+void LayoutCache::insert(const QByteArray &key, const LaidOutBlock &block)
+{
+    const qsizetype cost = block.picture.size() + block.lineBottoms.size() * qsizetype(sizeof(qreal));
+    auto *copy = new LaidOutBlock(block);
+    copy->picture.setData(block.picture.data(), block.picture.size());
+    QMutexLocker locker(&m_mutex);
+    m_blocks.insert(key, copy, qMax<qsizetype>(cost, 1));
+}
+
+Result exportDocument(cmark_node *document, const QString &fileName, const Style &style,
+                      LayoutCache *cache, const ProgressCallback &progress)
+{
+    Result result;
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        result.errorString = file.errorString();
+        return result;
+    }
+
+    {
+        // QPdfWriter, unlike QPrinter, may be used off the GUI thread
+        QPdfWriter writer(&file);
+        writer.setTitle(QFileInfo(fileName).baseName());
+        writer.setCreator(QStringLiteral("Scriber"));
+        const qreal margin = style.pageMarginMillimeters;
+        writer.setPageMargins(QMarginsF(margin, margin, margin, margin), QPageLayout::Millimeter);
+        // Pages use the pictures' resolution so they replay without scaling
+        writer.setResolution(QPicture().logicalDpiY());
+
+        QPainter painter;
+        if (!painter.begin(&writer)) {
+            file.cancelWriting();
+            result.errorString = QStringLiteral("Cannot start PDF output");
+            return result;
+        }
+        PdfPaginator pages(writer, painter, style, progress);
+        const bool completed = paginate(document, pages, style, cache, progress);
+        painter.end();
+        result.pageCount = pages.pageCount();
+        if (!completed) {
+            file.cancelWriting(); // Leaves any previous export in place
+            result.canceled = true;
+            return result;
+        }
+    } // The writer completes the PDF when it is destroyed
+
+    if (!file.commit()) {
+        result.errorString = file.errorString();
+        return result;
+    }
+    result.ok = true;
+    return result;
+}
+
+Result exportToFile(QStringView markdown, const QString &fileName, const Style &style,
+                    LayoutCache *cache, const ProgressCallback &progress)
+{
+    cmark_node *document = HtmlExporter::parse(markdown);
+    Result result = exportDocument(document, fileName, style, cache, progress);
+    cmark_node_free(document);
+    return result;
+}
+
+}
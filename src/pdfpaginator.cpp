@@ -0,0 +1,616 @@
+#include "pdfpaginator.h"
+#include <QFontMetricsF>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QRegularExpression>
+#include <QTextLayout>
+#include <algorithm>
+#include <cmark.h>
+#include <memory>
+#include <vector>
+
+namespace {
+
+using PdfExporter::LaidOutBlock;
+using PdfExporter::Style;
+
+// Heading sizes relative to the body font, h1 to h6
+const qreal HeadingScale[] = { 2.0, 1.5, 1.25, 1.1, 1.0, 0.9 };
+
+// Spacing and indents, in points
+const qreal ParagraphSpacing = 8;
+const qreal TightItemSpacing = 2;
+const qreal HeadingSpacingBefore = 14;
+const qreal HeadingSpacingAfter = 6;
+const qreal HeadingRuleGap = 3;
+const qreal CodePadding = 6;
+const qreal ListIndent = 18;
+const qreal ListMarkerGap = 5;
+const qreal QuoteIndent = 12;
+const qreal QuoteBarWidth = 3;
+const qreal CellPadding = 4;
+const qreal RuleHeight = 12;
+const qreal HairlineWidth = 0.75;
+
+// Wide enough that only hard line breaks end a line when measuring
+const qreal UnboundedWidth = 1e6;
+
+const QChar Bullets[] = { QChar(0x2022), QChar(0x25E6), QChar(0x25AA) };
+
+/// Inline content of a leaf block, flattened for QTextLayout
+struct InlineText {
+    QString text;
+    QList<QTextLayout::FormatRange> formats;
+    QList<int> pipes;      // Positions of '|' in plain text, for pipe tables
+    QList<int> softBreaks; // Positions of the spaces that stand for source line breaks
+};
+
+void append(InlineText &out, const QString &text, const QTextCharFormat &format)
+{
+    if (!format.isEmpty() && !text.isEmpty()) {
+        out.formats.append({ int(out.text.size()), int(text.size()), format });
+    }
+    out.text += text;
+}
+
+void collectInlines(cmark_node *parent, const Style &style, const QTextCharFormat &format, InlineText &out)
+{
+    for (cmark_node *node = cmark_node_first_child(parent); node; node = cmark_node_next(node)) {
+        QTextCharFormat nested = format;
+        switch (cmark_node_get_type(node)) {
+        case CMARK_NODE_TEXT: {
+            const QString literal = QString::fromUtf8(cmark_node_get_literal(node));
+            for (qsizetype i = literal.indexOf(QLatin1Char('|')); i >= 0; i = literal.indexOf(QLatin1Char('|'), i + 1)) {
+                out.pipes.append(int(out.text.size() + i));
+            }
+            append(out, literal, format);
+            break;
+        }
+        case CMARK_NODE_CODE:
+            nested.setFontFamilies(style.codeFont.families());
+            nested.setFontFixedPitch(true);
+            nested.setForeground(style.codeText);
+            nested.setBackground(style.codeBackground);
+            append(out, QString::fromUtf8(cmark_node_get_literal(node)), nested);
+            break;
+        case CMARK_NODE_SOFTBREAK:
+            out.softBreaks.append(int(out.text.size()));
+            append(out, QStringLiteral(" "), format);
+            break;
+        case CMARK_NODE_LINEBREAK:
+            append(out, QString(QChar::LineSeparator), format);
+            break;
+        case CMARK_NODE_EMPH:
+            nested.setFontItalic(true);
+            collectInlines(node, style, nested, out);
+            break;
+        case CMARK_NODE_STRONG:
+            nested.setFontWeight(QFont::Bold);
+            collectInlines(node, style, nested, out);
+            break;
+        case CMARK_NODE_LINK:
+            nested.setForeground(style.link);
+            nested.setFontUnderline(true);
+            collectInlines(node, style, nested, out);
+            break;
+        case CMARK_NODE_IMAGE:
+            // Images are not embedded; their alt text stands in for them
+            nested.setForeground(style.image);
+            nested.setFontItalic(true);
+            collectInlines(node, style, nested, out);
+            break;
+        default:
+            // Raw HTML is omitted, as in the HTML export
+            break;
+        }
+    }
+}
+
+// Copies [from, to) of @p content without surrounding whitespace
+InlineText slice(const InlineText &content, int from, int to)
+{
+    while (from < to && content.text.at(from).isSpace()) {
+        ++from;
+    }
+    while (to > from && content.text.at(to - 1).isSpace()) {
+        --to;
+    }
+
+    InlineText cell;
+    cell.text = content.text.mid(from, to - from);
+    for (const QTextLayout::FormatRange &range : content.formats) {
+        const int start = qMax(range.start, from);
+        const int end = qMin(range.start + range.length, to);
+        if (start < end) {
+            cell.formats.append({ start - from, end - start, range.format });
+        }
+    }
+    return cell;
+}
+
+struct PipeTable {
+    QList<Qt::Alignment> alignments;
+    QList<QList<InlineText>> rows; // The header first
+};
+
+// cmark has no table extension, so pipe tables arrive as paragraphs
+bool splitPipeTable(const InlineText &content, PipeTable *table)
+{
+    if (content.softBreaks.isEmpty() || content.pipes.isEmpty()) {
+        return false;
+    }
+
+    QList<int> lineStarts = { 0 };
+    QList<int> lineEnds;
+    for (int position : content.softBreaks) {
+        lineEnds.append(position);
+        lineStarts.append(position + 1);
+    }
+    lineEnds.append(int(content.text.size()));
+
+    // Smart punctuation has already turned runs of hyphens into dashes
+    static const QRegularExpression delimiterRow(
+        QStringLiteral("^\\s*\\|?\\s*:?[-\\x{2013}\\x{2014}]+:?\\s*(\\|\\s*:?[-\\x{2013}\\x{2014}]+:?\\s*)*\\|?\\s*$"));
+    const QString delimiters = content.text.mid(lineStarts[1], lineEnds[1] - lineStarts[1]);
+    if (!delimiterRow.match(delimiters).hasMatch()) {
+        return false;
+    }
+
+    auto cellsOfLine = [&content](int start, int end) {
+        QList<int> bounds = { start };
+        for (int pipe : content.pipes) {
+            if (pipe >= start && pipe < end) {
+                bounds.append(pipe);
+            }
+        }
+        bounds.append(end);
+
+        QList<InlineText> cells;
+        for (int i = 0; i + 1 < bounds.size(); ++i) {
+            const int from = i == 0 ? bounds[i] : bounds[i] + 1;
+            cells.append(slice(content, from, bounds[i + 1]));
+        }
+        // Leading and trailing pipes are optional and open no cell
+        if (cells.size() > 1 && cells.first().text.isEmpty()) {
+            cells.removeFirst();
+        }
+        if (cells.size() > 1 && cells.last().text.isEmpty()) {
+            cells.removeLast();
+        }
+        return cells;
+    };
+
+    if (content.pipes.first() >= lineEnds[0]) {
+        return false; // The header row needs a pipe of its own
+    }
+    const QList<InlineText> header = cellsOfLine(lineStarts[0], lineEnds[0]);
+
+    for (const InlineText &cell : cellsOfLine(lineStarts[1], lineEnds[1])) {
+        const bool left = cell.text.startsWith(QLatin1Char(':'));
+        const bool right = cell.text.endsWith(QLatin1Char(':'));
+        table->alignments.append(left && right ? Qt::AlignHCenter : right ? Qt::AlignRight : Qt::AlignLeft);
+    }
+    if (table->alignments.size() != header.size()) {
+        return false;
+    }
+
+    table->rows.append(header);
+    for (int line = 2; line < lineStarts.size(); ++line) {
+        QList<InlineText> row = cellsOfLine(lineStarts[line], lineEnds[line]);
+        row.resize(header.size());
+        table->rows.append(row);
+    }
+    return true;
+}
+
+void prepareLayout(QTextLayout &layout, const InlineText &content, Qt::Alignment alignment,
+                   QTextOption::WrapMode wrapMode = QTextOption::WrapAtWordBoundaryOrAnywhere)
+{
+    layout.setText(content.text);
+    layout.setFormats(content.formats);
+    QTextOption option(alignment);
+    option.setWrapMode(wrapMode);
+    layout.setTextOption(option);
+    layout.setCacheEnabled(true); // Shaping survives a second layout pass
+}
+
+// Breaks @p layout into lines of @p width and returns the height used; line bottoms go to @p bottoms
+qreal breakLines(QTextLayout &layout, qreal width, qreal lineSpacing, QVector<qreal> *bottoms = nullptr)
+{
+    qreal y = 0;
+    layout.beginLayout();
+    for (QTextLine line = layout.createLine(); line.isValid(); line = layout.createLine()) {
+        line.setLineWidth(width);
+        const qreal height = line.height() * lineSpacing;
+        line.setPosition(QPointF(0, y + (height - line.height()) / 2));
+        y += height;
+        if (bottoms) {
+            bottoms->append(y);
+        }
+    }
+    layout.endLayout();
+    return y;
+}
+
+/// Paints one top-level block into its picture, top to bottom
+class BlockPainter
+{
+public:
+    BlockPainter(const Style &style, LaidOutBlock &block, qreal width)
+        : m_style(style), m_block(block), m_width(width), m_painter(&block.picture)
+    {
+        m_painter.setRenderHint(QPainter::Antialiasing);
+    }
+
+    void paint(cmark_node *node)
+    {
+        blockNode(node, 0, m_width, m_style.text, false);
+        m_painter.end();
+
+        m_block.height = m_y;
+        m_block.spaceAfter = m_pendingSpace;
+        QVector<qreal> &bottoms = m_block.lineBottoms;
+        std::sort(bottoms.begin(), bottoms.end());
+        bottoms.erase(std::unique(bottoms.begin(), bottoms.end()), bottoms.end());
+        while (!bottoms.isEmpty() && bottoms.last() >= m_block.height) {
+            bottoms.removeLast();
+        }
+    }
+
+private:
+    qreal pt(qreal points) const { return points * m_block.picture.logicalDpiY() / 72.0; }
+
+    // Asks for at least @p points before the next thing drawn; consecutive requests collapse
+    void space(qreal points) { m_pendingSpace = qMax(m_pendingSpace, pt(points)); }
+
+    // Settles the pending space before drawing
+    void startBlock()
+    {
+        if (!m_started) {
+            m_block.spaceBefore = m_pendingSpace; // The paginator decides about it
+            m_started = true;
+        } else {
+            m_y += m_pendingSpace;
+        }
+        m_pendingSpace = 0;
+    }
+
+    void blockNode(cmark_node *node, qreal x, qreal width, const QColor &color, bool tight)
+    {
+        switch (cmark_node_get_type(node)) {
+        case CMARK_NODE_PARAGRAPH: {
+            InlineText content;
+            collectInlines(node, m_style, QTextCharFormat(), content);
+            PipeTable table;
+            if (splitPipeTable(content, &table)) {
+                pipeTable(table, x, width, color);
+            } else {
+                startBlock();
+                text(content, m_style.bodyFont, x, width, color);
+            }
+            space(tight ? 0 : ParagraphSpacing);
+            break;
+        }
+        case CMARK_NODE_HEADING:
+            heading(node, x, width);
+            break;
+        case CMARK_NODE_CODE_BLOCK:
+            codeBlock(node, x, width);
+            break;
+        case CMARK_NODE_BLOCK_QUOTE: {
+            startBlock();
+            const qreal top = m_y;
+            const qreal indent = pt(QuoteIndent);
+            for (cmark_node *child = cmark_node_first_child(node); child; child = cmark_node_next(child)) {
+                blockNode(child, x + indent, width - indent, m_style.quoteText, false);
+            }
+            m_painter.fillRect(QRectF(x, top, pt(QuoteBarWidth), m_y - top), m_style.border);
+            space(ParagraphSpacing);
+            break;
+        }
+        case CMARK_NODE_LIST:
+            list(node, x, width, color);
+            break;
+        case CMARK_NODE_THEMATIC_BREAK: {
+            startBlock();
+            const qreal y = m_y + pt(RuleHeight) / 2;
+            m_painter.setPen(QPen(m_style.rule, pt(1)));
+            m_painter.drawLine(QPointF(x, y), QPointF(x + width, y));
+            m_y += pt(RuleHeight);
+            space(ParagraphSpacing);
+            break;
+        }
+        default:
+            // Raw HTML blocks are omitted, as in the HTML export
+            break;
+        }
+    }
+
+    // Lays out and draws @p content at the current position
+    void text(const InlineText &content, const QFont &font, qreal x, qreal width, const QColor &color)
+    {
+        QTextLayout layout(QString(), font, &m_block.picture);
+        prepareLayout(layout, content, Qt::AlignLeft);
+        QVector<qreal> bottoms;
+        const qreal height = breakLines(layout, width, m_style.lineSpacing, &bottoms);
+        m_painter.setPen(color);
+        layout.draw(&m_painter, QPointF(x, m_y));
+        for (qreal bottom : std::as_const(bottoms)) {
+            m_block.lineBottoms.append(m_y + bottom);
+        }
+        m_y += height;
+    }
+
+    void heading(cmark_node *node, qreal x, qreal width)
+    {
+        const int level = qBound(1, cmark_node_get_heading_level(node), 6);
+        QFont font = m_style.bodyFont;
+        font.setPointSizeF(font.pointSizeF() * HeadingScale[level - 1]);
+        font.setWeight(QFont::Bold);
+
+        InlineText content;
+        collectInlines(node, m_style, QTextCharFormat(), content);
+        space(HeadingSpacingBefore);
+        startBlock();
+        text(content, font, x, width, m_style.heading);
+
+        if (level <= 2) {
+            m_y += pt(HeadingRuleGap);
+            m_painter.setPen(QPen(m_style.rule, pt(HairlineWidth)));
+            m_painter.drawLine(QPointF(x, m_y), QPointF(x + width, m_y));
+            m_y += pt(HairlineWidth);
+        }
+        space(HeadingSpacingAfter);
+        if (cmark_node_get_type(cmark_node_parent(node)) == CMARK_NODE_DOCUMENT) {
+            m_block.keepWithNext = true;
+        }
+    }
+
+    void codeBlock(cmark_node *node, qreal x, qreal width)
+    {
+        InlineText content;
+        content.text = QString::fromUtf8(cmark_node_get_literal(node));
+        if (content.text.endsWith(QLatin1Char('\n'))) {
+            content.text.chop(1);
+        }
+        content.text.replace(QLatin1Char('\n'), QChar::LineSeparator);
+
+        const qreal padding = pt(CodePadding);
+        QTextLayout layout(QString(), m_style.codeFont, &m_block.picture);
+        prepareLayout(layout, content, Qt::AlignLeft, QTextOption::WrapAnywhere);
+        QVector<qreal> bottoms;
+        const qreal height = breakLines(layout, width - 2 * padding, 1.0, &bottoms);
+
+        startBlock();
+        m_painter.fillRect(QRectF(x, m_y, width, height + 2 * padding), m_style.codeBackground);
+        m_painter.setPen(m_style.codeText);
+        layout.draw(&m_painter, QPointF(x + padding, m_y + padding));
+        for (qreal bottom : std::as_const(bottoms)) {
+            m_block.lineBottoms.append(m_y + padding + bottom);
+        }
+        m_y += height + 2 * padding;
+        space(ParagraphSpacing);
+    }
+
+    void list(cmark_node *node, qreal x, qreal width, const QColor &color)
+    {
+        const bool ordered = cmark_node_get_list_type(node) == CMARK_ORDERED_LIST;
+        const bool tight = cmark_node_get_list_tight(node);
+        const QChar delimiter = cmark_node_get_list_delim(node) == CMARK_PAREN_DELIM ? QLatin1Char(')') : QLatin1Char('.');
+        const qreal indent = pt(ListIndent);
+        int number = cmark_node_get_list_start(node);
+
+        for (cmark_node *item = cmark_node_first_child(node); item; item = cmark_node_next(item), ++number) {
+            startBlock();
+
+            // The marker shares the first line's font and spacing, so their baselines meet
+            InlineText marker;
+            marker.text = ordered ? QString::number(number) + delimiter : QString(Bullets[m_listDepth % 3]);
+            QTextLayout markerLayout(QString(), m_style.bodyFont, &m_block.picture);
+            prepareLayout(markerLayout, marker, Qt::AlignRight);
+            const qreal markerHeight = breakLines(markerLayout, indent - pt(ListMarkerGap), m_style.lineSpacing);
+            m_painter.setPen(color);
+            markerLayout.draw(&m_painter, QPointF(x, m_y));
+
+            const qreal top = m_y;
+            ++m_listDepth;
+            for (cmark_node *child = cmark_node_first_child(item); child; child = cmark_node_next(child)) {
+                blockNode(child, x + indent, width - indent, color, tight);
+            }
+            --m_listDepth;
+            m_y = qMax(m_y, top + markerHeight);
+            space(tight ? TightItemSpacing : ParagraphSpacing);
+        }
+        space(ParagraphSpacing);
+    }
+
+    void pipeTable(const PipeTable &table, qreal x, qreal width, const QColor &color)
+    {
+        const int columns = int(table.alignments.size());
+        const qreal padding = pt(CellPadding);
+        QFont headerFont = m_style.bodyFont;
+        headerFont.setWeight(QFont::Bold);
+
+        // Every cell is shaped once: measured unwrapped, then broken to its column
+        std::vector<std::unique_ptr<QTextLayout>> cells;
+        QVector<qreal> natural(columns, 0);
+        for (qsizetype row = 0; row < table.rows.size(); ++row) {
+            for (int column = 0; column < columns; ++column) {
+                auto layout = std::make_unique<QTextLayout>(QString(), row == 0 ? headerFont : m_style.bodyFont,
+                                                            &m_block.picture);
+                prepareLayout(*layout, table.rows[row][column], table.alignments[column]);
+                breakLines(*layout, UnboundedWidth, m_style.lineSpacing);
+                natural[column] = qMax(natural[column], layout->maximumWidth() + 2 * padding);
+                cells.push_back(std::move(layout));
+            }
+        }
+
+        // Columns keep their natural width when it fits and shrink in proportion otherwise
+        qreal total = 0;
+        for (qreal w : std::as_const(natural)) {
+            total += w;
+        }
+        QVector<qreal> widths = natural;
+        if (total > width) {
+            for (qreal &w : widths) {
+                w *= width / total;
+            }
+            total = width;
+        }
+
+        startBlock();
+        const qreal top = m_y;
+        QVector<qreal> rowBottoms;
+        for (qsizetype row = 0; row < table.rows.size(); ++row) {
+            qreal rowHeight = 0;
+            for (int column = 0; column < columns; ++column) {
+                QTextLayout &layout = *cells[row * columns + column];
+                rowHeight = qMax(rowHeight, breakLines(layout, widths[column] - 2 * padding, m_style.lineSpacing));
+            }
+            rowHeight += 2 * padding;
+
+            if (row == 0) {
+                m_painter.fillRect(QRectF(x, m_y, total, rowHeight), m_style.tableHeaderBackground);
+            }
+            qreal cellX = x;
+            m_painter.setPen(color);
+            for (int column = 0; column < columns; ++column) {
+                cells[row * columns + column]->draw(&m_painter, QPointF(cellX + padding, m_y + padding));
+                cellX += widths[column];
+            }
+            m_y += rowHeight;
+            rowBottoms.append(m_y);
+            m_block.lineBottoms.append(m_y);
+        }
+
+        m_painter.setPen(QPen(m_style.border, pt(HairlineWidth)));
+        m_painter.drawLine(QPointF(x, top), QPointF(x + total, top));
+        for (qreal bottom : std::as_const(rowBottoms)) {
+            m_painter.drawLine(QPointF(x, bottom), QPointF(x + total, bottom));
+        }
+        qreal lineX = x;
+        m_painter.drawLine(QPointF(lineX, top), QPointF(lineX, m_y));
+        for (qreal w : std::as_const(widths)) {
+            lineX += w;
+            m_painter.drawLine(QPointF(lineX, top), QPointF(lineX, m_y));
+        }
+    }
+
+    const Style &m_style;
+    LaidOutBlock &m_block;
+    const qreal m_width;
+    QPainter m_painter;
+    qreal m_y = 0;
+    qreal m_pendingSpace = 0;
+    bool m_started = false;
+    int m_listDepth = 0;
+};
+
+} // namespace
+
+PdfPaginator::PdfPaginator(QPdfWriter &writer, QPainter &painter, const PdfExporter::Style &style,
+                           const PdfExporter::ProgressCallback &progress)
+    : m_writer(writer), m_painter(painter), m_style(style), m_progress(progress),
+      m_width(writer.width()), m_pageHeight(writer.height()),
+      m_keepWithNextHeight(2 * QFontMetricsF(style.bodyFont, &writer).lineSpacing() * style.lineSpacing)
+{
+    beginPage();
+}
+
+PdfExporter::LaidOutBlock PdfPaginator::layOut(cmark_node *node) const
+{
+    LaidOutBlock block;
+    BlockPainter(m_style, block, m_width).paint(node);
+    return block;
+}
+
+bool PdfPaginator::place(const PdfExporter::LaidOutBlock &block, qint64 placed, qint64 total)
+{
+    // Space between blocks collapses, and is dropped at the top of a page
+    if (m_y > 0) {
+        m_y += qMax(m_pendingSpace, block.spaceBefore);
+        if (m_y >= m_pageHeight && !newPage(placed, total)) {
+            return false;
+        }
+    }
+
+    // A heading at the foot of a page goes to the next one with its text
+    if (block.keepWithNext && m_y > 0 && m_y + block.height + block.spaceAfter + m_keepWithNextHeight > m_pageHeight) {
+        if (!newPage(placed, total)) {
+            return false;
+        }
+    }
+
+    qreal offset = 0; // Part of the block already on earlier pages
+    while (block.height - offset > m_pageHeight - m_y) {
+        const qreal space = m_pageHeight - m_y;
+
+        // Blocks that fit on a page are kept together
+        if (offset == 0 && m_y > 0 && block.height <= m_pageHeight) {
+            if (!newPage(placed, total)) {
+                return false;
+            }
+            continue;
+        }
+
+        // Otherwise split after the last whole line that still fits
+        auto it = std::upper_bound(block.lineBottoms.cbegin(), block.lineBottoms.cend(), offset + space);
+        qreal cut = it != block.lineBottoms.cbegin() ? *(it - 1) : offset;
+        if (cut <= offset) {
+            if (m_y > 0) {
+                if (!newPage(placed, total)) {
+                    return false;
+                }
+                continue;
+            }
+            cut = offset + space; // A single line taller than the page is sliced
+        }
+        draw(block, offset, cut - offset);
+        offset = cut;
+        if (!newPage(placed, total)) {
+            return false;
+        }
+    }
+    draw(block, offset, block.height - offset);
+    m_y += block.height - offset;
+    m_pendingSpace = block.spaceAfter;
+    return true;
+}
+
+bool PdfPaginator::finish(qint64 total)
+{
+    return !m_progress || m_progress(total, total);
+}
+
+void PdfPaginator::beginPage()
+{
+    if (m_style.page == Qt::white) {
+        return; // Paper is white already; leave the PDF without a background
+    }
+    // The painter's origin is the top left of the margins
+    const QPageLayout layout = m_writer.pageLayout();
+    const QRect full = layout.fullRectPixels(m_writer.resolution());
+    const QRect paint = layout.paintRectPixels(m_writer.resolution());
+    m_painter.fillRect(QRectF(full).translated(-paint.topLeft()), m_style.page);
+}
+
+bool PdfPaginator::newPage(qint64 placed, qint64 total)
+{
+    if (m_progress && !m_progress(placed, total)) {
+        return false;
+    }
+    m_writer.newPage();
+    ++m_pageCount;
+    m_y = 0;
+    beginPage();
+    return true;
+}
+
+void PdfPaginator::draw(const PdfExporter::LaidOutBlock &block, qreal offset, qreal height)
+{
+    m_painter.save();
+    m_painter.setClipRect(QRectF(0, m_y, m_width, height));
+    m_painter.translate(0, m_y - offset);
+    m_painter.drawPicture(0, 0, block.picture);
+    m_painter.restore();
+}
@@ -0,0 +1,386 @@
+#include "personaldictionary.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QLockFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(Q_OS_UNIX)
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <io.h>
+#endif
+
+namespace {
+
+const char DictionaryMagic[8] = { 'S', 'C', 'R', 'P', 'D', 'I', 'C', '\0' };
+const quint32 DictionaryVersion = 1;
+const quint32 ByteOrderMark = 0x01020304;
+
+// Log entries are merged into the sorted file once this many have accumulated.
+const int CompactThreshold = 1024;
+
+// Delay before buffered additions are written and fsync'd as one batch.
+const int FlushDelayMs = 2000;
+
+// Longest wait for another instance appending to or compacting the same dictionary.
+const int LockTimeoutMs = 2000;
+
+struct FileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrderMark;
+    quint32 wordCount;
+    quint32 reserved[3];
+};
+static_assert(sizeof(FileHeader) == 32, "FileHeader layout must stay stable");
+
+QHash<QString, PersonalDictionary *> s_instances;
+
+void syncToDisk(QFile &file)
+{
+    file.flush();
+#if defined(Q_OS_UNIX)
+    ::fsync(file.handle());
+#elif defined(Q_OS_WIN)
+    ::_commit(file.handle());
+#endif
+}
+
+} // namespace
+
+PersonalDictionary::PersonalDictionary(const QString &path, QObject *parent)
+    : QObject(parent), m_path(path)
+{
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(FlushDelayMs);
+    connect(&m_flushTimer, &QTimer::timeout, this, &PersonalDictionary::flush);
+
+    map();
+    loadLog();
+    if (m_logWords.size() >= CompactThreshold) {
+        compact();
+    }
+}
+
+PersonalDictionary::~PersonalDictionary()
+{
+    flush();
+    if (!m_logWords.isEmpty()) {
+        compact();
+    }
+    unmap();
+    s_instances.remove(m_path);
+}
+
+PersonalDictionary *PersonalDictionary::user()
+{
+    QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    return instanceFor(QDir(dataDir).absoluteFilePath(QStringLiteral("personal.dict")));
+}
+
+PersonalDictionary *PersonalDictionary::forWorkspace(const QString &rootPath)
+{
+    if (rootPath.isEmpty()) {
+        return nullptr;
+    }
+
+    // Keyed by a hash of the folder so nothing is written into the workspace itself.
+    QString canonical = QDir::cleanPath(QFileInfo(rootPath).absoluteFilePath());
+    QByteArray key = QCryptographicHash::hash(canonical.toUtf8(), QCryptographicHash::Sha1).toHex();
+    QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    return instanceFor(QDir(dataDir).absoluteFilePath(
+        QStringLiteral("workspaces/%1.dict").arg(QString::fromLatin1(key))));
+}
+
+PersonalDictionary *PersonalDictionary::instanceFor(const QString &path)
+{
+    PersonalDictionary *dictionary = s_instances.value(path);
+    if (!dictionary) {
+        dictionary = new PersonalDictionary(path, QCoreApplication::instance());
+        s_instances.insert(path, dictionary);
+    }
+    return dictionary;
+}
+
+bool PersonalDictionary::map()
+{
+    unmap();
+
+    m_file.setFileName(m_path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false; // No words persisted yet
+    }
+    if (m_file.size() < qint64(sizeof(FileHeader))) {
+        m_file.close();
+        return false;
+    }
+
+    const uchar *mapped = m_file.map(0, m_file.size());
+    if (!mapped) {
+        m_file.close();
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, mapped, sizeof(header));
+    const qint64 offsetsSize = (qint64(header.wordCount) + 1) * qint64(sizeof(quint32));
+    bool valid = std::memcmp(header.magic, DictionaryMagic, sizeof(DictionaryMagic)) == 0
+                 && header.version == DictionaryVersion
+                 && header.byteOrderMark == ByteOrderMark
+                 && m_file.size() >= qint64(sizeof(FileHeader)) + offsetsSize;
+    if (valid) {
+        const quint32 *offsets = reinterpret_cast<const quint32 *>(mapped + sizeof(FileHeader));
+        const qint64 stringsSize = m_file.size() - qint64(sizeof(FileHeader)) - offsetsSize;
+        valid = offsets[0] == 0 && qint64(offsets[header.wordCount]) * 2 == stringsSize;
+        if (valid) {
+            m_offsets = offsets;
+            m_strings = reinterpret_cast<const char16_t *>(mapped + sizeof(FileHeader) + offsetsSize);
+            m_sortedCount = header.wordCount;
+            return true;
+        }
+    }
+
+    qWarning() << "PersonalDictionary: Ignoring invalid dictionary file" << m_path;
+    m_file.unmap(const_cast<uchar *>(mapped));
+    m_file.close();
+    return false;
+}
+
+void PersonalDictionary::unmap()
+{
+    if (m_file.isOpen()) {
+        m_file.close(); // Also releases the mapping
+    }
+    m_offsets = nullptr;
+    m_strings = nullptr;
+    m_sortedCount = 0;
+}
+
+void PersonalDictionary::loadLog()
+{
+    QFile log(logPath());
+    if (!log.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    const QByteArray data = log.readAll();
+    const QList<QByteArray> lines = data.split('\n');
+    for (const QByteArray &line : lines) {
+        // A line torn by a crash is at worst a truncated word; re-adding it fixes it.
+        QString word = QString::fromUtf8(line.trimmed());
+        if (!word.isEmpty() && !containsExact(word)) {
+            m_logWords.insert(word);
+        }
+    }
+}
+
+QString PersonalDictionary::logPath() const
+{
+    return m_path + QStringLiteral(".log");
+}
+
+QString PersonalDictionary::lockPath() const
+{
+    return m_path + QStringLiteral(".lock");
+}
+
+QStringView PersonalDictionary::sortedWordAt(quint32 index) const
+{
+    return QStringView(m_strings + m_offsets[index], qsizetype(m_offsets[index + 1] - m_offsets[index]));
+}
+
+bool PersonalDictionary::containsExact(QStringView word) const
+{
+    if (!m_logWords.isEmpty() && m_logWords.contains(word.toString())) {
+        return true;
+    }
+
+    quint32 low = 0;
+    quint32 high = m_sortedCount;
+    while (low < high) {
+        quint32 mid = low + (high - low) / 2;
+        int order = sortedWordAt(mid).compare(word);
+        if (order == 0) {
+            return true;
+        }
+        if (order < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return false;
+}
+
+bool PersonalDictionary::contains(QStringView word) const
+{
+    if (word.isEmpty()) {
+        return false;
+    }
+    if (containsExact(word)) {
+        return true;
+    }
+
+    // Like Hunspell, a lower-case entry also accepts "Word" and "WORD",
+    // and a capitalised entry accepts its all-caps form.
+    if (!word.front().isUpper()) {
+        return false;
+    }
+    const QString lower = word.toString().toLower();
+    if (containsExact(lower)) {
+        return true;
+    }
+    QString title = lower;
+    title[0] = word.front();
+    return title != word && containsExact(title);
+}
+
+bool PersonalDictionary::addWord(const QString &word)
+{
+    if (word.isEmpty() || containsExact(word)) {
+        return false;
+    }
+
+    m_logWords.insert(word);
+    m_unflushed.append(word);
+    m_flushTimer.start();
+    emit wordsChanged();
+    return true;
+}
+
+int PersonalDictionary::wordCount() const
+{
+    return int(m_sortedCount) + m_logWords.size();
+}
+
+void PersonalDictionary::flush()
+{
+    m_flushTimer.stop();
+    if (m_unflushed.isEmpty()) {
+        return;
+    }
+
+    QDir().mkpath(QFileInfo(m_path).absolutePath());
+    QLockFile lock(lockPath());
+    if (!lock.tryLock(LockTimeoutMs)) {
+        qWarning() << "PersonalDictionary: Cannot lock" << lock.fileName();
+        m_flushTimer.start(); // Try again with the next batch
+        return;
+    }
+    if (!appendUnflushed()) {
+        m_flushTimer.start(); // Try again with the next batch
+        return;
+    }
+    lock.unlock();
+
+    if (m_logWords.size() >= CompactThreshold) {
+        compact();
+    }
+}
+
+bool PersonalDictionary::appendUnflushed()
+{
+    if (m_unflushed.isEmpty()) {
+        return true;
+    }
+
+    QFile log(logPath());
+    if (!log.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "PersonalDictionary: Cannot open" << log.fileName() << log.errorString();
+        return false;
+    }
+
+    QByteArray batch;
+    for (const QString &word : std::as_const(m_unflushed)) {
+        batch += word.toUtf8();
+        batch += '\n';
+    }
+    if (log.write(batch) != batch.size()) {
+        qWarning() << "PersonalDictionary: Failed to append to" << log.fileName() << log.errorString();
+        return false;
+    }
+    syncToDisk(log);
+    m_unflushed.clear();
+    return true;
+}
+
+bool PersonalDictionary::compact()
+{
+    // Other instances of the application append to the same log; while the
+    // lock is held nobody does, so the log can be merged and truncated
+    QDir().mkpath(QFileInfo(m_path).absolutePath());
+    QLockFile lock(lockPath());
+    if (!lock.tryLock(LockTimeoutMs)) {
+        qWarning() << "PersonalDictionary: Cannot lock" << lock.fileName();
+        return false;
+    }
+
+    // Our own words go to the log first, so it holds every word should the rewrite fail
+    if (!appendUnflushed()) {
+        return false;
+    }
+    m_flushTimer.stop();
+
+    // The files on disk may hold words other instances added since we read them
+    map();
+    loadLog();
+
+    std::vector<QString> words;
+    words.reserve(m_sortedCount + quint32(m_logWords.size()));
+    for (quint32 i = 0; i < m_sortedCount; ++i) {
+        words.push_back(sortedWordAt(i).toString());
+    }
+    for (const QString &word : std::as_const(m_logWords)) {
+        words.push_back(word);
+    }
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, DictionaryMagic, sizeof(DictionaryMagic));
+    header.version = DictionaryVersion;
+    header.byteOrderMark = ByteOrderMark;
+    header.wordCount = quint32(words.size());
+
+    std::vector<quint32> offsets;
+    offsets.reserve(words.size() + 1);
+    offsets.push_back(0);
+    for (const QString &word : words) {
+        offsets.push_back(offsets.back() + quint32(word.size()));
+    }
+
+    // Release the mapping before replacing the file; Windows refuses otherwise.
+    unmap();
+
+    QSaveFile out(m_path);
+    bool written = out.open(QIODevice::WriteOnly);
+    if (written) {
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(offsets.data()), qint64(offsets.size() * sizeof(quint32)));
+        for (const QString &word : words) {
+            out.write(reinterpret_cast<const char *>(word.utf16()), qint64(word.size()) * 2);
+        }
+        written = out.commit();
+    }
+
+    if (!written) {
+        // The log still holds every word, so nothing is lost; retry on the next compaction.
+        qWarning() << "PersonalDictionary: Failed to write" << m_path << out.errorString();
+        map();
+        return false;
+    }
+
+    QFile::remove(logPath());
+    m_logWords.clear();
+    map();
+    return true;
+}
@@ -263,6 +263,11 @@ QString SidebarFileExplorer::currentPath() const
     return fileSystemModel->rootPath();
 }
 
+QStringList SidebarFileExplorer::nameFilters() const
+{
+    return fileSystemModel->nameFilters();
+}
+
 void SidebarFileExplorer::refresh()
 {
     QModelIndex currentIndex = fileTreeView->rootIndex();
@@ -1,21 +1,219 @@
 // spellchecker.cpp
 #include "spellchecker.h"
+#include "compileddictionary.h"
+#include "personaldictionary.h"
 #include <hunspell/hunspell.hxx>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtConcurrent/QtConcurrentTask>
+#include <QCache>
+#include <QHash>
+#include <QMutex>
 #include <QStandardPaths>
+#include <QThreadPool>
 #include <QDir>
 #include <QFile>
 #include <QRegularExpression>
 #include <QDebug>
 
+namespace {
+
+std::shared_ptr<Hunspell> createHunspell(const QString &affPath, const QString &dicPath)
+{
+    try {
+        return std::make_shared<Hunspell>(affPath.toLocal8Bit().constData(),
+                                          dicPath.toLocal8Bit().constData());
+    } catch (const std::exception& e) {
+        qWarning() << "SpellChecker: Exception caught while initializing Hunspell from" << affPath << ":" << e.what();
+    } catch (...) {
+        qWarning() << "SpellChecker: Unknown exception caught while initializing Hunspell from" << affPath;
+    }
+    return nullptr;
+}
+
+QStringList suggestWith(Hunspell *hunspell, const QString &word)
+{
+    QStringList suggestions;
+    QByteArray utf8Word = word.toUtf8();
+
+    try {
+        char **sug;
+        int sugCount = hunspell->suggest(&sug, utf8Word.constData());
+
+        for (int i = 0; i < sugCount; ++i) {
+            suggestions << QString::fromUtf8(sug[i]);
+        }
+
+        hunspell->free_list(&sug, sugCount);
+
+    } catch (const std::exception& e) {
+        qWarning() << "SpellChecker: Exception in getSuggestions for word:" << word << e.what();
+    } catch (...) {
+        qWarning() << "SpellChecker: Unknown exception in getSuggestions for word:" << word;
+    }
+
+    return suggestions;
+}
+
+const int MaxPrecomputedWords = 32;
+
+} // namespace
+
+/**
+ * @brief Hunspell for checking one language, shared by every SpellChecker using it.
+ *
+ * With a compiled dictionary most words never reach Hunspell, so it is only
+ * loaded, in the background, once a word misses the compiled set. Used on
+ * the GUI thread only.
+ */
+struct SpellChecker::HunspellBackend
+{
+    QString affPath;
+    QString dicPath;
+    std::shared_ptr<Hunspell> hunspell;
+    QFuture<std::shared_ptr<Hunspell>> loading;
+    bool loadStarted = false;
+
+    // The instance if it has loaded; never starts a load
+    Hunspell *loaded()
+    {
+        if (!hunspell && loadStarted && loading.isFinished()) {
+            hunspell = loading.result();
+        }
+        return hunspell.get();
+    }
+
+    void loadInBackground()
+    {
+        if (!loadStarted) {
+            loadStarted = true;
+            loading = QtConcurrent::run(createHunspell, affPath, dicPath);
+        }
+    }
+
+    // Blocks until the instance is there, joining a background load in flight
+    Hunspell *loadNow()
+    {
+        if (loadStarted) {
+            loading.waitForFinished();
+            return loaded();
+        }
+        hunspell = createHunspell(affPath, dicPath);
+        loadStarted = static_cast<bool>(hunspell);
+        return hunspell.get();
+    }
+
+    static std::shared_ptr<HunspellBackend> forDictionary(const QString &affPath, const QString &dicPath)
+    {
+        static QHash<QString, std::weak_ptr<HunspellBackend>> backends;
+        std::weak_ptr<HunspellBackend> &entry = backends[dicPath];
+        std::shared_ptr<HunspellBackend> backend = entry.lock();
+        if (!backend) {
+            backend = std::make_shared<HunspellBackend>();
+            backend->affPath = affPath;
+            backend->dicPath = dicPath;
+            entry = backend;
+        }
+        return backend;
+    }
+};
+
+/**
+ * @brief Suggestion state of one language, shared by every SpellChecker using it.
+ *
+ * Jobs run on the engine's single-thread pool, the only place its Hunspell
+ * instance is touched; the cache is guarded by a mutex because the GUI
+ * thread reads it when building the context menu. Engines are created and
+ * released on the GUI thread, and jobs only hold a plain pointer, since the
+ * destructor waits for them.
+ */
+struct SpellChecker::SuggestionEngine
+{
+    QString affPath;
+    QString dicPath;
+    std::shared_ptr<Hunspell> hunspell;
+    QThreadPool pool;
+
+    QMutex mutex;
+    QCache<QString, QStringList> cache{512};
+
+    SuggestionEngine(const QString &affPath, const QString &dicPath)
+        : affPath(affPath), dicPath(dicPath)
+    {
+        pool.setMaxThreadCount(1);
+    }
+
+    ~SuggestionEngine()
+    {
+        pool.clear();
+        pool.waitForDone();
+    }
+
+    // The engine for a dictionary, created on first use; GUI thread only
+    static std::shared_ptr<SuggestionEngine> forDictionary(const QString &affPath, const QString &dicPath)
+    {
+        static QHash<QString, std::weak_ptr<SuggestionEngine>> engines;
+        std::weak_ptr<SuggestionEngine> &entry = engines[dicPath];
+        std::shared_ptr<SuggestionEngine> engine = entry.lock();
+        if (!engine) {
+            engine = std::make_shared<SuggestionEngine>(affPath, dicPath);
+            entry = engine;
+        }
+        return engine;
+    }
+
+    bool cached(const QString &word, QStringList *suggestions)
+    {
+        QMutexLocker locker(&mutex);
+        if (QStringList *entry = cache.object(word)) {
+            *suggestions = *entry;
+            return true;
+        }
+        return false;
+    }
+
+    void store(const QString &word, const QStringList &suggestions)
+    {
+        QMutexLocker locker(&mutex);
+        cache.insert(word, new QStringList(suggestions));
+    }
+
+    // Runs on the suggestion pool only.
+    QStringList suggest(const QString &word)
+    {
+        QStringList suggestions;
+        if (cached(word, &suggestions)) {
+            return suggestions;
+        }
+
+        if (!hunspell) {
+            hunspell = createHunspell(affPath, dicPath);
+            if (!hunspell) {
+                return suggestions;
+            }
+        }
+
+        suggestions = suggestWith(hunspell.get(), word);
+        store(word, suggestions);
+        return suggestions;
+    }
+};
+
 SpellChecker::SpellChecker(QObject *parent)
-    : QObject(parent), hunspell(nullptr) // , codec(nullptr) // <-- REMOVE INITIALIZATION
+    : QObject(parent)
 {
     // Initialization happens in loadDictionary
+    hunspellLoader = new QFutureWatcher<std::shared_ptr<Hunspell>>(this);
+    connect(hunspellLoader, &QFutureWatcherBase::finished, this, &SpellChecker::onHunspellLoaded);
+    userDictionary = PersonalDictionary::user();
+    connect(userDictionary, &PersonalDictionary::wordsChanged, this, &SpellChecker::personalDictionaryChanged);
 }
 
 SpellChecker::~SpellChecker()
 {
-    // std::unique_ptr<Hunspell> will automatically call the destructor
+    // The engine may serve other editors; only this one's idle work is dropped
+    for (QFuture<QStringList> &future : pendingPrecomputes) {
+        future.cancel();
+    }
 }
 
 bool SpellChecker::loadDictionary(const QString &language)
@@ -50,35 +248,94 @@ bool SpellChecker::loadDictionary(const QString &language)
         return false;
     }
 
-    try {
-        // Create a new Hunspell instance.
-        hunspell.reset(new Hunspell(affPath.toLocal8Bit().constData(),
-                                    dicPath.toLocal8Bit().constData()));
-
-        // --- Get Encoding (Informational, but we'll assume UTF-8 for simplicity) ---
-        // const char* encoding_cstr = hunspell->get_dic_encoding();
-        // QString encoding = QString::fromLatin1(encoding_cstr);
-        // qDebug() << "SpellChecker: Dictionary" << language << "uses encoding:" << encoding;
-        // Most modern dictionaries are UTF-8. Hunspell internally handles conversion
-        // reasonably well if we pass UTF-8 encoded strings from QString.
-
-        qDebug() << "SpellChecker: Successfully loaded dictionary for" << language;
+    // Stop watching the previous language; its load may still serve other editors.
+    hunspellLoader->setFuture(QFuture<std::shared_ptr<Hunspell>>());
+    watchingHunspellLoad = false;
+    compiledDictionary.reset();
+    hunspellBackend = HunspellBackend::forDictionary(affPath, dicPath);
+
+    for (QFuture<QStringList> &future : pendingPrecomputes) {
+        future.cancel();
+    }
+    pendingPrecomputes.clear();
+    suggestionEngine = SuggestionEngine::forDictionary(affPath, dicPath);
+
+    const QString cachePath = CompiledDictionary::cachePathForLanguage(language);
+    std::unique_ptr<CompiledDictionary> compiled(new CompiledDictionary);
+    if (compiled->open(cachePath, affPath, dicPath)) {
+        compiledDictionary = std::move(compiled);
+        qDebug() << "SpellChecker: Mapped compiled dictionary for" << language
+                 << "with" << compiledDictionary->wordCount() << "word forms";
         return true;
+    }
 
-    } catch (const std::exception& e) {
-        qWarning() << "SpellChecker: Exception caught while initializing Hunspell for" << language << ":" << e.what();
-        hunspell.reset();
-        return false;
-    } catch (...) {
-        qWarning() << "SpellChecker: Unknown exception caught while initializing Hunspell for" << language;
-        hunspell.reset();
+    // Without the compiled set every word goes to Hunspell, so it is needed right away.
+    if (!hunspellBackend->loadNow()) {
         return false;
     }
+
+    // --- Get Encoding (Informational, but we'll assume UTF-8 for simplicity) ---
+    // const char* encoding_cstr = hunspell->get_dic_encoding();
+    // QString encoding = QString::fromLatin1(encoding_cstr);
+    // qDebug() << "SpellChecker: Dictionary" << language << "uses encoding:" << encoding;
+    // Most modern dictionaries are UTF-8. Hunspell internally handles conversion
+    // reasonably well if we pass UTF-8 encoded strings from QString.
+
+    // Compile the word forms once so later loads can skip parsing the .aff/.dic pair.
+    CompiledDictionary::compileInBackground(affPath, dicPath, cachePath);
+
+    qDebug() << "SpellChecker: Successfully loaded dictionary for" << language;
+    return true;
+}
+
+void SpellChecker::onHunspellLoaded()
+{
+    if (hunspellBackend && hunspellBackend->loaded()) {
+        emit dictionaryReady();
+    }
+}
+
+Hunspell *SpellChecker::hunspellInstance() const
+{
+    if (!hunspellBackend) {
+        return nullptr;
+    }
+    if (Hunspell *instance = hunspellBackend->loaded()) {
+        return instance;
+    }
+    // First word the compiled dictionary does not know: load in the background
+    // and have dictionaryReady() trigger a re-check
+    hunspellBackend->loadInBackground();
+    if (!watchingHunspellLoad) {
+        watchingHunspellLoad = true;
+        hunspellLoader->setFuture(hunspellBackend->loading);
+    }
+    return nullptr;
 }
 
 bool SpellChecker::isWordMisspelled(const QString &word) const
 {
-    if (!hunspell || word.isEmpty()) {
+    if (word.isEmpty()) {
+        return false;
+    }
+
+    // Fast path: the compiled dictionary confirms most correct words without Hunspell.
+    if (compiledDictionary && compiledDictionary->contains(word)) {
+        return false;
+    }
+
+    // Words the user accepted, shared with every other editor.
+    if (userDictionary && userDictionary->contains(word)) {
+        return false;
+    }
+    if (workspaceDictionary && workspaceDictionary->contains(word)) {
+        return false;
+    }
+
+    // Until the background load finishes, unknown words are not flagged;
+    // dictionaryReady() prompts a re-check.
+    Hunspell *backend = hunspellInstance();
+    if (!backend) {
         return false;
     }
 
@@ -87,7 +344,7 @@ bool SpellChecker::isWordMisspelled(const QString &word) const
 
     try {
         // Hunspell::spell returns 0 if the word is NOT found (misspelled)
-        int result = hunspell->spell(utf8Word.constData()); // <-- PASS UTF-8 DATA
+        int result = backend->spell(utf8Word.constData()); // <-- PASS UTF-8 DATA
         return (result == 0);
     } catch (const std::exception& e) {
         qWarning() << "SpellChecker: Exception in isWordMisspelled for word:" << word << e.what();
@@ -101,54 +358,115 @@ bool SpellChecker::isWordMisspelled(const QString &word) const
 QStringList SpellChecker::getSuggestions(const QString &word) const
 {
     QStringList suggestions;
-    if (!hunspell) {
+    if (cachedSuggestions(word, &suggestions)) {
         return suggestions;
     }
 
-    // Convert QString (UTF-16) to UTF-8 for Hunspell
-    QByteArray utf8Word = word.toUtf8(); // <-- USE toUtf8()
+    Hunspell *backend = hunspellInstance();
+    if (!backend) {
+        return suggestions;
+    }
 
-    try {
-        char **sug;
-        int sugCount = hunspell->suggest(&sug, utf8Word.constData()); // <-- PASS UTF-8 DATA
+    suggestions = suggestWith(backend, word);
+    if (suggestionEngine) {
+        suggestionEngine->store(word, suggestions);
+    }
+    return suggestions;
+}
 
-        for (int i = 0; i < sugCount; ++i) {
-            // Convert Hunspell's C-string (assumed UTF-8) back to QString
-            QString suggestion = QString::fromUtf8(sug[i]); // <-- USE fromUtf8()
-            suggestions << suggestion;
-        }
+bool SpellChecker::cachedSuggestions(const QString &word, QStringList *suggestions) const
+{
+    return suggestionEngine && suggestionEngine->cached(word, suggestions);
+}
 
-        hunspell->free_list(&sug, sugCount);
+QFuture<QStringList> SpellChecker::requestSuggestions(const QString &word)
+{
+    if (!suggestionEngine) {
+        return QFuture<QStringList>();
+    }
+    SuggestionEngine *engine = suggestionEngine.get();
+    return QtConcurrent::task([engine, word](QPromise<QStringList> &promise) {
+               if (promise.isCanceled()) {
+                   return;
+               }
+               promise.addResult(engine->suggest(word));
+           })
+        .onThreadPool(engine->pool)
+        .withPriority(1)
+        .spawn();
+}
 
-    } catch (const std::exception& e) {
-        qWarning() << "SpellChecker: Exception in getSuggestions for word:" << word << e.what();
-    } catch (...) {
-        qWarning() << "SpellChecker: Unknown exception in getSuggestions for word:" << word;
+void SpellChecker::precomputeSuggestions(const QStringList &words)
+{
+    if (!suggestionEngine) {
+        return;
     }
 
-    return suggestions;
+    pendingPrecomputes.erase(std::remove_if(pendingPrecomputes.begin(), pendingPrecomputes.end(),
+                                            [](const QFuture<QStringList> &future) { return future.isFinished(); }),
+                             pendingPrecomputes.end());
+
+    SuggestionEngine *engine = suggestionEngine.get();
+    QStringList dummy;
+    for (const QString &word : words) {
+        if (pendingPrecomputes.size() >= MaxPrecomputedWords) {
+            break;
+        }
+        if (engine->cached(word, &dummy)) {
+            continue;
+        }
+        pendingPrecomputes.append(QtConcurrent::task([engine, word](QPromise<QStringList> &promise) {
+                                      if (!promise.isCanceled()) {
+                                          promise.addResult(engine->suggest(word));
+                                      }
+                                  })
+                                      .onThreadPool(engine->pool)
+                                      .withPriority(0)
+                                      .spawn());
+    }
 }
 
 void SpellChecker::addWord(const QString &word)
 {
-    if (!hunspell) {
+    if (userDictionary && userDictionary->addWord(word)) {
+        qDebug() << "SpellChecker: Added word to personal dictionary:" << word;
+    }
+}
+
+void SpellChecker::addWordToWorkspace(const QString &word)
+{
+    if (!workspaceDictionary) {
+        addWord(word);
         return;
     }
+    if (workspaceDictionary->addWord(word)) {
+        qDebug() << "SpellChecker: Added word to workspace dictionary:" << word;
+    }
+}
 
-    // Convert QString (UTF-16) to UTF-8 for Hunspell
-    QByteArray utf8Word = word.toUtf8(); // <-- USE toUtf8()
+void SpellChecker::setWorkspacePath(const QString &rootPath)
+{
+    PersonalDictionary *dictionary = PersonalDictionary::forWorkspace(rootPath);
+    if (dictionary == workspaceDictionary) {
+        return;
+    }
 
-    try {
-        hunspell->add(utf8Word.constData()); // <-- PASS UTF-8 DATA
-        qDebug() << "SpellChecker: Added word to dictionary:" << word;
-    } catch (const std::exception& e) {
-        qWarning() << "SpellChecker: Exception in addWord for word:" << word << e.what();
-    } catch (...) {
-        qWarning() << "SpellChecker: Unknown exception in addWord for word:" << word;
+    if (workspaceDictionary) {
+        disconnect(workspaceDictionary, nullptr, this, nullptr);
     }
+    workspaceDictionary = dictionary;
+    if (workspaceDictionary) {
+        connect(workspaceDictionary, &PersonalDictionary::wordsChanged, this, &SpellChecker::personalDictionaryChanged);
+    }
+    emit personalDictionaryChanged();
+}
+
+bool SpellChecker::hasWorkspaceDictionary() const
+{
+    return !workspaceDictionary.isNull();
 }
 
 bool SpellChecker::isInitialized() const
 {
-    return static_cast<bool>(hunspell);
+    return static_cast<bool>(compiledDictionary) || (hunspellBackend && hunspellBackend->hunspell);
 }
@@ -0,0 +1,351 @@
+#include "spelltokenizer.h"
+#include <QChar>
+#include <algorithm>
+
+namespace {
+
+struct Range {
+    int start;
+    int end;
+};
+
+char32_t codePointAt(QStringView text, int index, int *units)
+{
+    const QChar c = text.at(index);
+    if (c.isHighSurrogate() && index + 1 < text.size() && text.at(index + 1).isLowSurrogate()) {
+        *units = 2;
+        return QChar::surrogateToUcs4(c, text.at(index + 1));
+    }
+    *units = 1;
+    return c.unicode();
+}
+
+bool isWordCodePoint(char32_t cp)
+{
+    return QChar::isLetter(cp) || QChar::isMark(cp);
+}
+
+bool isApostrophe(char32_t cp)
+{
+    return cp == U'\'' || cp == U'\u2019';
+}
+
+// Characters that never appear inside a prose word but are common inside
+// identifiers, paths, e-mail addresses and other technical tokens.
+bool isTechnicalCodePoint(char32_t cp)
+{
+    switch (cp) {
+    case U'_': case U'/': case U'\\': case U'@': case U'=': case U'<': case U'>':
+    case U'|': case U'{': case U'}': case U'$': case U'%': case U'#': case U'&':
+    case U'+': case U'^': case U'~': case U'*':
+        return true;
+    default:
+        return QChar::isNumber(cp);
+    }
+}
+
+bool startsWithIgnoringCase(QStringView text, QLatin1String prefix)
+{
+    return text.startsWith(prefix, Qt::CaseInsensitive);
+}
+
+// Emits the words of one whitespace-delimited chunk [start, end).
+void tokenizeChunk(QStringView text, int start, int end, QVector<SpellToken> &tokens)
+{
+    // Trim leading and trailing punctuation (quotes, brackets, emphasis markers...).
+    int units = 1;
+    while (start < end && !isWordCodePoint(codePointAt(text, start, &units))) {
+        start += units;
+    }
+    while (end > start) {
+        int back = (end - 2 >= start && text.at(end - 1).isLowSurrogate()) ? 2 : 1;
+        if (isWordCodePoint(codePointAt(text, end - back, &units))) {
+            break;
+        }
+        end -= back;
+    }
+    if (start >= end) {
+        return;
+    }
+
+    QStringView chunk = text.mid(start, end - start);
+    if (chunk.contains(QLatin1String("://")) || startsWithIgnoringCase(chunk, QLatin1String("www."))) {
+        return; // Bare URL
+    }
+
+    // Identifiers, paths, numbers and dotted/qualified names are skipped as a whole.
+    for (int i = start; i < end; i += units) {
+        char32_t cp = codePointAt(text, i, &units);
+        if (isTechnicalCodePoint(cp)) {
+            return;
+        }
+        if ((cp == U'.' || cp == U':') && i > start && i + 1 < end) {
+            int nextUnits = 1;
+            if (isWordCodePoint(codePointAt(text, i + 1, &nextUnits))) {
+                return; // file.ext, e.g, std::vector
+            }
+        }
+    }
+
+    // Split the remaining chunk into words, allowing apostrophes between letters.
+    int i = start;
+    while (i < end) {
+        char32_t cp = codePointAt(text, i, &units);
+        if (!isWordCodePoint(cp)) {
+            i += units;
+            continue;
+        }
+
+        int wordStart = i;
+        bool hasLower = false;
+        bool hasUpper = false;
+        bool camelCase = false;
+        bool previousLower = false;
+
+        while (i < end) {
+            cp = codePointAt(text, i, &units);
+            if (isWordCodePoint(cp)) {
+                if (QChar::isUpper(cp)) {
+                    hasUpper = true;
+                    if (previousLower) {
+                        camelCase = true;
+                    }
+                    previousLower = false;
+                } else if (QChar::isLower(cp)) {
+                    hasLower = true;
+                    previousLower = true;
+                }
+                i += units;
+                continue;
+            }
+            if (isApostrophe(cp) && i + units < end) {
+                int nextUnits = 1;
+                if (isWordCodePoint(codePointAt(text, i + units, &nextUnits))) {
+                    i += units;
+                    continue;
+                }
+            }
+            break;
+        }
+
+        int length = i - wordStart;
+        bool acronym = hasUpper && !hasLower && length > 1;
+        if (!camelCase && !acronym) {
+            tokens.append({wordStart, length});
+        }
+    }
+}
+
+// Emits words for [from, to), splitting on whitespace.
+void tokenizeRange(QStringView text, int from, int to, QVector<SpellToken> &tokens)
+{
+    int i = from;
+    while (i < to) {
+        while (i < to && text.at(i).isSpace()) {
+            ++i;
+        }
+        int chunkStart = i;
+        while (i < to && !text.at(i).isSpace()) {
+            ++i;
+        }
+        if (i > chunkStart) {
+            tokenizeChunk(text, chunkStart, i, tokens);
+        }
+    }
+}
+
+// Returns the index of the closing ')' for a destination starting at @p open, or -1.
+int findClosingParen(QStringView line, int open)
+{
+    int depth = 0;
+    for (int i = open; i < line.size(); ++i) {
+        QChar c = line.at(i);
+        if (c == u'\\') {
+            ++i;
+        } else if (c == u'(') {
+            ++depth;
+        } else if (c == u')') {
+            if (--depth == 0) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+// Collects the spans of a raw Markdown line that never contain prose.
+QVector<Range> nonProseRanges(QStringView line)
+{
+    QVector<Range> ranges;
+    const int size = line.size();
+
+    // Link reference definition: [label]: destination "title"
+    int indent = 0;
+    while (indent < size && indent < 3 && line.at(indent) == u' ') {
+        ++indent;
+    }
+    if (indent < size && line.at(indent) == u'[') {
+        int close = line.indexOf(QLatin1String("]:"), indent);
+        if (close > indent) {
+            ranges.append({indent, size});
+            return ranges;
+        }
+    }
+
+    int i = 0;
+    while (i < size) {
+        QChar c = line.at(i);
+
+        if (c == u'\\') {
+            i += 2;
+            continue;
+        }
+
+        if (c == u'`') {
+            int runLength = 0;
+            while (i + runLength < size && line.at(i + runLength) == u'`') {
+                ++runLength;
+            }
+            // Look for a closing run of exactly the same length.
+            int j = i + runLength;
+            int closeStart = -1;
+            while (j < size) {
+                if (line.at(j) != u'`') {
+                    ++j;
+                    continue;
+                }
+                int closeLength = 0;
+                while (j + closeLength < size && line.at(j + closeLength) == u'`') {
+                    ++closeLength;
+                }
+                if (closeLength == runLength) {
+                    closeStart = j;
+                    break;
+                }
+                j += closeLength;
+            }
+            if (closeStart >= 0) {
+                ranges.append({i, closeStart + runLength});
+                i = closeStart + runLength;
+            } else {
+                i += runLength;
+            }
+            continue;
+        }
+
+        if (c == u'<' && i + 1 < size) {
+            QChar next = line.at(i + 1);
+            if (next.isLetter() || next == u'/' || next == u'!' || next == u'?') {
+                int close = line.indexOf(u'>', i + 1);
+                if (close > i) {
+                    ranges.append({i, close + 1});
+                    i = close + 1;
+                    continue;
+                }
+            }
+        }
+
+        if (c == u']' && i + 1 < size) {
+            QChar next = line.at(i + 1);
+            if (next == u'(') {
+                int close = findClosingParen(line, i + 1);
+                if (close > i) {
+                    ranges.append({i + 1, close + 1});
+                    i = close + 1;
+                    continue;
+                }
+            } else if (next == u'[') {
+                int close = line.indexOf(u']', i + 2);
+                if (close > i) {
+                    ranges.append({i + 1, close + 1});
+                    i = close + 1;
+                    continue;
+                }
+            }
+        }
+
+        ++i;
+    }
+
+    return ranges;
+}
+
+} // namespace
+
+namespace SpellTokenizer
+{
+
+QVector<SpellToken> tokenizeMarkdownLine(QStringView line)
+{
+    QVector<SpellToken> tokens;
+    const QVector<Range> skipped = nonProseRanges(line);
+
+    int position = 0;
+    for (const Range &range : skipped) {
+        if (range.start > position) {
+            tokenizeRange(line, position, range.start, tokens);
+        }
+        position = std::max(position, range.end);
+    }
+    if (position < line.size()) {
+        tokenizeRange(line, position, line.size(), tokens);
+    }
+    return tokens;
+}
+
+QVector<SpellToken> tokenizeProse(QStringView text)
+{
+    QVector<SpellToken> tokens;
+    tokenizeRange(text, 0, text.size(), tokens);
+    return tokens;
+}
+
+bool advanceCodeFence(QStringView line, CodeFence &fence)
+{
+    int indent = 0;
+    while (indent < line.size() && indent < 3 && line.at(indent) == u' ') {
+        ++indent;
+    }
+    const QStringView rest = line.mid(indent);
+    if (rest.isEmpty() || (rest.at(0) != u'`' && rest.at(0) != u'~')) {
+        return false;
+    }
+    const QChar marker = rest.at(0);
+    int run = 0;
+    while (run < rest.size() && rest.at(run) == marker) {
+        ++run;
+    }
+    if (run < 3) {
+        return false;
+    }
+
+    if (fence.length > 0) {
+        // Closing fences carry no info string
+        if (marker != fence.marker || run < fence.length || !rest.mid(run).trimmed().isEmpty()) {
+            return false;
+        }
+        fence = CodeFence();
+        return true;
+    }
+
+    // A backtick fence's info string may not contain backticks
+    if (marker == u'`' && rest.mid(run).contains(u'`')) {
+        return false;
+    }
+    fence.marker = marker;
+    fence.length = run;
+    return true;
+}
+
+SpellToken tokenAt(const QVector<SpellToken> &tokens, int position)
+{
+    auto it = std::upper_bound(tokens.cbegin(), tokens.cend(), position,
+                               [](int pos, const SpellToken &token) { return pos < token.start; });
+    if (it == tokens.cbegin()) {
+        return SpellToken();
+    }
+    --it;
+    return (position <= it->end()) ? *it : SpellToken();
+}
+
+} // namespace SpellTokenizer
@@ -0,0 +1,136 @@
+#include "taskprogresswidget.h"
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QProgressBar>
+#include <QToolButton>
+
+TaskProgressWidget::TaskProgressWidget(QWidget *parent)
+    : QWidget(parent)
+{
+    QHBoxLayout *layout = new QHBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->setSpacing(4);
+
+    label = new QLabel(this);
+    progressBar = new QProgressBar(this);
+    progressBar->setMaximumWidth(160);
+    progressBar->setMaximumHeight(14);
+    progressBar->setTextVisible(false);
+
+    cancelButton = new QToolButton(this);
+    cancelButton->setAutoRaise(true);
+    cancelButton->setToolTip(tr("Cancel"));
+    QIcon cancelIcon = QIcon::fromTheme("process-stop", QIcon::fromTheme("dialog-cancel"));
+    if (cancelIcon.isNull()) {
+        cancelButton->setText(QStringLiteral("✕"));
+    } else {
+        cancelButton->setIcon(cancelIcon);
+    }
+    connect(cancelButton, &QToolButton::clicked, this, &TaskProgressWidget::cancelCurrentTask);
+
+    layout->addWidget(label);
+    layout->addWidget(progressBar);
+    layout->addWidget(cancelButton);
+
+    hide();
+}
+
+int TaskProgressWidget::startTask(const QString &taskLabel, std::function<void()> onCancel)
+{
+    Task task;
+    task.id = nextTaskId++;
+    task.label = taskLabel;
+    task.done = 0;
+    task.total = 0;
+    task.onCancel = std::move(onCancel);
+    task.canceled = false;
+    tasks.append(task);
+    updateDisplay();
+    return task.id;
+}
+
+void TaskProgressWidget::setTaskProgress(int id, qint64 done, qint64 total)
+{
+    if (Task *task = findTask(id)) {
+        task->done = done;
+        task->total = total;
+        if (task == &tasks.last()) {
+            updateDisplay();
+        }
+    }
+}
+
+void TaskProgressWidget::setTaskLabel(int id, const QString &taskLabel)
+{
+    if (Task *task = findTask(id)) {
+        task->label = taskLabel;
+        if (task == &tasks.last()) {
+            updateDisplay();
+        }
+    }
+}
+
+void TaskProgressWidget::finishTask(int id)
+{
+    for (int i = 0; i < tasks.size(); ++i) {
+        if (tasks[i].id == id) {
+            tasks.removeAt(i);
+            break;
+        }
+    }
+    updateDisplay();
+}
+
+void TaskProgressWidget::cancelCurrentTask()
+{
+    if (tasks.isEmpty()) {
+        return;
+    }
+    // The callback usually ends up in finishTask(), so run it on a copy.
+    Task &task = tasks.last();
+    if (task.canceled) {
+        return;
+    }
+    task.canceled = true;
+    std::function<void()> onCancel = task.onCancel;
+    cancelButton->setEnabled(false);
+    if (onCancel) {
+        onCancel();
+    }
+}
+
+void TaskProgressWidget::updateDisplay()
+{
+    if (tasks.isEmpty()) {
+        hide();
+        return;
+    }
+
+    const Task &task = tasks.last();
+    QString text = task.label;
+    if (tasks.size() > 1) {
+        text += tr(" (+%1 more)").arg(tasks.size() - 1);
+    }
+    label->setText(text);
+
+    if (task.total > 0) {
+        // Scale to a fixed range; byte counts of large files overflow int.
+        progressBar->setRange(0, 1000);
+        progressBar->setValue(int(qMin<qint64>(1000, task.done * 1000 / task.total)));
+    } else {
+        progressBar->setRange(0, 0); // Busy indicator
+    }
+
+    cancelButton->setEnabled(task.onCancel && !task.canceled);
+    show();
+}
+
+TaskProgressWidget::Task *TaskProgressWidget::findTask(int id)
+{
+    for (Task &task : tasks) {
+        if (task.id == id) {
+            return &task;
+        }
+    }
+    return nullptr;
+}
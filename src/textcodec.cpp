@@ -0,0 +1,462 @@
+#include "textcodec.h"
+#include <QtAlgorithms>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTCODEC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(TEXTCODEC_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define TEXTCODEC_AVX2 1
+#define TEXTCODEC_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(TEXTCODEC_SSE2) && defined(_MSC_VER)
+#define TEXTCODEC_AVX2 1
+#define TEXTCODEC_TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace {
+
+const char16_t ReplacementCharacter = 0xFFFD;
+
+// --- Scalar kernels -------------------------------------------------------
+
+// Length of the well-formed sequence at @p p (1-4), or 0 if it is invalid
+// or truncated. Follows the table in Unicode 15, section 3.9, D92.
+inline int sequenceLength(const unsigned char *p, const unsigned char *end, char32_t *codePoint)
+{
+    const unsigned char c = p[0];
+    const qsizetype available = end - p;
+    if (c < 0x80) {
+        *codePoint = c;
+        return 1;
+    }
+    if (c < 0xC2) {
+        return 0;
+    }
+    if (c < 0xE0) {
+        if (available < 2 || (p[1] & 0xC0) != 0x80) {
+            return 0;
+        }
+        *codePoint = (char32_t(c & 0x1F) << 6) | (p[1] & 0x3F);
+        return 2;
+    }
+    if (c < 0xF0) {
+        if (available < 3) {
+            return 0;
+        }
+        const unsigned char b1 = p[1];
+        if ((b1 & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80
+            || (c == 0xE0 && b1 < 0xA0) || (c == 0xED && b1 > 0x9F)) {
+            return 0;
+        }
+        *codePoint = (char32_t(c & 0x0F) << 12) | (char32_t(b1 & 0x3F) << 6) | (p[2] & 0x3F);
+        return 3;
+    }
+    if (c < 0xF5) {
+        if (available < 4) {
+            return 0;
+        }
+        const unsigned char b1 = p[1];
+        if ((b1 & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80 || (p[3] & 0xC0) != 0x80
+            || (c == 0xF0 && b1 < 0x90) || (c == 0xF4 && b1 > 0x8F)) {
+            return 0;
+        }
+        *codePoint = (char32_t(c & 0x07) << 18) | (char32_t(b1 & 0x3F) << 12)
+                     | (char32_t(p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+        return 4;
+    }
+    return 0;
+}
+
+qsizetype asciiPrefixScalar(const unsigned char *src, qsizetype size)
+{
+    qsizetype i = 0;
+    while (i < size && src[i] < 0x80) {
+        ++i;
+    }
+    return i;
+}
+
+qsizetype widenAsciiScalar(const unsigned char *src, qsizetype size, char16_t *dst)
+{
+    qsizetype i = 0;
+    while (i < size && src[i] < 0x80) {
+        dst[i] = src[i];
+        ++i;
+    }
+    return i;
+}
+
+qsizetype narrowAsciiScalar(const char16_t *src, qsizetype size, char *dst)
+{
+    qsizetype i = 0;
+    while (i < size && src[i] < 0x80) {
+        dst[i] = char(src[i]);
+        ++i;
+    }
+    return i;
+}
+
+// --- SSE2 kernels ---------------------------------------------------------
+
+#ifdef TEXTCODEC_SSE2
+qsizetype asciiPrefixSse2(const unsigned char *src, qsizetype size)
+{
+    qsizetype i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        int mask = _mm_movemask_epi8(bytes);
+        if (mask) {
+            return i + qCountTrailingZeroBits(quint32(mask));
+        }
+    }
+    return i + asciiPrefixScalar(src + i, size - i);
+}
+
+qsizetype widenAsciiSse2(const unsigned char *src, qsizetype size, char16_t *dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    qsizetype i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        if (_mm_movemask_epi8(bytes)) {
+            break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_unpacklo_epi8(bytes, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 8), _mm_unpackhi_epi8(bytes, zero));
+    }
+    return i + widenAsciiScalar(src + i, size - i, dst + i);
+}
+
+qsizetype narrowAsciiSse2(const char16_t *src, qsizetype size, char *dst)
+{
+    const __m128i nonAscii = _mm_set1_epi16(short(0xFF80));
+    const __m128i zero = _mm_setzero_si128();
+    qsizetype i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 8));
+        __m128i highBits = _mm_and_si128(_mm_or_si128(low, high), nonAscii);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(highBits, zero)) != 0xFFFF) {
+            break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(low, high));
+    }
+    return i + narrowAsciiScalar(src + i, size - i, dst + i);
+}
+#endif
+
+// --- AVX2 kernels ---------------------------------------------------------
+
+#ifdef TEXTCODEC_AVX2
+TEXTCODEC_TARGET_AVX2
+qsizetype asciiPrefixAvx2(const unsigned char *src, qsizetype size)
+{
+    qsizetype i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        int mask = _mm256_movemask_epi8(bytes);
+        if (mask) {
+            return i + qCountTrailingZeroBits(quint32(mask));
+        }
+    }
+    return i + asciiPrefixSse2(src + i, size - i);
+}
+
+TEXTCODEC_TARGET_AVX2
+qsizetype widenAsciiAvx2(const unsigned char *src, qsizetype size, char16_t *dst)
+{
+    qsizetype i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        if (_mm256_movemask_epi8(bytes)) {
+            break;
+        }
+        __m256i low = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes));
+        __m256i high = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), low);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + 16), high);
+    }
+    return i + widenAsciiSse2(src + i, size - i, dst + i);
+}
+
+TEXTCODEC_TARGET_AVX2
+qsizetype narrowAsciiAvx2(const char16_t *src, qsizetype size, char *dst)
+{
+    const __m256i nonAscii = _mm256_set1_epi16(short(0xFF80));
+    qsizetype i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 16));
+        if (!_mm256_testz_si256(_mm256_or_si256(low, high), nonAscii)) {
+            break;
+        }
+        // packus works per 128-bit lane; restore the element order afterwards.
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), packed);
+    }
+    return i + narrowAsciiSse2(src + i, size - i, dst + i);
+}
+
+bool cpuHasAvx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+        return false; // The OS does not save YMM registers
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+// --- Dispatch -------------------------------------------------------------
+
+struct Kernels {
+    qsizetype (*asciiPrefix)(const unsigned char *, qsizetype);
+    qsizetype (*widenAscii)(const unsigned char *, qsizetype, char16_t *);
+    qsizetype (*narrowAscii)(const char16_t *, qsizetype, char *);
+};
+
+Kernels selectKernels()
+{
+#ifdef TEXTCODEC_AVX2
+    if (cpuHasAvx2()) {
+        return { asciiPrefixAvx2, widenAsciiAvx2, narrowAsciiAvx2 };
+    }
+#endif
+#ifdef TEXTCODEC_SSE2
+    return { asciiPrefixSse2, widenAsciiSse2, narrowAsciiSse2 };
+#else
+    return { asciiPrefixScalar, widenAsciiScalar, narrowAsciiScalar };
+#endif
+}
+
+const Kernels &kernels()
+{
+    static const Kernels selected = selectKernels();
+    return selected;
+}
+
+// Decodes [src, src + size) without any line-ending handling.
+qsizetype decodeRange(const unsigned char *src, qsizetype size, char16_t *dst, bool *valid)
+{
+    const Kernels &k = kernels();
+    const unsigned char *end = src + size;
+    qsizetype in = 0;
+    qsizetype out = 0;
+    while (in < size) {
+        qsizetype ascii = k.widenAscii(src + in, size - in, dst + out);
+        in += ascii;
+        out += ascii;
+        if (in >= size) {
+            break;
+        }
+
+        char32_t codePoint = 0;
+        int length = sequenceLength(src + in, end, &codePoint);
+        if (length == 0) {
+            dst[out++] = ReplacementCharacter;
+            if (valid) {
+                *valid = false;
+            }
+            ++in;
+            // Skip the continuation bytes of the broken sequence as one error.
+            while (in < size && (src[in] & 0xC0) == 0x80) {
+                ++in;
+            }
+            continue;
+        }
+        if (codePoint >= 0x10000) {
+            dst[out++] = char16_t(0xD800 + ((codePoint - 0x10000) >> 10));
+            dst[out++] = char16_t(0xDC00 + ((codePoint - 0x10000) & 0x3FF));
+        } else {
+            dst[out++] = char16_t(codePoint);
+        }
+        in += length;
+    }
+    return out;
+}
+
+const unsigned char Utf8Bom[3] = { 0xEF, 0xBB, 0xBF };
+
+} // namespace
+
+namespace TextCodec
+{
+
+bool isValidUtf8(const char *data, qsizetype size)
+{
+    const Kernels &k = kernels();
+    const unsigned char *src = reinterpret_cast<const unsigned char *>(data);
+    const unsigned char *end = src + size;
+    qsizetype i = 0;
+    while (i < size) {
+        i += k.asciiPrefix(src + i, size - i);
+        if (i >= size) {
+            break;
+        }
+        char32_t codePoint;
+        int length = sequenceLength(src + i, end, &codePoint);
+        if (length == 0) {
+            return false;
+        }
+        i += length;
+    }
+    return true;
+}
+
+LineEnding detectLineEnding(const char *data, qsizetype size)
+{
+    const void *newline = std::memchr(data, '\n', size_t(size));
+    if (newline && newline != data && static_cast<const char *>(newline)[-1] == '\r') {
+        return LineEnding::CRLF;
+    }
+    return LineEnding::LF;
+}
+
+qsizetype utf8ToUtf16(const char *data, qsizetype size, char16_t *out,
+                      bool stripCarriageReturns, bool *valid)
+{
+    const unsigned char *src = reinterpret_cast<const unsigned char *>(data);
+    if (!stripCarriageReturns) {
+        return decodeRange(src, size, out, valid);
+    }
+
+    // memchr is vectorised by the C library, so LF-only files pay one fast scan.
+    qsizetype written = 0;
+    qsizetype pos = 0;
+    while (pos < size) {
+        const void *cr = std::memchr(data + pos, '\r', size_t(size - pos));
+        qsizetype segmentEnd = cr ? static_cast<const char *>(cr) - data : size;
+        written += decodeRange(src + pos, segmentEnd - pos, out + written, valid);
+        if (!cr) {
+            break;
+        }
+        if (segmentEnd + 1 >= size || data[segmentEnd + 1] != '\n') {
+            out[written++] = u'\r'; // A lone CR is content
+        }
+        pos = segmentEnd + 1;
+    }
+    return written;
+}
+
+qsizetype utf16ToUtf8(const char16_t *data, qsizetype size, char *out)
+{
+    const Kernels &k = kernels();
+    qsizetype in = 0;
+    qsizetype written = 0;
+    while (in < size) {
+        qsizetype ascii = k.narrowAscii(data + in, size - in, out + written);
+        in += ascii;
+        written += ascii;
+        if (in >= size) {
+            break;
+        }
+
+        char32_t codePoint = data[in++];
+        if (codePoint >= 0xD800 && codePoint <= 0xDFFF) {
+            if (codePoint <= 0xDBFF && in < size && data[in] >= 0xDC00 && data[in] <= 0xDFFF) {
+                codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (data[in++] - 0xDC00);
+            } else {
+                codePoint = ReplacementCharacter;
+            }
+        }
+
+        if (codePoint < 0x800) {
+            out[written++] = char(0xC0 | (codePoint >> 6));
+            out[written++] = char(0x80 | (codePoint & 0x3F));
+        } else if (codePoint < 0x10000) {
+            out[written++] = char(0xE0 | (codePoint >> 12));
+            out[written++] = char(0x80 | ((codePoint >> 6) & 0x3F));
+            out[written++] = char(0x80 | (codePoint & 0x3F));
+        } else {
+            out[written++] = char(0xF0 | (codePoint >> 18));
+            out[written++] = char(0x80 | ((codePoint >> 12) & 0x3F));
+            out[written++] = char(0x80 | ((codePoint >> 6) & 0x3F));
+            out[written++] = char(0x80 | (codePoint & 0x3F));
+        }
+    }
+    return written;
+}
+
+QString decode(QByteArrayView bytes, FileFormat *format, bool *valid)
+{
+    const char *data = bytes.data();
+    qsizetype size = bytes.size();
+
+    format->byteOrderMark = size >= 3 && std::memcmp(data, Utf8Bom, 3) == 0;
+    if (format->byteOrderMark) {
+        data += 3;
+        size -= 3;
+    }
+    format->lineEnding = detectLineEnding(data, size);
+
+    return decodeChunk(QByteArrayView(data, size), valid);
+}
+
+QString decodeChunk(QByteArrayView bytes, bool *valid)
+{
+    QString text(bytes.size(), Qt::Uninitialized);
+    qsizetype length = utf8ToUtf16(bytes.data(), bytes.size(),
+                                   reinterpret_cast<char16_t *>(text.data()), true, valid);
+    text.truncate(length);
+    return text;
+}
+
+QByteArray encode(QStringView text, const FileFormat &format)
+{
+    const qsizetype bomSize = format.byteOrderMark ? 3 : 0;
+    QByteArray bytes(bomSize + text.size() * 3, Qt::Uninitialized);
+    if (format.byteOrderMark) {
+        std::memcpy(bytes.data(), Utf8Bom, 3);
+    }
+    qsizetype length = bomSize + utf16ToUtf8(text.utf16(), text.size(), bytes.data() + bomSize);
+    bytes.truncate(length);
+
+    if (format.lineEnding == LineEnding::LF) {
+        return bytes;
+    }
+
+    // Expand LF to CR LF in a second pass; each segment is one memcpy.
+    const char *src = bytes.constData();
+    qsizetype newlines = 0;
+    for (const char *p = src; (p = static_cast<const char *>(std::memchr(p, '\n', size_t(src + length - p)))); ++p) {
+        ++newlines;
+    }
+    if (newlines == 0) {
+        return bytes;
+    }
+
+    QByteArray expanded(length + newlines, Qt::Uninitialized);
+    char *dst = expanded.data();
+    qsizetype pos = 0;
+    while (pos < length) {
+        const void *newline = std::memchr(src + pos, '\n', size_t(length - pos));
+        qsizetype segmentEnd = newline ? static_cast<const char *>(newline) - src : length;
+        std::memcpy(dst, src + pos, size_t(segmentEnd - pos));
+        dst += segmentEnd - pos;
+        if (!newline) {
+            break;
+        }
+        *dst++ = '\r';
+        *dst++ = '\n';
+        pos = segmentEnd + 1;
+    }
+    return expanded;
+}
+
+} // namespace TextCodec
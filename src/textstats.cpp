@@ -0,0 +1,171 @@
+#include "textstats.h"
+#include <QChar>
+#include <QtAlgorithms>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTSTATS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(TEXTSTATS_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define TEXTSTATS_AVX2 1
+#define TEXTSTATS_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(TEXTSTATS_SSE2) && defined(_MSC_VER)
+#define TEXTSTATS_AVX2 1
+#define TEXTSTATS_TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Running state of a scan, carried from one block of code units to the next
+struct Scan {
+    TextStats::Counts counts;
+    bool inWord = false;
+};
+
+// --- Scalar kernel --------------------------------------------------------
+
+void countScalar(const char16_t *text, qsizetype size, Scan &scan)
+{
+    for (qsizetype i = 0; i < size; ++i) {
+        const char16_t c = text[i];
+        const bool space = QChar::isSpace(char32_t(c));
+        if (!space && !scan.inWord) {
+            ++scan.counts.words;
+        }
+        scan.inWord = !space;
+        // The low half of a surrogate pair completes a character already counted
+        if ((c & 0xFC00) != 0xDC00) {
+            ++scan.counts.characters;
+        }
+    }
+}
+
+// Word starts in a block of @p units code units whose whitespace bits, one
+// every @p stride bits, are @p spaces
+inline int wordStarts(quint32 spaces, int units, int stride, Scan &scan)
+{
+    const quint32 unitBits = units * stride >= 32 ? 0xFFFFFFFFu : (1u << (units * stride)) - 1;
+    const quint32 lanes = stride == 1 ? unitBits : (0x55555555u & unitBits);
+    // A word starts where a non-space follows a space; before the block is the carried state
+    const quint32 spaceBefore = ((spaces << stride) | (scan.inWord ? 0u : 1u)) & lanes;
+    const int starts = qPopulationCount(~spaces & spaceBefore & lanes);
+    scan.inWord = !(spaces & (1u << ((units - 1) * stride)));
+    return starts;
+}
+
+// --- SSE2 kernel ----------------------------------------------------------
+
+#ifdef TEXTSTATS_SSE2
+void countSse2(const char16_t *text, qsizetype size, Scan &scan)
+{
+    const __m128i nonAscii = _mm_set1_epi16(short(0xFF80));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i space = _mm_set1_epi16(0x20);
+    const __m128i tab = _mm_set1_epi16(0x09);
+    const __m128i controlSpaces = _mm_set1_epi16(5); // Tab, LF, VT, FF and CR
+    qsizetype i = 0;
+    for (; i + 8 <= size; i += 8) {
+        const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, nonAscii), zero)) != 0xFFFF) {
+            countScalar(text + i, 8, scan);
+            continue;
+        }
+        // ASCII only: units - 9 is in [0, 5) for the control whitespace
+        const __m128i offset = _mm_sub_epi16(units, tab);
+        const __m128i control = _mm_andnot_si128(_mm_cmplt_epi16(offset, zero), _mm_cmplt_epi16(offset, controlSpaces));
+        const __m128i spaces = _mm_or_si128(_mm_cmpeq_epi16(units, space), control);
+        const quint32 mask = quint32(_mm_movemask_epi8(_mm_packs_epi16(spaces, zero)));
+        scan.counts.words += wordStarts(mask, 8, 1, scan);
+        scan.counts.characters += 8;
+    }
+    countScalar(text + i, size - i, scan);
+}
+#endif
+
+// --- AVX2 kernel ----------------------------------------------------------
+
+#ifdef TEXTSTATS_AVX2
+TEXTSTATS_TARGET_AVX2
+void countAvx2(const char16_t *text, qsizetype size, Scan &scan)
+{
+    const __m256i nonAscii = _mm256_set1_epi16(short(0xFF80));
+    const __m256i space = _mm256_set1_epi16(0x20);
+    const __m256i tab = _mm256_set1_epi16(0x09);
+    const __m256i controlSpaces = _mm256_set1_epi16(5);
+    const __m256i zero = _mm256_setzero_si256();
+    qsizetype i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m256i units = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+        if (!_mm256_testz_si256(units, nonAscii)) {
+            countScalar(text + i, 16, scan);
+            continue;
+        }
+        const __m256i offset = _mm256_sub_epi16(units, tab);
+        const __m256i control = _mm256_andnot_si256(_mm256_cmpgt_epi16(zero, offset),
+                                                    _mm256_cmpgt_epi16(controlSpaces, offset));
+        const __m256i spaces = _mm256_or_si256(_mm256_cmpeq_epi16(units, space), control);
+        // Two mask bits per code unit; the even ones are enough
+        const quint32 mask = quint32(_mm256_movemask_epi8(spaces));
+        scan.counts.words += wordStarts(mask, 16, 2, scan);
+        scan.counts.characters += 16;
+    }
+    countSse2(text + i, size - i, scan);
+}
+
+bool cpuHasAvx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+        return false; // The OS does not save YMM registers
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+// --- Dispatch -------------------------------------------------------------
+
+using CountKernel = void (*)(const char16_t *, qsizetype, Scan &);
+
+CountKernel selectKernel()
+{
+#ifdef TEXTSTATS_AVX2
+    if (cpuHasAvx2()) {
+        return countAvx2;
+    }
+#endif
+#ifdef TEXTSTATS_SSE2
+    return countSse2;
+#else
+    return countScalar;
+#endif
+}
+
+} // namespace
+
+namespace TextStats
+{
+
+Counts count(QStringView text)
+{
+    static const CountKernel kernel = selectKernel();
+    Scan scan;
+    kernel(text.utf16(), text.size(), scan);
+    return scan.counts;
+}
+
+}
@@ -726,6 +726,46 @@ QColor ThemeManager::baseColor() const
     return m_currentColors.base;
 }
 
+QColor ThemeManager::headingColor() const
+{
+    return m_currentColors.heading;
+}
+
+QColor ThemeManager::linkColor() const
+{
+    return m_currentColors.link;
+}
+
+QColor ThemeManager::imageColor() const
+{
+    return m_currentColors.image;
+}
+
+QColor ThemeManager::codeTextColor() const
+{
+    return m_currentColors.codeText;
+}
+
+QColor ThemeManager::codeBackgroundColor() const
+{
+    return m_currentColors.codeBackground;
+}
+
+QColor ThemeManager::blockquoteTextColor() const
+{
+    return m_currentColors.blockquoteText;
+}
+
+QColor ThemeManager::tableHeaderBackgroundColor() const
+{
+    return m_currentColors.tableHeaderBackground;
+}
+
+QColor ThemeManager::horizontalRuleColor() const
+{
+    return m_currentColors.horizontalRule;
+}
+
 QIcon ThemeManager::getArrowIcon(bool expanded) const
 {
     const int size = 16;